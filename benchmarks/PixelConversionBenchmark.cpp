@@ -0,0 +1,159 @@
+#include "core/CpuFeatures.h"
+#include "core/PixelConversion.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+/**
+ * @brief Throughput of PixelConversion::convertToFloat against the per-pixel loops it replaced
+ *
+ * The reference is the loader's former conversion: one branchy loop per stored
+ * type that rescales each pixel, followed by a separate min/max pass. Every
+ * kernel's output is checked against it bit for bit.
+ *
+ * Usage: pixel_conversion_benchmark [voxel count in millions, default 16]
+ */
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+    constexpr int kRepetitions = 5;
+
+    template <typename T>
+    void referenceConvert(const void* source, size_t count, const PixelConversion::Rescale& rescale,
+                          float* destination, float& minValue, float& maxValue)
+    {
+        const T* pixels = static_cast<const T*>(source);
+        for (size_t i = 0; i < count; ++i) {
+            float value = static_cast<float>(pixels[i]);
+            if (rescale.enabled) {
+                value = static_cast<float>(rescale.intercept + rescale.slope * value);
+            }
+            destination[i] = value;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            minValue = std::min(minValue, destination[i]);
+            maxValue = std::max(maxValue, destination[i]);
+        }
+    }
+
+    void referenceConvert(const void* source, PixelConversion::StoredType type, size_t count,
+                          const PixelConversion::Rescale& rescale, float* destination,
+                          float& minValue, float& maxValue)
+    {
+        switch (type) {
+        case PixelConversion::StoredType::UInt8:
+            referenceConvert<uint8_t>(source, count, rescale, destination, minValue, maxValue);
+            break;
+        case PixelConversion::StoredType::Int8:
+            referenceConvert<int8_t>(source, count, rescale, destination, minValue, maxValue);
+            break;
+        case PixelConversion::StoredType::UInt16:
+            referenceConvert<uint16_t>(source, count, rescale, destination, minValue, maxValue);
+            break;
+        case PixelConversion::StoredType::Int16:
+            referenceConvert<int16_t>(source, count, rescale, destination, minValue, maxValue);
+            break;
+        }
+    }
+
+    /**
+     * @brief Best of kRepetitions runs, in million voxels per second
+     */
+    template <typename Fn>
+    double measure(size_t count, Fn&& fn)
+    {
+        double best = std::numeric_limits<double>::max();
+        for (int i = 0; i < kRepetitions; ++i) {
+            const auto start = Clock::now();
+            fn();
+            best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+        }
+        return static_cast<double>(count) / best / 1e6;
+    }
+
+    const char* getTypeName(PixelConversion::StoredType type)
+    {
+        switch (type) {
+        case PixelConversion::StoredType::UInt8:
+            return "u8";
+        case PixelConversion::StoredType::Int8:
+            return "s8";
+        case PixelConversion::StoredType::UInt16:
+            return "u16";
+        default:
+            return "s16";
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const size_t millions = argc > 1 ? static_cast<size_t>(std::max(1, std::atoi(argv[1]))) : 16;
+    const size_t count = millions << 20;
+    const CpuFeatures::InstructionSet best = CpuFeatures::getBestInstructionSet();
+
+    std::printf("%zu Mvoxel per run, best of %d, CPU supports %s\n", millions, kRepetitions,
+                CpuFeatures::getName(best));
+    std::printf("type  rescale  reference");
+    for (int set = 0; set <= static_cast<int>(best); ++set) {
+        std::printf("  %9s", CpuFeatures::getName(static_cast<CpuFeatures::InstructionSet>(set)));
+    }
+    std::printf("   (Mvoxel/s)\n");
+
+    std::mt19937 random(12345);
+    std::vector<char> source(count * 2);
+    for (char& byte : source) {
+        byte = static_cast<char>(random());
+    }
+    std::vector<float> expected(count);
+    std::vector<float> output(count);
+    bool allMatch = true;
+
+    const PixelConversion::StoredType types[] = {PixelConversion::StoredType::UInt8, PixelConversion::StoredType::Int8,
+                                                 PixelConversion::StoredType::UInt16, PixelConversion::StoredType::Int16};
+    for (PixelConversion::StoredType type : types) {
+        for (bool enabled : {true, false}) {
+            PixelConversion::Rescale rescale;
+            rescale.enabled = enabled;
+            rescale.slope = 1.5;
+            rescale.intercept = -1024.0;
+
+            float expectedMin = std::numeric_limits<float>::max();
+            float expectedMax = std::numeric_limits<float>::lowest();
+            const double reference = measure(count, [&]() {
+                expectedMin = std::numeric_limits<float>::max();
+                expectedMax = std::numeric_limits<float>::lowest();
+                referenceConvert(source.data(), type, count, rescale, expected.data(), expectedMin, expectedMax);
+            });
+            std::printf("%-4s  %-7s  %9.0f", getTypeName(type), enabled ? "yes" : "no", reference);
+
+            for (int set = 0; set <= static_cast<int>(best); ++set) {
+                float minValue = 0.0f, maxValue = 0.0f;
+                const double throughput = measure(count, [&]() {
+                    minValue = std::numeric_limits<float>::max();
+                    maxValue = std::numeric_limits<float>::lowest();
+                    PixelConversion::convertToFloat(source.data(), type, count, rescale, output.data(),
+                                                    minValue, maxValue,
+                                                    static_cast<CpuFeatures::InstructionSet>(set));
+                });
+                const bool match = minValue == expectedMin && maxValue == expectedMax &&
+                                   std::memcmp(output.data(), expected.data(), count * sizeof(float)) == 0;
+                allMatch = allMatch && match;
+                std::printf("  %9.0f%s", throughput, match ? "" : "!");
+            }
+            std::printf("\n");
+        }
+    }
+
+    if (!allMatch) {
+        std::printf("Output differs from the reference loop (marked !)\n");
+        return 1;
+    }
+    return 0;
+}
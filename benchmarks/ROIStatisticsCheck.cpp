@@ -0,0 +1,212 @@
+#include "core/ROIStatistics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * @brief ROIStatistics against a brute-force pass over every voxel
+ *
+ * Random rectangles, ellipses, boxes, ellipsoids and spheres are measured on
+ * int16 (with rescale), float32 and int16 with per-slice factors, once with
+ * the default table cache and once with a cache of four slices, which sends
+ * tall boxes and ellipsoids down the direct span sums. Count, min and max
+ * must match exactly; mean and standard deviation to 1e-6 relative.
+ *
+ * Usage: roi_statistics_check [queries per volume, default 50]
+ */
+
+namespace {
+    constexpr int kWidth = 256;
+    constexpr int kHeight = 256;
+    constexpr int kDepth = 48;
+
+    struct Reference
+    {
+        size_t count{0};
+        double sum{0.0};
+        double sumSq{0.0};
+        float min{std::numeric_limits<float>::max()};
+        float max{std::numeric_limits<float>::lowest()};
+
+        void add(float value)
+        {
+            ++count;
+            sum += value;
+            sumSq += static_cast<double>(value) * value;
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+    };
+
+    /**
+     * @brief Value of one voxel, with the same expression ROIStatistics documents
+     */
+    float valueAt(const Volume3D& volume, const std::vector<double>& factors, int x, int y, int z)
+    {
+        const size_t index = (static_cast<size_t>(z) * volume.height + y) * volume.width + x;
+        const double factor = factors.empty() ? 1.0 : factors[z];
+        if (volume.voxelType == Volume3D::VoxelType::Float32) {
+            return volume.voxels[index] * static_cast<float>(factor);
+        }
+        const double stored = static_cast<const int16_t*>(volume.storedVoxels.get())[index];
+        return static_cast<float>(volume.storedIntercept * factor + volume.storedSlope * factor * stored);
+    }
+
+    bool matches(const ROIStatistics::Stats& stats, const Reference& reference)
+    {
+        if (reference.count == 0) {
+            return stats.count == 0;
+        }
+        const double n = static_cast<double>(reference.count);
+        const double mean = reference.sum / n;
+        const double stdDev = std::sqrt(std::max(0.0, reference.sumSq / n - mean * mean));
+        return stats.count == reference.count && stats.min == reference.min && stats.max == reference.max &&
+               std::abs(stats.mean - mean) <= 1e-6 * std::max(1.0, std::abs(mean)) &&
+               std::abs(stats.stdDev - stdDev) <= 1e-6 * std::max(1.0, stdDev);
+    }
+
+    struct Counter
+    {
+        const char* name;
+        int checked{0};
+        int failed{0};
+    };
+
+    void record(Counter& counter, const ROIStatistics::Stats& stats, const Reference& reference)
+    {
+        ++counter.checked;
+        if (!matches(stats, reference)) {
+            ++counter.failed;
+        }
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int queries = argc > 1 ? std::max(1, std::atoi(argv[1])) : 50;
+    std::mt19937 random(5);
+
+    auto native = std::make_shared<Volume3D>(kWidth, kHeight, kDepth);
+    native->allocateStoredVoxels(Volume3D::VoxelType::Int16, 1.0, -1024.0);
+    auto floats = std::make_shared<Volume3D>(kWidth, kHeight, kDepth);
+    int16_t* stored = static_cast<int16_t*>(native->storedVoxels.get());
+    for (size_t i = 0; i < native->getTotalVoxels(); ++i) {
+        stored[i] = static_cast<int16_t>(random() % 4000);
+        floats->voxels[i] = stored[i] * 0.37f - 12.0f;
+    }
+    for (Volume3D* volume : {native.get(), floats.get()}) {
+        volume->spacing[0] = volume->spacing[1] = 0.7;
+        volume->spacing[2] = 2.5;
+    }
+    std::vector<double> factors(kDepth);
+    for (int z = 0; z < kDepth; ++z) {
+        factors[z] = 1e-3 * (1.0 + z * 0.01);
+    }
+
+    Counter rectangles{"rectangle"}, ellipses{"ellipse"}, boxes{"box"}, ellipsoids{"ellipsoid"}, spheres{"sphere"};
+    for (int variant = 0; variant < 6; ++variant) {
+        const std::shared_ptr<const Volume3D> volume = variant % 3 == 1 ? floats : native;
+        const std::vector<double> sliceFactors = variant % 3 == 2 ? factors : std::vector<double>();
+        ROIStatistics statistics(volume, sliceFactors);
+        if (variant >= 3) {
+            statistics.setCacheBudget(4 * 2 * sizeof(double) * (kWidth + 1) * (kHeight + 1));
+        }
+        const auto value = [&](int x, int y, int z) { return valueAt(*volume, sliceFactors, x, y, z); };
+
+        std::uniform_real_distribution<double> position(-20.0, kWidth + 20.0);
+        std::uniform_real_distribution<double> radius(0.5, 60.0);
+        for (int q = 0; q < queries; ++q) {
+            const int z = static_cast<int>(random() % kDepth);
+            const int x0 = static_cast<int>(position(random)), y0 = static_cast<int>(position(random));
+            const int x1 = static_cast<int>(position(random)), y1 = static_cast<int>(position(random));
+            const int z0 = static_cast<int>(random() % kDepth), z1 = static_cast<int>(random() % kDepth);
+            double cx = position(random), cy = position(random), rx = radius(random), ry = radius(random);
+            if (q % 5 == 0) {
+                // Integer centers and radii put voxel centers exactly on the boundary
+                cx = std::round(cx);
+                cy = std::round(cy);
+                rx = ry = std::round(rx);
+            }
+            const double cz = random() % kDepth + 0.3;
+            const double rz = radius(random) / 4.0;
+
+            const int bx0 = std::max(0, std::min(x0, x1)), bx1 = std::min(kWidth - 1, std::max(x0, x1));
+            const int by0 = std::max(0, std::min(y0, y1)), by1 = std::min(kHeight - 1, std::max(y0, y1));
+
+            Reference rectangle;
+            Reference box;
+            for (int zz = std::min(z0, z1); zz <= std::max(z0, z1); ++zz) {
+                for (int y = by0; y <= by1; ++y) {
+                    for (int x = bx0; x <= bx1; ++x) {
+                        box.add(value(x, y, zz));
+                    }
+                }
+            }
+            for (int y = by0; y <= by1; ++y) {
+                for (int x = bx0; x <= bx1; ++x) {
+                    rectangle.add(value(x, y, z));
+                }
+            }
+            record(rectangles, statistics.rectangle(z, x0, y0, x1, y1), rectangle);
+            record(boxes, statistics.box(x0, y0, z0, x1, y1, z1), box);
+
+            Reference ellipse;
+            Reference ellipsoid;
+            for (int zz = 0; zz < kDepth; ++zz) {
+                const double dz = (zz - cz) / rz;
+                for (int y = 0; y < kHeight; ++y) {
+                    const double dy = (y - cy) / ry;
+                    for (int x = 0; x < kWidth; ++x) {
+                        const double dx = (x - cx) / rx;
+                        if (zz == z && dx * dx + dy * dy <= 1.0) {
+                            ellipse.add(value(x, y, zz));
+                        }
+                        if (dx * dx + dy * dy + dz * dz <= 1.0) {
+                            ellipsoid.add(value(x, y, zz));
+                        }
+                    }
+                }
+            }
+            record(ellipses, statistics.ellipse(z, cx, cy, rx, ry), ellipse);
+            record(ellipsoids, statistics.ellipsoid(cx, cy, cz, rx, ry, rz), ellipsoid);
+
+            if (q % 10 == 0) {
+                const double radiusMm = radius(random);
+                const double sx = radiusMm / volume->spacing[0];
+                const double sy = radiusMm / volume->spacing[1];
+                const double sz = radiusMm / volume->spacing[2];
+                Reference sphere;
+                for (int zz = 0; zz < kDepth; ++zz) {
+                    const double dz = (zz - cz) / sz;
+                    for (int y = 0; y < kHeight; ++y) {
+                        const double dy = (y - cy) / sy;
+                        for (int x = 0; x < kWidth; ++x) {
+                            const double dx = (x - cx) / sx;
+                            if (dx * dx + dy * dy + dz * dz <= 1.0) {
+                                sphere.add(value(x, y, zz));
+                            }
+                        }
+                    }
+                }
+                record(spheres, statistics.sphere(cx, cy, cz, radiusMm), sphere);
+            }
+        }
+    }
+
+    int failed = 0;
+    for (const Counter* counter : {&rectangles, &ellipses, &boxes, &ellipsoids, &spheres}) {
+        std::printf("%-9s  %5d checked  %d mismatches\n", counter->name, counter->checked, counter->failed);
+        failed += counter->failed;
+    }
+    if (failed > 0) {
+        std::printf("ROIStatistics differs from the brute-force reference\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include "core/SUVMetrics.h"
+#include "core/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+/**
+ * @brief SUVMetrics against a brute-force reference, and across thread counts
+ *
+ * The reference visits every ROI voxel and averages the peak sphere voxel by
+ * voxel. Count, SUVmax and its position, the peak center and voxel count must
+ * match exactly; SUVmean and SUVpeak to 1e-9 relative. Every result must also
+ * be bit-identical with 1, 4 and 7 threads; the background spans many binary
+ * exponents so that a thread-dependent summation order would show. The last case covers 1000 x 1000
+ * voxels per slice, so its prefix sums are built in several z tiles.
+ *
+ * Usage: suv_metrics_check [random ROIs per volume, default 6]
+ */
+
+namespace {
+    struct Case
+    {
+        int size[3];
+        double spacing[3];
+    };
+
+    void computeReference(const SUVCalculator::View& view, const SUVMetrics::Region& region, double sphereVolumeMl,
+                          SUVMetrics::Result& result)
+    {
+        const Volume3D& volume = *view.volume;
+        const double radius = SUVMetrics::sphereRadius(sphereVolumeMl);
+        const double* spacing = volume.spacing;
+        int reach[3];
+        for (int a = 0; a < 3; ++a) {
+            reach[a] = static_cast<int>(std::ceil(radius / spacing[a]));
+        }
+
+        result = SUVMetrics::Result{};
+        result.max = -std::numeric_limits<float>::infinity();
+        result.peak = -std::numeric_limits<double>::infinity();
+        double sum = 0.0;
+        for (int z = 0; z < volume.depth; ++z) {
+            for (int y = 0; y < volume.height; ++y) {
+                for (int x = 0; x < volume.width; ++x) {
+                    if (!region.contains(x, y, z)) {
+                        continue;
+                    }
+                    const float value = view.getSUV(x, y, z);
+                    ++result.count;
+                    sum += value;
+                    if (value > result.max) {
+                        result.max = value;
+                        result.maxPosition[0] = x;
+                        result.maxPosition[1] = y;
+                        result.maxPosition[2] = z;
+                    }
+
+                    double sphereSum = 0.0;
+                    size_t sphereCount = 0;
+                    for (int dz = -reach[2]; dz <= reach[2]; ++dz) {
+                        for (int dy = -reach[1]; dy <= reach[1]; ++dy) {
+                            for (int dx = -reach[0]; dx <= reach[0]; ++dx) {
+                                const double px = dx * spacing[0];
+                                const double py = dy * spacing[1];
+                                const double pz = dz * spacing[2];
+                                const int sx = x + dx, sy = y + dy, sz = z + dz;
+                                if (px * px + py * py + pz * pz > radius * radius || sx < 0 || sy < 0 || sz < 0 ||
+                                    sx >= volume.width || sy >= volume.height || sz >= volume.depth) {
+                                    continue;
+                                }
+                                sphereSum += view.getSUV(sx, sy, sz);
+                                ++sphereCount;
+                            }
+                        }
+                    }
+                    const double mean = sphereSum / static_cast<double>(sphereCount);
+                    if (mean > result.peak) {
+                        result.peak = mean;
+                        result.peakCenter[0] = x;
+                        result.peakCenter[1] = y;
+                        result.peakCenter[2] = z;
+                        result.peakVoxels = sphereCount;
+                    }
+                }
+            }
+        }
+        result.mean = result.count > 0 ? sum / static_cast<double>(result.count) : 0.0;
+    }
+
+    bool samePosition(const int a[3], const int b[3])
+    {
+        return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+    }
+
+    bool identical(const SUVMetrics::Result& a, const SUVMetrics::Result& b)
+    {
+        return a.count == b.count && a.mean == b.mean && a.max == b.max && samePosition(a.maxPosition, b.maxPosition) &&
+               a.peak == b.peak && samePosition(a.peakCenter, b.peakCenter) && a.peakVoxels == b.peakVoxels;
+    }
+
+    bool matchesReference(const SUVMetrics::Result& result, const SUVMetrics::Result& reference)
+    {
+        return result.count == reference.count && result.max == reference.max &&
+               samePosition(result.maxPosition, reference.maxPosition) &&
+               std::abs(result.mean - reference.mean) <= 1e-9 * std::abs(reference.mean) &&
+               std::abs(result.peak - reference.peak) <= 1e-9 * std::abs(reference.peak) &&
+               samePosition(result.peakCenter, reference.peakCenter) && result.peakVoxels == reference.peakVoxels;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const int regionsPerCase = argc > 1 ? std::max(1, std::atoi(argv[1])) : 6;
+    std::mt19937 random(9);
+    ThreadPool one(1), four(4), seven(7);
+
+    const Case cases[] = {
+        {{128, 128, 90}, {4.07, 4.07, 3.27}},
+        {{128, 128, 90}, {2.0, 2.0, 3.0}},
+        {{160, 160, 100}, {1.2, 1.2, 2.0}},
+        {{1024, 1024, 10}, {5.0, 5.0, 5.0}},
+    };
+    const int caseCount = static_cast<int>(std::size(cases));
+
+    int checked = 0;
+    int failed = 0;
+    for (int c = 0; c < caseCount; ++c) {
+        const Case& test = cases[c];
+        const int width = test.size[0], height = test.size[1], depth = test.size[2];
+        auto volume = std::make_shared<Volume3D>(width, height, depth);
+        std::copy(test.spacing, test.spacing + 3, volume->spacing);
+
+        // Noisy background spread over many binary exponents, so double sums of
+        // the values are inexact and depend on the order of the additions
+        std::normal_distribution<float> background(1000.0f, 200.0f);
+        std::uniform_int_distribution<int> exponent(-16, 0);
+        for (float& value : volume->voxels) {
+            value = std::ldexp(std::max(0.0f, background(random)), exponent(random));
+        }
+
+        // A few hot lesions
+        for (int lesion = 0; lesion < 5; ++lesion) {
+            const int cx = random() % width, cy = random() % height, cz = random() % depth;
+            for (int z = 0; z < depth; ++z) {
+                for (int y = 0; y < height; ++y) {
+                    for (int x = 0; x < width; ++x) {
+                        const double distance = std::hypot((x - cx) * test.spacing[0], (y - cy) * test.spacing[1],
+                                                           (z - cz) * test.spacing[2]);
+                        if (distance < 15.0) {
+                            volume->voxels[(static_cast<size_t>(z) * height + y) * width + x] +=
+                                static_cast<float>(8000.0 * (1.0 - distance / 15.0));
+                        }
+                    }
+                }
+            }
+        }
+
+        SUVCalculator::View view;
+        view.volume = volume;
+        for (int z = 0; z < depth; ++z) {
+            view.sliceFactors.push_back(1e-3 * (1.0 + 0.002 * z));
+        }
+
+        const bool large = c == caseCount - 1;
+        const int regions = large ? 1 : regionsPerCase;
+        for (int r = 0; r < regions; ++r) {
+            SUVMetrics::Region region;
+            if (large) {
+                region = SUVMetrics::Region::box(10, 12, 1, 1010, 1012, 8);
+            } else if (r % 2 == 0) {
+                region = SUVMetrics::Region::ellipsoid(random() % width, random() % height, random() % depth,
+                                                       3 + random() % 20, 3 + random() % 20, 3 + random() % 15);
+            } else {
+                region = SUVMetrics::Region::box(random() % width - 5, random() % height, random() % depth,
+                                                 random() % width, random() % height + 3, random() % depth);
+            }
+            const double sphereVolumeMl = r == 3 ? 2.0 : 1.0;
+
+            SUVMetrics::Result single, result4, result7, reference;
+            if (!SUVMetrics::compute(view, region, single, sphereVolumeMl, &one)) {
+                std::printf("case %d ROI %d: %s\n", c, r, SUVMetrics::getLastError().c_str());
+                continue;
+            }
+            SUVMetrics::compute(view, region, result4, sphereVolumeMl, &four);
+            SUVMetrics::compute(view, region, result7, sphereVolumeMl, &seven);
+            computeReference(view, region, sphereVolumeMl, reference);
+
+            const bool threadsAgree = identical(single, result4) && identical(single, result7);
+            const bool match = matchesReference(single, reference);
+            ++checked;
+            if (!threadsAgree || !match) {
+                ++failed;
+            }
+            std::printf("case %d ROI %d: %zu voxels, SUVmax %.4f, SUVmean %.4f, SUVpeak %.6f (%zu voxels)%s%s\n",
+                        c, r, single.count, single.max, single.mean, single.peak, single.peakVoxels,
+                        threadsAgree ? "" : "  THREAD COUNTS DIFFER", match ? "" : "  REFERENCE DIFFERS");
+        }
+    }
+
+    std::printf("%d ROIs checked, %d mismatches\n", checked, failed);
+    return failed > 0 ? 1 : 0;
+}
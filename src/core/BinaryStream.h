@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <sstream>
+#include <string>
+
+/**
+ * @brief Append-only writer for the native-byte-order cache file formats
+ */
+class BinaryWriter
+{
+public:
+    template <typename T>
+    void put(const T& value)
+    {
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        m_buffer.append(bytes, sizeof(T));
+    }
+
+    void putString(const std::string& value)
+    {
+        put(static_cast<uint32_t>(value.size()));
+        m_buffer.append(value);
+    }
+
+    void putRaw(const void* data, size_t size)
+    {
+        m_buffer.append(static_cast<const char*>(data), size);
+    }
+
+    /**
+     * @brief Pad with zero bytes up to a multiple of alignment
+     */
+    void alignTo(size_t alignment)
+    {
+        const size_t remainder = m_buffer.size() % alignment;
+        if (remainder != 0) {
+            m_buffer.append(alignment - remainder, '\0');
+        }
+    }
+
+    const std::string& data() const { return m_buffer; }
+
+private:
+    std::string m_buffer;
+};
+
+/**
+ * @brief Bounds-checked reader over an in-memory cache file
+ */
+class BinaryReader
+{
+public:
+    BinaryReader(const char* data, size_t size) : m_data(data), m_size(size) {}
+
+    template <typename T>
+    bool get(T& value)
+    {
+        if (m_size - m_offset < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, m_data + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string& value)
+    {
+        uint32_t length = 0;
+        if (!get(length) || m_size - m_offset < length) {
+            return false;
+        }
+        value.assign(m_data + m_offset, length);
+        m_offset += length;
+        return true;
+    }
+
+    bool getRaw(void* data, size_t size)
+    {
+        if (m_size - m_offset < size) {
+            return false;
+        }
+        std::memcpy(data, m_data + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+    size_t offset() const { return m_offset; }
+
+private:
+    const char* m_data;
+    size_t m_size;
+    size_t m_offset{0};
+};
+
+/**
+ * @brief Unique sibling of a cache file to write before renaming it into place
+ *
+ * Writers of the same target in other processes or threads each get their own
+ * file, so none truncates or renames another's partial write.
+ */
+inline std::filesystem::path makeTemporaryPath(const std::filesystem::path& target)
+{
+    // Random per process, counted per call
+    static const uint64_t processToken = (static_cast<uint64_t>(std::random_device{}()) << 32) ^
+                                         std::random_device{}();
+    static std::atomic<uint64_t> counter{0};
+
+    std::ostringstream suffix;
+    suffix << "." << std::hex << processToken << "-" << counter.fetch_add(1) << ".tmp";
+    std::filesystem::path temporary = target;
+    temporary += suffix.str();
+    return temporary;
+}
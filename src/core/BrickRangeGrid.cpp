@@ -0,0 +1,232 @@
+#include "BrickRangeGrid.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#if AMPR_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    using Range = BrickRangeGrid::Range;
+
+    /**
+     * @brief columnMin/columnMax = elementwise min/max with one row
+     */
+    template <typename T>
+    void updateColumnsScalar(const T* row, size_t count, T* columnMin, T* columnMax)
+    {
+        for (size_t x = 0; x < count; ++x) {
+            columnMin[x] = std::min(columnMin[x], row[x]);
+            columnMax[x] = std::max(columnMax[x], row[x]);
+        }
+    }
+
+#if AMPR_HAS_X86_SIMD
+    AMPR_TARGET_AVX2 inline void minMax(__m256i v, __m256i& lo, __m256i& hi, int16_t)
+    {
+        lo = _mm256_min_epi16(lo, v);
+        hi = _mm256_max_epi16(hi, v);
+    }
+    AMPR_TARGET_AVX2 inline void minMax(__m256i v, __m256i& lo, __m256i& hi, uint16_t)
+    {
+        lo = _mm256_min_epu16(lo, v);
+        hi = _mm256_max_epu16(hi, v);
+    }
+    AMPR_TARGET_AVX2 inline void minMax(__m256i v, __m256i& lo, __m256i& hi, uint8_t)
+    {
+        lo = _mm256_min_epu8(lo, v);
+        hi = _mm256_max_epu8(hi, v);
+    }
+
+    template <typename T>
+    AMPR_TARGET_AVX2 void updateColumnsAVX2(const T* row, size_t count, T* columnMin, T* columnMax)
+    {
+        size_t x = 0;
+        if constexpr (std::is_same_v<T, float>) {
+            for (; x + 8 <= count; x += 8) {
+                const __m256 v = _mm256_loadu_ps(row + x);
+                _mm256_storeu_ps(columnMin + x, _mm256_min_ps(_mm256_loadu_ps(columnMin + x), v));
+                _mm256_storeu_ps(columnMax + x, _mm256_max_ps(_mm256_loadu_ps(columnMax + x), v));
+            }
+        } else {
+            constexpr size_t lanes = 32 / sizeof(T);
+            for (; x + lanes <= count; x += lanes) {
+                __m256i* lo = reinterpret_cast<__m256i*>(columnMin + x);
+                __m256i* hi = reinterpret_cast<__m256i*>(columnMax + x);
+                __m256i minimum = _mm256_loadu_si256(lo);
+                __m256i maximum = _mm256_loadu_si256(hi);
+                minMax(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x)), minimum, maximum, T());
+                _mm256_storeu_si256(lo, minimum);
+                _mm256_storeu_si256(hi, maximum);
+            }
+        }
+        updateColumnsScalar(row + x, count - x, columnMin + x, columnMax + x);
+    }
+#endif
+
+    /**
+     * @brief Brick column ranges of one slice, [by][bx]
+     *
+     * Min/max are found in the stored type and rescaled once per brick column;
+     * the rescale is monotonic, so only its sign matters for the order.
+     */
+    template <typename T>
+    void sliceRanges(const VoxelView<T>& view, int width, int height, int z, int bricksX, Range* ranges)
+    {
+        constexpr int B = BrickRangeGrid::kBrickSize;
+        const T* slice = view.data + static_cast<size_t>(z) * width * height;
+
+        // Column-wise min/max over the rows of a brick row (a contiguous SIMD
+        // pass), then one short reduction per brick
+#if AMPR_HAS_X86_SIMD
+        const bool avx2 = CpuFeatures::hasAVX2();
+#endif
+        std::vector<T> columnMin(width), columnMax(width);
+        for (int by = 0; by * B < height; ++by) {
+            const int rowBegin = by * B;
+            const int rowEnd = std::min(height, rowBegin + B);
+            const T* first = slice + static_cast<size_t>(rowBegin) * width;
+            std::copy(first, first + width, columnMin.begin());
+            std::copy(first, first + width, columnMax.begin());
+            for (int y = rowBegin + 1; y < rowEnd; ++y) {
+                const T* row = slice + static_cast<size_t>(y) * width;
+#if AMPR_HAS_X86_SIMD
+                if (avx2) {
+                    updateColumnsAVX2(row, width, columnMin.data(), columnMax.data());
+                    continue;
+                }
+#endif
+                updateColumnsScalar(row, width, columnMin.data(), columnMax.data());
+            }
+
+            for (int bx = 0; bx < bricksX; ++bx) {
+                const int x0 = bx * B;
+                const int x1 = std::min(width, x0 + B);
+                T lo = columnMin[x0];
+                T hi = columnMax[x0];
+                for (int x = x0 + 1; x < x1; ++x) {
+                    lo = std::min(lo, columnMin[x]);
+                    hi = std::max(hi, columnMax[x]);
+                }
+
+                Range& range = ranges[static_cast<size_t>(by) * bricksX + bx];
+                if constexpr (std::is_same_v<T, float>) {
+                    range.min = lo;
+                    range.max = hi;
+                } else {
+                    const float a = static_cast<float>(view.intercept + view.slope * static_cast<float>(lo));
+                    const float b = static_cast<float>(view.intercept + view.slope * static_cast<float>(hi));
+                    range.min = std::min(a, b);
+                    range.max = std::max(a, b);
+                }
+            }
+        }
+    }
+}
+
+BrickRangeGrid::Builder::Builder(const Volume3D& volume)
+    : m_depth(volume.depth)
+{
+    m_bricks[0] = (volume.width + kBrickSize - 1) >> kBrickShift;
+    m_bricks[1] = (volume.height + kBrickSize - 1) >> kBrickShift;
+    m_sliceRanges.resize(static_cast<size_t>(m_bricks[0]) * m_bricks[1] * std::max(0, m_depth));
+}
+
+void BrickRangeGrid::Builder::addSlice(const Volume3D& volume, int z)
+{
+    if (z < 0 || z >= m_depth) {
+        return;
+    }
+    Range* ranges = m_sliceRanges.data() + static_cast<size_t>(z) * m_bricks[0] * m_bricks[1];
+    volume.visitVoxels([&](const auto& view) {
+        sliceRanges(view, volume.width, volume.height, z, m_bricks[0], ranges);
+    });
+}
+
+std::shared_ptr<const BrickRangeGrid> BrickRangeGrid::Builder::build() const
+{
+    if (m_sliceRanges.empty()) {
+        return nullptr;
+    }
+
+    auto grid = std::make_shared<BrickRangeGrid>();
+    grid->m_bricks[0] = m_bricks[0];
+    grid->m_bricks[1] = m_bricks[1];
+    grid->m_bricks[2] = (m_depth + kBrickSize - 1) >> kBrickShift;
+
+    const size_t layer = static_cast<size_t>(m_bricks[0]) * m_bricks[1];
+    grid->m_ranges.assign(layer * grid->m_bricks[2],
+                          Range{std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()});
+    for (int z = 0; z < m_depth; ++z) {
+        const Range* source = m_sliceRanges.data() + static_cast<size_t>(z) * layer;
+        Range* target = grid->m_ranges.data() + static_cast<size_t>(z >> kBrickShift) * layer;
+        for (size_t i = 0; i < layer; ++i) {
+            target[i].min = std::min(target[i].min, source[i].min);
+            target[i].max = std::max(target[i].max, source[i].max);
+        }
+    }
+    return grid;
+}
+
+std::shared_ptr<const BrickRangeGrid> BrickRangeGrid::fromVolume(const Volume3D& volume, ThreadPool* pool)
+{
+    if (!volume.isValid()) {
+        return nullptr;
+    }
+
+    Builder builder(volume);
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    threads.parallelFor(static_cast<size_t>(volume.depth), [&](size_t, size_t begin, size_t end) {
+        for (size_t z = begin; z < end; ++z) {
+            builder.addSlice(volume, static_cast<int>(z));
+        }
+    });
+    return builder.build();
+}
+
+std::shared_ptr<const BrickRangeGrid> BrickRangeGrid::fromRanges(const int bricks[3], std::vector<Range> ranges)
+{
+    if (bricks[0] <= 0 || bricks[1] <= 0 || bricks[2] <= 0 ||
+        ranges.size() != static_cast<size_t>(bricks[0]) * bricks[1] * bricks[2]) {
+        return nullptr;
+    }
+
+    auto grid = std::make_shared<BrickRangeGrid>();
+    for (int i = 0; i < 3; ++i) {
+        grid->m_bricks[i] = bricks[i];
+    }
+    grid->m_ranges = std::move(ranges);
+    return grid;
+}
+
+BrickRangeGrid::Range BrickRangeGrid::getRange(int x0, int y0, int z0, int x1, int y1, int z1) const
+{
+    Range result{std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()};
+    const int bx0 = std::max(0, x0 >> kBrickShift), bx1 = std::min(m_bricks[0] - 1, x1 >> kBrickShift);
+    const int by0 = std::max(0, y0 >> kBrickShift), by1 = std::min(m_bricks[1] - 1, y1 >> kBrickShift);
+    const int bz0 = std::max(0, z0 >> kBrickShift), bz1 = std::min(m_bricks[2] - 1, z1 >> kBrickShift);
+    for (int bz = bz0; bz <= bz1; ++bz) {
+        for (int by = by0; by <= by1; ++by) {
+            for (int bx = bx0; bx <= bx1; ++bx) {
+                const Range& range = getRange(bx, by, bz);
+                result.min = std::min(result.min, range.min);
+                result.max = std::max(result.max, range.max);
+            }
+        }
+    }
+    return result;
+}
+
+size_t BrickRangeGrid::getOccupancy(float low, float high, std::vector<uint8_t>& mask) const
+{
+    mask.resize(m_ranges.size());
+    size_t occupied = 0;
+    for (size_t i = 0; i < m_ranges.size(); ++i) {
+        mask[i] = m_ranges[i].max >= low && m_ranges[i].min <= high;
+        occupied += mask[i];
+    }
+    return occupied;
+}
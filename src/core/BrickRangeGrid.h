@@ -0,0 +1,131 @@
+#pragma once
+
+#include "Volume3D.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Value range of every 16x16x16 brick of a volume
+ *
+ * A coarse acceleration structure for empty-space skipping: a renderer asks
+ * whether a brick can hold values in the range it cares about (above the MIP
+ * floor, inside the window, non-transparent in the transfer function) and
+ * skips it otherwise. Bricks line up with BrickedVolume's bricks. Ranges are
+ * in rescaled units, like Volume3D::vmin/vmax.
+ *
+ * The loader fills the grid while decoding: each slice adds the ranges of its
+ * brick columns while the slice is still in cache, and build() folds slices
+ * into bricks. fromVolume() computes it afterwards for volumes that were not
+ * decoded here.
+ */
+class BrickRangeGrid
+{
+public:
+    static constexpr int kBrickShift = 4;
+    static constexpr int kBrickSize = 1 << kBrickShift;
+
+    struct Range
+    {
+        float min;
+        float max;
+    };
+
+    /**
+     * @brief Collects per-slice brick column ranges during decoding
+     */
+    class Builder
+    {
+    public:
+        Builder() = default;
+
+        /**
+         * @brief Size the builder for a volume's dimensions
+         */
+        explicit Builder(const Volume3D& volume);
+
+        /**
+         * @brief Add the ranges of one decoded slice
+         *
+         * Safe to call concurrently for different slices.
+         */
+        void addSlice(const Volume3D& volume, int z);
+
+        /**
+         * @brief Fold the slices into the brick grid
+         * @return Grid, or nullptr if the builder was not sized
+         */
+        std::shared_ptr<const BrickRangeGrid> build() const;
+
+    private:
+        int m_bricks[2]{0, 0};
+        int m_depth{0};
+        std::vector<Range> m_sliceRanges;  // [z][by][bx]
+    };
+
+    /**
+     * @brief Compute the grid of an already loaded volume in parallel
+     * @param pool Pool to split slices over (nullptr = global pool)
+     */
+    static std::shared_ptr<const BrickRangeGrid> fromVolume(const Volume3D& volume, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Rebuild a grid from stored ranges (e.g. the volume cache)
+     * @return Grid, or nullptr if the range count does not match
+     */
+    static std::shared_ptr<const BrickRangeGrid> fromRanges(const int bricks[3], std::vector<Range> ranges);
+
+    /**
+     * @brief Number of bricks along x, y and z
+     */
+    int getBrickCount(int axis) const { return m_bricks[axis]; }
+
+    /**
+     * @brief Range of one brick
+     */
+    const Range& getRange(int bx, int by, int bz) const
+    {
+        return m_ranges[(static_cast<size_t>(bz) * m_bricks[1] + by) * m_bricks[0] + bx];
+    }
+
+    /**
+     * @brief All ranges, brick-row-major ([bz][by][bx])
+     */
+    const std::vector<Range>& getRanges() const { return m_ranges; }
+
+    /**
+     * @brief Range of the bricks overlapping a voxel box (inclusive bounds, clamped)
+     */
+    Range getRange(int x0, int y0, int z0, int x1, int y1, int z1) const;
+
+    /**
+     * @brief Check if a brick can hold values in [low, high]
+     */
+    bool overlaps(int bx, int by, int bz, float low, float high) const
+    {
+        const Range& range = getRange(bx, by, bz);
+        return range.max >= low && range.min <= high;
+    }
+
+    /**
+     * @brief Per-brick flag (1 = can hold values in [low, high]), brick-row-major
+     *
+     * Meant to be rebuilt when the window or transfer function changes and then
+     * consulted by a ray marcher per brick step.
+     *
+     * @return Number of occupied bricks
+     */
+    size_t getOccupancy(float low, float high, std::vector<uint8_t>& mask) const;
+
+    /**
+     * @brief Bytes held by the grid
+     */
+    size_t getMemoryUsage() const { return m_ranges.size() * sizeof(Range); }
+
+private:
+    int m_bricks[3]{0, 0, 0};
+    std::vector<Range> m_ranges;  // [bz][by][bx]
+};
@@ -0,0 +1,108 @@
+#include "BrickedVolume.h"
+#include "ThreadPool.h"
+#include <cstring>
+#include <new>
+
+namespace {
+    /**
+     * @brief Per-axis brick index: brick stride for the brick part, voxel stride inside the brick
+     */
+    std::vector<size_t> buildOffsets(int size, size_t brickStride, size_t voxelStride)
+    {
+        std::vector<size_t> offsets(static_cast<size_t>(size) + 1);
+        for (int i = 0; i < size; ++i) {
+            offsets[i] = static_cast<size_t>(i >> BrickedVolume::kBrickShift) * brickStride +
+                         static_cast<size_t>(i & BrickedVolume::kBrickMask) * voxelStride;
+        }
+        offsets[size] = offsets[size - 1];  // Clamp the +1 neighbour at the far edge
+        return offsets;
+    }
+
+    template <typename T>
+    void fillBricks(const T* source, T* bricks, int width, int height, int depth, const int brickCount[3],
+                    ThreadPool& pool)
+    {
+        constexpr int B = BrickedVolume::kBrickSize;
+        const size_t sliceSize = static_cast<size_t>(width) * height;
+        const size_t totalBricks = static_cast<size_t>(brickCount[0]) * brickCount[1] * brickCount[2];
+
+        pool.parallelFor(totalBricks, [&](size_t, size_t begin, size_t end) {
+            for (size_t brick = begin; brick < end; ++brick) {
+                const int bx = static_cast<int>(brick % brickCount[0]);
+                const int by = static_cast<int>((brick / brickCount[0]) % brickCount[1]);
+                const int bz = static_cast<int>(brick / (static_cast<size_t>(brickCount[0]) * brickCount[1]));
+                const int x0 = bx * B;
+                const int y0 = by * B;
+                const int z0 = bz * B;
+                const int spanX = std::min(B, width - x0);
+
+                // Each brick row is a copy of (part of) one source row; the rest is padding
+                T* out = bricks + brick * BrickedVolume::kBrickVoxels;
+                for (int lz = 0; lz < B; ++lz) {
+                    for (int ly = 0; ly < B; ++ly, out += B) {
+                        const int y = y0 + ly;
+                        const int z = z0 + lz;
+                        if (y >= height || z >= depth) {
+                            std::memset(out, 0, B * sizeof(T));
+                            continue;
+                        }
+                        const T* row = source + static_cast<size_t>(z) * sliceSize + static_cast<size_t>(y) * width + x0;
+                        std::memcpy(out, row, spanX * sizeof(T));
+                        if (spanX < B) {
+                            std::memset(out + spanX, 0, (B - spanX) * sizeof(T));
+                        }
+                    }
+                }
+            }
+        }, 4);
+    }
+}
+
+BrickedVolume BrickedVolume::fromVolume(const Volume3D& volume, ThreadPool* pool)
+{
+    BrickedVolume result;
+    if (!volume.isValid()) {
+        return result;
+    }
+
+    result.m_width = volume.width;
+    result.m_height = volume.height;
+    result.m_depth = volume.depth;
+    result.m_bricks[0] = (volume.width + kBrickMask) >> kBrickShift;
+    result.m_bricks[1] = (volume.height + kBrickMask) >> kBrickShift;
+    result.m_bricks[2] = (volume.depth + kBrickMask) >> kBrickShift;
+    result.m_voxelType = volume.voxelType;
+    if (volume.voxelType != Volume3D::VoxelType::Float32) {
+        result.m_slope = volume.storedSlope;
+        result.m_intercept = volume.storedIntercept;
+    }
+
+    const size_t brickRow = static_cast<size_t>(result.m_bricks[0]) * kBrickVoxels;
+    const size_t brickSlab = brickRow * result.m_bricks[1];
+    result.m_xOffset = buildOffsets(volume.width, kBrickVoxels, 1);
+    result.m_yOffset = buildOffsets(volume.height, brickRow, kBrickSize);
+    result.m_zOffset = buildOffsets(volume.depth, brickSlab, static_cast<size_t>(kBrickSize) * kBrickSize);
+
+    const size_t bytes = brickSlab * result.m_bricks[2] * Volume3D::getVoxelTypeSize(volume.voxelType);
+    result.m_data = std::shared_ptr<void>(::operator new(bytes, std::align_val_t(64)),
+                                          [](void* block) { ::operator delete(block, std::align_val_t(64)); });
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    volume.visitVoxels([&](const auto& view) {
+        using T = std::remove_const_t<std::remove_pointer_t<decltype(view.data)>>;
+        fillBricks<T>(view.data, static_cast<T*>(result.m_data.get()),
+                      volume.width, volume.height, volume.depth, result.m_bricks, threads);
+    });
+
+    return result;
+}
+
+size_t BrickedVolume::getMemoryUsage() const
+{
+    if (!isValid()) {
+        return 0;
+    }
+    const size_t bricks = static_cast<size_t>(m_bricks[0]) * m_bricks[1] * m_bricks[2];
+    return bricks * kBrickVoxels * Volume3D::getVoxelTypeSize(m_voxelType) +
+           (m_xOffset.size() + m_yOffset.size() + m_zOffset.size()) * sizeof(size_t);
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "Volume3D.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Typed read access to a bricked voxel buffer
+ *
+ * The element of voxel (x, y, z) is at xOffset[x] + yOffset[y] + zOffset[z].
+ * Each table has one extra entry repeating the last voxel, so the +1 neighbour
+ * used by trilinear interpolation never needs a bounds branch.
+ */
+template <typename T>
+struct BrickedView
+{
+    const T* data{nullptr};
+    const size_t* xOffset{nullptr};
+    const size_t* yOffset{nullptr};
+    const size_t* zOffset{nullptr};
+    double slope{1.0};
+    double intercept{0.0};
+
+    size_t indexOf(int x, int y, int z) const
+    {
+        return xOffset[x] + yOffset[y] + zOffset[z];
+    }
+
+    float valueAt(size_t index) const
+    {
+        if constexpr (std::is_same_v<T, float>) {
+            return data[index];
+        } else {
+            return static_cast<float>(intercept + slope * static_cast<float>(data[index]));
+        }
+    }
+
+    float valueAt(int x, int y, int z) const
+    {
+        return valueAt(indexOf(x, y, z));
+    }
+
+    /**
+     * @brief Trilinear sample at a voxel position inside [0, dim-1] on every axis
+     */
+    float sampleLinear(float fx, float fy, float fz) const
+    {
+        const int x = static_cast<int>(fx);
+        const int y = static_cast<int>(fy);
+        const int z = static_cast<int>(fz);
+        const float tx = fx - x;
+        const float ty = fy - y;
+        const float tz = fz - z;
+
+        const size_t x0 = xOffset[x], x1 = xOffset[x + 1];
+        const size_t y0 = yOffset[y], y1 = yOffset[y + 1];
+        const size_t z0 = zOffset[z], z1 = zOffset[z + 1];
+
+        const float c00 = valueAt(x0 + y0 + z0) + tx * (valueAt(x1 + y0 + z0) - valueAt(x0 + y0 + z0));
+        const float c10 = valueAt(x0 + y1 + z0) + tx * (valueAt(x1 + y1 + z0) - valueAt(x0 + y1 + z0));
+        const float c01 = valueAt(x0 + y0 + z1) + tx * (valueAt(x1 + y0 + z1) - valueAt(x0 + y0 + z1));
+        const float c11 = valueAt(x0 + y1 + z1) + tx * (valueAt(x1 + y1 + z1) - valueAt(x0 + y1 + z1));
+        const float c0 = c00 + ty * (c10 - c00);
+        const float c1 = c01 + ty * (c11 - c01);
+        return c0 + tz * (c1 - c0);
+    }
+};
+
+/**
+ * @brief Volume voxels re-laid out in 16x16x16 bricks
+ *
+ * In the linear [z][y][x] layout a coronal or sagittal walk strides by whole
+ * rows or slices, touching a new cache line (and often a new page) per
+ * sample. Bricks keep every 16^3 neighbourhood in 4 KiB of contiguous memory
+ * (int16), so all three orthogonal planes and oblique planes read from a
+ * small working set.
+ *
+ * Bricks are stored brick-row-major; voxels inside a brick are [z][y][x].
+ * Edge bricks are padded with the stored value 0. The voxel type and rescale
+ * of the source volume are kept, so values match Volume3D::getVoxel exactly.
+ * Geometry stays on the Volume3D the bricks were built from.
+ */
+class BrickedVolume
+{
+public:
+    static constexpr int kBrickShift = 4;
+    static constexpr int kBrickSize = 1 << kBrickShift;
+    static constexpr int kBrickMask = kBrickSize - 1;
+    static constexpr size_t kBrickVoxels = static_cast<size_t>(kBrickSize) * kBrickSize * kBrickSize;
+
+    BrickedVolume() = default;
+
+    /**
+     * @brief Build the bricked copy of a volume's voxels
+     *
+     * Bricks are filled in parallel.
+     *
+     * @param volume Source volume (float32 or native storage)
+     * @param pool Pool to fill the bricks on (nullptr = global pool)
+     * @return Bricked volume, or invalid one if the volume is invalid
+     */
+    static BrickedVolume fromVolume(const Volume3D& volume, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Check if the bricked buffer holds data
+     */
+    bool isValid() const { return m_data != nullptr; }
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+    int getDepth() const { return m_depth; }
+    Volume3D::VoxelType getVoxelType() const { return m_voxelType; }
+
+    /**
+     * @brief Number of bricks along x, y and z
+     */
+    int getBrickCount(int axis) const { return m_bricks[axis]; }
+
+    /**
+     * @brief Bytes held by the bricked buffer (including edge padding) and its index tables
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * @brief Call fn(const BrickedView<T>&) with the typed bricked buffer
+     */
+    template <typename Fn>
+    decltype(auto) visitVoxels(Fn&& fn) const
+    {
+        switch (m_voxelType) {
+        case Volume3D::VoxelType::Int16:
+            return fn(makeView<int16_t>());
+        case Volume3D::VoxelType::UInt16:
+            return fn(makeView<uint16_t>());
+        case Volume3D::VoxelType::UInt8:
+            return fn(makeView<uint8_t>());
+        default:
+            return fn(makeView<float>());
+        }
+    }
+
+    /**
+     * @brief Get voxel value at position (x, y, z), or 0.0f out of bounds
+     */
+    float getVoxel(int x, int y, int z) const
+    {
+        if (x < 0 || x >= m_width || y < 0 || y >= m_height || z < 0 || z >= m_depth) {
+            return 0.0f;
+        }
+        return visitVoxels([x, y, z](const auto& view) { return view.valueAt(x, y, z); });
+    }
+
+private:
+    template <typename T>
+    BrickedView<T> makeView() const
+    {
+        return BrickedView<T>{static_cast<const T*>(m_data.get()), m_xOffset.data(), m_yOffset.data(),
+                              m_zOffset.data(), m_slope, m_intercept};
+    }
+
+    int m_width{0};
+    int m_height{0};
+    int m_depth{0};
+    int m_bricks[3]{0, 0, 0};
+
+    Volume3D::VoxelType m_voxelType{Volume3D::VoxelType::Float32};
+    double m_slope{1.0};
+    double m_intercept{0.0};
+
+    std::shared_ptr<void> m_data;
+
+    // Brick index: per-axis element offsets, dimension + 1 entries each
+    std::vector<size_t> m_xOffset;
+    std::vector<size_t> m_yOffset;
+    std::vector<size_t> m_zOffset;
+};
@@ -0,0 +1,66 @@
+#include "CpuFeatures.h"
+
+#if AMPR_HAS_X86_SIMD && defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace {
+    CpuFeatures::InstructionSet detectInstructionSet()
+    {
+#if AMPR_HAS_X86_SIMD && defined(_MSC_VER) && !defined(__clang__)
+        int info[4] = {0, 0, 0, 0};
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool sse41 = (info[2] & (1 << 19)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx = (info[2] & (1 << 28)) != 0;
+
+        bool avx2 = false;
+        if (maxLeaf >= 7 && osxsave && avx) {
+            // The OS must save YMM state on context switches
+            const unsigned long long xcr0 = _xgetbv(0);
+            if ((xcr0 & 0x6) == 0x6) {
+                __cpuidex(info, 7, 0);
+                avx2 = (info[1] & (1 << 5)) != 0;
+            }
+        }
+
+        if (avx2) {
+            return CpuFeatures::InstructionSet::AVX2;
+        }
+        return sse41 ? CpuFeatures::InstructionSet::SSE41 : CpuFeatures::InstructionSet::Scalar;
+#elif AMPR_HAS_X86_SIMD
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return CpuFeatures::InstructionSet::AVX2;
+        }
+        if (__builtin_cpu_supports("sse4.1")) {
+            return CpuFeatures::InstructionSet::SSE41;
+        }
+        return CpuFeatures::InstructionSet::Scalar;
+#else
+        return CpuFeatures::InstructionSet::Scalar;
+#endif
+    }
+}
+
+CpuFeatures::InstructionSet CpuFeatures::getBestInstructionSet()
+{
+    static const InstructionSet best = detectInstructionSet();
+    return best;
+}
+
+const char* CpuFeatures::getName(InstructionSet set)
+{
+    switch (set) {
+    case InstructionSet::AVX2:
+        return "AVX2";
+    case InstructionSet::SSE41:
+        return "SSE4.1";
+    default:
+        return "Scalar";
+    }
+}
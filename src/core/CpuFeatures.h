@@ -0,0 +1,51 @@
+#pragma once
+
+/**
+ * @brief Runtime CPU feature detection for SIMD kernel dispatch
+ *
+ * Kernels for a specific instruction set are compiled with AMPR_TARGET_SSE41 /
+ * AMPR_TARGET_AVX2 so the rest of the build keeps its baseline flags; callers
+ * check the matching query before invoking them.
+ */
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define AMPR_HAS_X86_SIMD 1
+#else
+#define AMPR_HAS_X86_SIMD 0
+#endif
+
+#if AMPR_HAS_X86_SIMD && (defined(__GNUC__) || defined(__clang__))
+#define AMPR_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define AMPR_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+// MSVC emits any intrinsic regardless of /arch, so no per-function attribute is needed
+#define AMPR_TARGET_SSE41
+#define AMPR_TARGET_AVX2
+#endif
+
+class CpuFeatures
+{
+public:
+    /**
+     * @brief SIMD instruction sets kernels are specialized for, in increasing order
+     */
+    enum class InstructionSet
+    {
+        Scalar,
+        SSE41,
+        AVX2
+    };
+
+    /**
+     * @brief Best instruction set supported by both the CPU and the OS
+     */
+    static InstructionSet getBestInstructionSet();
+
+    static bool hasSSE41() { return getBestInstructionSet() >= InstructionSet::SSE41; }
+    static bool hasAVX2() { return getBestInstructionSet() >= InstructionSet::AVX2; }
+
+    /**
+     * @brief Human readable name ("Scalar", "SSE4.1", "AVX2")
+     */
+    static const char* getName(InstructionSet set);
+};
@@ -0,0 +1,307 @@
+#include "DicomScanIndex.h"
+#include "BinaryStream.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <iomanip>
+
+namespace {
+    constexpr char kMagic[8] = {'A', 'M', 'P', 'R', 'S', 'I', 'D', 'X'};
+    constexpr uint32_t kByteOrderMark = 0x01020304u;
+
+    std::string seriesKey(const DicomSeriesLoader::SeriesInfo& series)
+    {
+        std::string key;
+        for (const std::string* field : {&series.seriesUID, &series.modality, &series.seriesDescription,
+                                         &series.patientID, &series.studyUID, &series.studyDate}) {
+            key += *field;
+            key += '\x1f';
+        }
+        key.append(reinterpret_cast<const char*>(&series.sliceThickness), sizeof(series.sliceThickness));
+        return key;
+    }
+
+    void writeSlice(BinaryWriter& out, const DicomSeriesLoader::SliceInfo& slice)
+    {
+        out.putRaw(slice.imagePosition, sizeof(slice.imagePosition));
+        out.putRaw(slice.imageOrientation, sizeof(slice.imageOrientation));
+        out.put(slice.sliceLocation);
+        out.put(static_cast<int32_t>(slice.instanceNumber));
+        out.put(static_cast<int32_t>(slice.rows));
+        out.put(static_cast<int32_t>(slice.columns));
+        out.put(static_cast<uint16_t>(slice.bitsAllocated));
+        out.put(static_cast<uint16_t>(slice.bitsStored));
+        out.put(static_cast<uint8_t>(slice.pixelRepresentation));
+        out.put(static_cast<uint8_t>(slice.hasRescale ? 1 : 0));
+        out.put(slice.rescaleIntercept);
+        out.put(slice.rescaleSlope);
+        out.putRaw(slice.pixelSpacing, sizeof(slice.pixelSpacing));
+        out.putString(slice.units);
+        out.putString(slice.decayCorrection);
+        out.put(slice.patientWeight);
+        out.put(slice.injectedDose);
+        out.put(slice.halfLife);
+        out.put(slice.injectionTime);
+        out.put(slice.seriesTime);
+        out.put(slice.acquisitionTime);
+    }
+
+    bool readSlice(BinaryReader& in, DicomSeriesLoader::SliceInfo& slice)
+    {
+        int32_t instanceNumber = 0, rows = 0, columns = 0;
+        uint16_t bitsAllocated = 0, bitsStored = 0;
+        uint8_t pixelRepresentation = 0, hasRescale = 0;
+
+        if (!in.getRaw(slice.imagePosition, sizeof(slice.imagePosition)) ||
+            !in.getRaw(slice.imageOrientation, sizeof(slice.imageOrientation)) ||
+            !in.get(slice.sliceLocation) ||
+            !in.get(instanceNumber) || !in.get(rows) || !in.get(columns) ||
+            !in.get(bitsAllocated) || !in.get(bitsStored) ||
+            !in.get(pixelRepresentation) || !in.get(hasRescale) ||
+            !in.get(slice.rescaleIntercept) || !in.get(slice.rescaleSlope) ||
+            !in.getRaw(slice.pixelSpacing, sizeof(slice.pixelSpacing)) ||
+            !in.getString(slice.units) || !in.getString(slice.decayCorrection) ||
+            !in.get(slice.patientWeight) || !in.get(slice.injectedDose) || !in.get(slice.halfLife) ||
+            !in.get(slice.injectionTime) || !in.get(slice.seriesTime) || !in.get(slice.acquisitionTime)) {
+            return false;
+        }
+
+        slice.instanceNumber = instanceNumber;
+        slice.rows = rows;
+        slice.columns = columns;
+        slice.bitsAllocated = bitsAllocated;
+        slice.bitsStored = bitsStored;
+        slice.pixelRepresentation = pixelRepresentation;
+        slice.hasRescale = hasRescale != 0;
+        return true;
+    }
+}
+
+std::string DicomScanIndex::indexPathFor(const std::string& cacheDirectory, const std::string& rootDirectory)
+{
+    // FNV-1a of the root path gives a stable, filesystem-safe file name
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : rootDirectory) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+
+    std::ostringstream name;
+    name << "scan-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".idx";
+    return (std::filesystem::path(cacheDirectory) / name.str()).string();
+}
+
+bool DicomScanIndex::load(const std::string& indexPath, const std::string& rootDirectory)
+{
+    m_series.clear();
+    m_seriesLookup.clear();
+    m_entries.clear();
+
+    try {
+        std::ifstream file(indexPath, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        BinaryReader in(data.data(), data.size());
+        char magic[sizeof(kMagic)];
+        uint32_t version = 0, byteOrder = 0;
+        std::string root;
+        if (!in.getRaw(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+            !in.get(version) || version != kFormatVersion ||
+            !in.get(byteOrder) || byteOrder != kByteOrderMark ||
+            !in.getString(root) || root != rootDirectory) {
+            return false;
+        }
+
+        uint32_t seriesCount = 0;
+        if (!in.get(seriesCount)) {
+            return false;
+        }
+        m_series.resize(seriesCount);
+        for (uint32_t i = 0; i < seriesCount; ++i) {
+            DicomSeriesLoader::SeriesInfo& series = m_series[i];
+            if (!in.getString(series.seriesUID) || !in.getString(series.modality) ||
+                !in.getString(series.seriesDescription) || !in.getString(series.patientID) ||
+                !in.getString(series.studyUID) || !in.getString(series.studyDate) ||
+                !in.get(series.sliceThickness)) {
+                m_series.clear();
+                return false;
+            }
+            m_seriesLookup.emplace(seriesKey(series), static_cast<int32_t>(i));
+        }
+
+        uint32_t entryCount = 0;
+        if (!in.get(entryCount)) {
+            m_series.clear();
+            m_seriesLookup.clear();
+            return false;
+        }
+        m_entries.reserve(entryCount);
+        for (uint32_t i = 0; i < entryCount; ++i) {
+            std::string relativePath;
+            Entry entry;
+            bool ok = in.getString(relativePath) && in.get(entry.fileSize) &&
+                      in.get(entry.modifiedTime) && in.get(entry.seriesIndex);
+            if (ok && entry.seriesIndex >= 0) {
+                ok = static_cast<uint32_t>(entry.seriesIndex) < seriesCount && readSlice(in, entry.slice);
+            }
+            if (!ok) {
+                m_series.clear();
+                m_seriesLookup.clear();
+                m_entries.clear();
+                return false;
+            }
+
+            std::string filePath = rootDirectory + relativePath;
+            entry.slice.filePath = filePath;
+            m_entries.emplace(std::move(filePath), std::move(entry));
+        }
+
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception loading scan index " << indexPath << ": " << e.what() << std::endl;
+        m_series.clear();
+        m_seriesLookup.clear();
+        m_entries.clear();
+        return false;
+    }
+}
+
+bool DicomScanIndex::save(const std::string& indexPath, const std::string& rootDirectory) const
+{
+    try {
+        BinaryWriter out;
+        out.putRaw(kMagic, sizeof(kMagic));
+        out.put(kFormatVersion);
+        out.put(kByteOrderMark);
+        out.putString(rootDirectory);
+
+        out.put(static_cast<uint32_t>(m_series.size()));
+        for (const auto& series : m_series) {
+            out.putString(series.seriesUID);
+            out.putString(series.modality);
+            out.putString(series.seriesDescription);
+            out.putString(series.patientID);
+            out.putString(series.studyUID);
+            out.putString(series.studyDate);
+            out.put(series.sliceThickness);
+        }
+
+        // Paths are stored relative to the root; entries outside it are skipped
+        uint32_t entryCount = 0;
+        for (const auto& pair : m_entries) {
+            if (pair.first.compare(0, rootDirectory.size(), rootDirectory) == 0) {
+                ++entryCount;
+            }
+        }
+        out.put(entryCount);
+        for (const auto& pair : m_entries) {
+            if (pair.first.compare(0, rootDirectory.size(), rootDirectory) != 0) {
+                continue;
+            }
+            const Entry& entry = pair.second;
+            out.putString(pair.first.substr(rootDirectory.size()));
+            out.put(entry.fileSize);
+            out.put(entry.modifiedTime);
+            out.put(entry.seriesIndex);
+            if (entry.seriesIndex >= 0) {
+                writeSlice(out, entry.slice);
+            }
+        }
+
+        const std::filesystem::path target(indexPath);
+        if (target.has_parent_path()) {
+            std::filesystem::create_directories(target.parent_path());
+        }
+
+        const std::filesystem::path temporary = makeTemporaryPath(target);
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                return false;
+            }
+            file.write(out.data().data(), static_cast<std::streamsize>(out.data().size()));
+            if (!file) {
+                file.close();
+                std::filesystem::remove(temporary);
+                return false;
+            }
+        }
+        std::error_code renameError;
+        std::filesystem::rename(temporary, target, renameError);
+        if (renameError) {
+            std::filesystem::remove(temporary, renameError);
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception saving scan index " << indexPath << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+const DicomScanIndex::Entry* DicomScanIndex::find(const std::string& filePath, uint64_t fileSize,
+                                                   int64_t modifiedTime) const
+{
+    auto it = m_entries.find(filePath);
+    if (it == m_entries.end() || it->second.fileSize != fileSize || it->second.modifiedTime != modifiedTime) {
+        return nullptr;
+    }
+    return &it->second;
+}
+
+const DicomSeriesLoader::SeriesInfo& DicomScanIndex::getSeries(const Entry& entry) const
+{
+    return m_series[static_cast<size_t>(entry.seriesIndex)];
+}
+
+void DicomScanIndex::addDicomFile(const std::string& filePath, uint64_t fileSize, int64_t modifiedTime,
+                                  const DicomSeriesLoader::SeriesInfo& series,
+                                  const DicomSeriesLoader::SliceInfo& slice)
+{
+    Entry entry;
+    entry.fileSize = fileSize;
+    entry.modifiedTime = modifiedTime;
+    entry.seriesIndex = findOrAddSeries(series);
+    entry.slice = slice;
+    m_entries[filePath] = std::move(entry);
+}
+
+void DicomScanIndex::addNonDicomFile(const std::string& filePath, uint64_t fileSize, int64_t modifiedTime)
+{
+    Entry entry;
+    entry.fileSize = fileSize;
+    entry.modifiedTime = modifiedTime;
+    m_entries[filePath] = std::move(entry);
+}
+
+int32_t DicomScanIndex::findOrAddSeries(const DicomSeriesLoader::SeriesInfo& series)
+{
+    std::string key = seriesKey(series);
+    auto it = m_seriesLookup.find(key);
+    if (it != m_seriesLookup.end()) {
+        return it->second;
+    }
+
+    // Only series-level fields are kept in the table
+    DicomSeriesLoader::SeriesInfo fields;
+    fields.seriesUID = series.seriesUID;
+    fields.modality = series.modality;
+    fields.seriesDescription = series.seriesDescription;
+    fields.patientID = series.patientID;
+    fields.studyUID = series.studyUID;
+    fields.studyDate = series.studyDate;
+    fields.sliceThickness = series.sliceThickness;
+
+    const int32_t slot = static_cast<int32_t>(m_series.size());
+    m_series.push_back(std::move(fields));
+    m_seriesLookup.emplace(std::move(key), slot);
+    return slot;
+}
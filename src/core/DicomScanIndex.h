@@ -0,0 +1,95 @@
+#pragma once
+
+#include "DicomSeriesLoader.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Persistent per-directory index of scanned DICOM headers
+ *
+ * Records every regular file seen under a scanned root together with its size,
+ * modification time and the header fields extracted by the scan (or the fact
+ * that it is not DICOM). A rescan only re-parses files whose size or mtime
+ * changed; the index is rewritten from the files actually enumerated, so
+ * removed files drop out automatically.
+ *
+ * File layout (native byte order, version checked on load):
+ *   magic "AMPRSIDX", u32 version, u32 byte-order mark, root path,
+ *   series table (series-level fields, stored once per distinct series),
+ *   entries (relative path, size, mtime, series index or -1, slice fields)
+ */
+class DicomScanIndex
+{
+public:
+    /**
+     * @brief Cached scan result for one file
+     */
+    struct Entry
+    {
+        uint64_t fileSize{0};
+        int64_t modifiedTime{0};           // std::filesystem::file_time_type ticks
+        int32_t seriesIndex{-1};           // Index into the series table, -1 = not DICOM
+        DicomSeriesLoader::SliceInfo slice; // Slice-level fields (DICOM files only)
+    };
+
+    /**
+     * @brief Load the index for a root directory
+     * @param indexPath Index file path
+     * @param rootDirectory Root the index must belong to
+     * @return true if a valid index for this root was loaded
+     */
+    bool load(const std::string& indexPath, const std::string& rootDirectory);
+
+    /**
+     * @brief Write the index atomically (uniquely named temporary file + rename)
+     * @return true on success
+     */
+    bool save(const std::string& indexPath, const std::string& rootDirectory) const;
+
+    /**
+     * @brief Look up a file whose size and mtime still match the recorded ones
+     * @return Entry pointer, or nullptr if unknown or changed
+     */
+    const Entry* find(const std::string& filePath, uint64_t fileSize, int64_t modifiedTime) const;
+
+    /**
+     * @brief Series-level fields for an entry (valid when entry.seriesIndex >= 0)
+     */
+    const DicomSeriesLoader::SeriesInfo& getSeries(const Entry& entry) const;
+
+    /**
+     * @brief Record a DICOM file
+     */
+    void addDicomFile(const std::string& filePath, uint64_t fileSize, int64_t modifiedTime,
+                      const DicomSeriesLoader::SeriesInfo& series,
+                      const DicomSeriesLoader::SliceInfo& slice);
+
+    /**
+     * @brief Record a file that failed to parse as DICOM
+     */
+    void addNonDicomFile(const std::string& filePath, uint64_t fileSize, int64_t modifiedTime);
+
+    /**
+     * @brief Number of recorded files
+     */
+    size_t size() const { return m_entries.size(); }
+
+    /**
+     * @brief Index file location for a root inside a cache directory
+     *
+     * The root is hashed as given; pass its canonical path so that different
+     * spellings of the same directory map to one file.
+     */
+    static std::string indexPathFor(const std::string& cacheDirectory, const std::string& rootDirectory);
+
+    static constexpr uint32_t kFormatVersion = 2;
+
+private:
+    int32_t findOrAddSeries(const DicomSeriesLoader::SeriesInfo& series);
+
+    std::vector<DicomSeriesLoader::SeriesInfo> m_series;
+    std::unordered_map<std::string, int32_t> m_seriesLookup; // series-level fields -> table slot
+    std::unordered_map<std::string, Entry> m_entries;        // keyed by full file path
+};
@@ -1,8 +1,14 @@
 #include "DicomSeriesLoader.h"
+#include "BrickRangeGrid.h"
+#include "PixelConversion.h"
+#include "ThreadPool.h"
+#include "VolumeHistogram.h"
 #include <gdcmReader.h>
 #include <gdcmFile.h>
 #include <gdcmDataSet.h>
 #include <gdcmAttribute.h>
+#include <gdcmItem.h>
+#include <gdcmSequenceOfItems.h>
 #include <gdcmImageReader.h>
 #include <gdcmImage.h>
 #include <gdcmPixelFormat.h>
@@ -11,8 +17,93 @@
 #include <algorithm>
 #include <cmath>
 #include <sstream>
+#include <cstdlib>
+#include <cstring>
 
-std::string DicomSeriesLoader::s_lastError;
+namespace {
+    /**
+     * @brief String value without DICOM padding (spaces, NUL)
+     */
+    template <uint16_t Group, uint16_t Element>
+    std::string readString(const gdcm::DataSet& ds)
+    {
+        gdcm::Attribute<Group, Element> attribute;
+        attribute.SetFromDataSet(ds);
+        if (!ds.FindDataElement(attribute.GetTag())) {
+            return std::string();
+        }
+        std::string value = attribute.GetValue();
+        const size_t first = value.find_first_not_of(std::string(" \0", 2));
+        const size_t last = value.find_last_not_of(std::string(" \0", 2));
+        return first == std::string::npos ? std::string() : value.substr(first, last - first + 1);
+    }
+
+    bool isDigits(const std::string& text, size_t begin, size_t end)
+    {
+        if (end > text.size()) {
+            return false;
+        }
+        for (size_t i = begin; i < end; ++i) {
+            if (text[i] < '0' || text[i] > '9') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @brief DA "YYYYMMDD" to days since 1970-01-01
+     */
+    bool parseDate(const std::string& text, int64_t& days)
+    {
+        if (!isDigits(text, 0, 8)) {
+            return false;
+        }
+        int64_t year = std::atoi(text.substr(0, 4).c_str());
+        const int64_t month = std::atoi(text.substr(4, 2).c_str());
+        const int64_t day = std::atoi(text.substr(6, 2).c_str());
+        if (month < 1 || month > 12 || day < 1 || day > 31) {
+            return false;
+        }
+
+        // Proleptic Gregorian day count (civil-from-days inverse)
+        year -= month <= 2 ? 1 : 0;
+        const int64_t era = (year >= 0 ? year : year - 399) / 400;
+        const int64_t yearOfEra = year - era * 400;
+        const int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        const int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        days = era * 146097 + dayOfEra - 719468;
+        return true;
+    }
+
+    /**
+     * @brief TM "HHMMSS.FFFFFF" (trailing fields optional, ACR-NEMA "HH:MM:SS" accepted) to seconds
+     * @return Seconds since midnight, NaN if malformed
+     */
+    double parseTime(const std::string& text)
+    {
+        std::string value;
+        for (char c : text) {
+            if (c != ':') {
+                value += c;
+            }
+        }
+        if (!isDigits(value, 0, 2)) {
+            return std::numeric_limits<double>::quiet_NaN();
+        }
+        double seconds = std::atoi(value.substr(0, 2).c_str()) * 3600.0;
+        if (isDigits(value, 2, 4)) {
+            seconds += std::atoi(value.substr(2, 2).c_str()) * 60.0;
+            if (isDigits(value, 4, 6)) {
+                // strtod stops at a DT time zone suffix
+                seconds += std::strtod(value.c_str() + 4, nullptr);
+            }
+        }
+        return seconds;
+    }
+}
+
+thread_local std::string DicomSeriesLoader::s_lastError;
 
 std::string DicomSeriesLoader::getLastError()
 {
@@ -35,53 +126,190 @@ Volume3D DicomSeriesLoader::loadFromDirectory(const std::string& directory, cons
     }
 }
 
-Volume3D DicomSeriesLoader::loadFromSeriesInfo(const SeriesInfo& seriesInfo)
+Volume3D DicomSeriesLoader::loadFromSeriesInfo(const SeriesInfo& seriesInfo, const SeriesLoadOptions& options)
 {
     s_lastError.clear();
     
+    try {
+        std::vector<SliceInfo> slices;
+        Volume3D volume;
+        if (!prepareVolume(seriesInfo, options, false, slices, volume)) {
+            return Volume3D{};
+        }
+        const bool nativeStorage = volume.voxelType != Volume3D::VoxelType::Float32;
+        LoadProgress* progress = options.progress;
+        if (progress) {
+            progress->slicesTotal.store(slices.size());
+        }
+        
+        // Decode each file once, straight into its sorted position in the volume.
+        // Slices are split into contiguous chunks decoded concurrently; each chunk
+        // keeps its own raw buffer and min/max, reduced after all chunks finish;
+        // histogram partials are per thread.
+        const size_t sliceSize = static_cast<size_t>(volume.width) * volume.height;
+        const size_t storedSliceBytes = sliceSize * Volume3D::getVoxelTypeSize(volume.voxelType);
+        char* storedBase = static_cast<char*>(volume.storedVoxels.get());
+        const uint64_t rawSliceBytes = sliceSize * static_cast<uint64_t>((slices[0].bitsAllocated + 7) / 8);
+        
+        struct ChunkResult
+        {
+            float vmin{std::numeric_limits<float>::max()};
+            float vmax{std::numeric_limits<float>::lowest()};
+            int32_t storedMin{std::numeric_limits<int32_t>::max()};
+            int32_t storedMax{std::numeric_limits<int32_t>::min()};
+            size_t failedSlice{std::numeric_limits<size_t>::max()};
+            bool cancelled{false};
+        };
+        
+        ThreadPool pool(options.threadCount);
+        std::vector<ChunkResult> chunkResults(pool.getChunkCount(slices.size()));
+        BrickRangeGrid::Builder brickRanges(volume);
+        VolumeHistogram::Builder histogram(volume, pool.getThreadCount());
+        
+        pool.parallelFor(slices.size(), [&](size_t chunk, size_t begin, size_t end) {
+            ChunkResult& result = chunkResults[chunk];
+            std::vector<char> buffer;  // Raw pixel buffer reused across this chunk's slices
+            const size_t histogramPartial = VolumeHistogram::Builder::getPoolPartial(pool);
+            
+            for (size_t i = begin; i < end; ++i) {
+                if (progress && progress->isCancelled()) {
+                    result.cancelled = true;
+                    return;
+                }
+                const bool ok = nativeStorage
+                    ? loadStoredPixelData(slices[i], storedBase + i * storedSliceBytes, buffer,
+                                          result.storedMin, result.storedMax)
+                    : loadPixelData(slices[i], volume.voxels.data() + i * sliceSize, buffer,
+                                    result.vmin, result.vmax);
+                if (!ok) {
+                    result.failedSlice = i;
+                    return;
+                }
+                // Brick ranges and histogram while the slice is still in cache
+                brickRanges.addSlice(volume, static_cast<int>(i));
+                histogram.addSlice(volume, static_cast<int>(i), histogramPartial);
+                if (progress) {
+                    progress->slicesDecoded.fetch_add(1, std::memory_order_relaxed);
+                    progress->bytesDecoded.fetch_add(rawSliceBytes, std::memory_order_relaxed);
+                }
+            }
+        });
+        
+        volume.vmin = std::numeric_limits<float>::max();
+        volume.vmax = std::numeric_limits<float>::lowest();
+        int32_t storedMin = std::numeric_limits<int32_t>::max();
+        int32_t storedMax = std::numeric_limits<int32_t>::min();
+        for (const auto& result : chunkResults) {
+            if (result.cancelled) {
+                s_lastError = "Loading cancelled";
+                return Volume3D{};
+            }
+        }
+        for (const auto& result : chunkResults) {
+            if (result.failedSlice != std::numeric_limits<size_t>::max()) {
+                s_lastError = "Failed to load pixel data for slice " + std::to_string(result.failedSlice);
+                return Volume3D{};
+            }
+            volume.vmin = std::min(volume.vmin, result.vmin);
+            volume.vmax = std::max(volume.vmax, result.vmax);
+            storedMin = std::min(storedMin, result.storedMin);
+            storedMax = std::max(storedMax, result.storedMax);
+        }
+        
+        if (nativeStorage) {
+            getStoredValueRange(volume, storedMin, storedMax, volume.vmin, volume.vmax);
+        }
+        volume.brickRanges = brickRanges.build();
+        volume.histogram = histogram.build();
+        
+        std::cout << "Volume loaded successfully:" << std::endl;
+        std::cout << "  Series: " << volume.seriesUID << std::endl;
+        std::cout << "  Modality: " << volume.modality << std::endl;
+        std::cout << "  Dimensions: " << volume.width << "x" << volume.height << "x" << volume.depth << std::endl;
+        std::cout << "  Spacing: " << volume.spacing[0] << ", " << volume.spacing[1] << ", " << volume.spacing[2] << " mm" << std::endl;
+        std::cout << "  Origin: " << volume.origin[0] << ", " << volume.origin[1] << ", " << volume.origin[2] << " mm" << std::endl;
+        std::cout << "  Value range: " << volume.vmin << " to " << volume.vmax << std::endl;
+        std::cout << "  Voxel memory: " << volume.getVoxelMemoryUsage() / (1024 * 1024) << " MB"
+                  << (nativeStorage ? " (native)" : "") << std::endl;
+        if (volume.pet) {
+            std::cout << "  PET: units " << volume.pet->units << ", decay correction " << volume.pet->decayCorrection
+                      << ", dose " << volume.pet->injectedDose << " Bq, weight " << volume.pet->patientWeight
+                      << " kg" << std::endl;
+        }
+        
+        return volume;
+    }
+    catch (const std::exception& e) {
+        s_lastError = std::string("Exception in loadFromSeriesInfo: ") + e.what();
+        return Volume3D{};
+    }
+}
+
+bool DicomSeriesLoader::prepareVolume(const SeriesInfo& seriesInfo, const SeriesLoadOptions& options,
+                                      bool zeroFill, std::vector<SliceInfo>& slices, Volume3D& volume)
+{
     if (!seriesInfo.isValid()) {
         s_lastError = "Invalid series information provided";
-        return Volume3D{};
+        return false;
     }
     
     if (seriesInfo.filePaths.empty()) {
         s_lastError = "No files in series";
-        return Volume3D{};
+        return false;
     }
     
     try {
-        std::vector<SliceInfo> slices;
-        slices.reserve(seriesInfo.filePaths.size());
+        slices.clear();
         
-        // Extract information from each DICOM file
-        for (const auto& filePath : seriesInfo.filePaths) {
-            SliceInfo slice;
-            if (extractSliceInfo(filePath, slice)) {
-                slices.push_back(slice);
-            } else {
-                std::cout << "Warning: Failed to extract info from " << filePath << std::endl;
+        if (seriesInfo.slices.size() == seriesInfo.filePaths.size()) {
+            // Headers were already gathered by the directory scan
+            slices = seriesInfo.slices;
+        } else {
+            slices.reserve(seriesInfo.filePaths.size());
+            
+            // Extract information from each DICOM file
+            for (const auto& filePath : seriesInfo.filePaths) {
+                SliceInfo slice;
+                if (extractSliceInfo(filePath, slice)) {
+                    slices.push_back(slice);
+                } else {
+                    std::cout << "Warning: Failed to extract info from " << filePath << std::endl;
+                }
             }
         }
         
         if (slices.empty()) {
             s_lastError = "No valid DICOM slices found";
-            return Volume3D{};
+            return false;
         }
         
         // Validate slice consistency
         if (!validateSliceConsistency(slices)) {
             s_lastError = "Slice consistency validation failed";
-            return Volume3D{};
+            return false;
         }
         
         // Sort slices
         if (!sortSlices(slices)) {
             s_lastError = "Failed to sort slices";
-            return Volume3D{};
+            return false;
         }
         
-        // Create volume
-        Volume3D volume(slices[0].columns, slices[0].rows, static_cast<int>(slices.size()));
+        // Create volume, keeping stored values when requested and the series allows it
+        Volume3D::VoxelType nativeType = Volume3D::VoxelType::Float32;
+        const bool nativeStorage = options.nativeStorage && getNativeVoxelType(slices, nativeType);
+        
+        volume = Volume3D{};
+        volume.width = slices[0].columns;
+        volume.height = slices[0].rows;
+        volume.depth = static_cast<int>(slices.size());
+        if (nativeStorage) {
+            const double slope = slices[0].hasRescale ? slices[0].rescaleSlope : 1.0;
+            const double intercept = slices[0].hasRescale ? slices[0].rescaleIntercept : 0.0;
+            volume.allocateStoredVoxels(nativeType, slope, intercept, zeroFill);
+        } else {
+            volume.voxels.resize(volume.getTotalVoxels(), 0.0f);
+        }
         
         // Set spacing
         volume.spacing[0] = slices[0].pixelSpacing[1]; // Column spacing (X)
@@ -120,31 +348,22 @@ Volume3D DicomSeriesLoader::loadFromSeriesInfo(const SeriesInfo& seriesInfo)
         volume.studyDate = seriesInfo.studyDate;
         volume.seriesDescription = seriesInfo.seriesDescription;
         
-        // Load pixel data for each slice
-        volume.vmin = std::numeric_limits<float>::max();
-        volume.vmax = std::numeric_limits<float>::lowest();
-        
-        for (size_t i = 0; i < slices.size(); ++i) {
-            std::vector<float> slicePixels;
-            if (loadPixelData(slices[i], slicePixels)) {
-                // Copy slice data into volume buffer
-                size_t sliceSize = static_cast<size_t>(volume.width) * volume.height;
-                size_t volumeOffset = i * sliceSize;
-                
-                if (volumeOffset + slicePixels.size() <= volume.voxels.size()) {
-                    std::copy(slicePixels.begin(), slicePixels.end(), 
-                             volume.voxels.begin() + volumeOffset);
-                    
-                    // Update min/max
-                    for (float value : slicePixels) {
-                        volume.vmin = std::min(volume.vmin, value);
-                        volume.vmax = std::max(volume.vmax, value);
-                    }
-                }
-            } else {
-                s_lastError = "Failed to load pixel data for slice " + std::to_string(i);
-                return Volume3D{};
+        // PET quantitation: series-level fields from the first slice, acquisition
+        // times per slice in volume order
+        if (seriesInfo.modality == "PT") {
+            auto pet = std::make_shared<PetAcquisition>();
+            pet->units = slices[0].units;
+            pet->decayCorrection = slices[0].decayCorrection;
+            pet->patientWeight = slices[0].patientWeight;
+            pet->injectedDose = slices[0].injectedDose;
+            pet->halfLife = slices[0].halfLife;
+            pet->injectionTime = slices[0].injectionTime;
+            pet->seriesTime = slices[0].seriesTime;
+            pet->sliceAcquisitionTimes.reserve(slices.size());
+            for (const auto& slice : slices) {
+                pet->sliceAcquisitionTimes.push_back(slice.acquisitionTime);
             }
+            volume.pet = std::move(pet);
         }
         
         // Store rescale parameters from first slice
@@ -159,117 +378,200 @@ Volume3D DicomSeriesLoader::loadFromSeriesInfo(const SeriesInfo& seriesInfo)
             std::cout << "Warning: Direction vectors do not form orthonormal basis" << std::endl;
         }
         
-        std::cout << "Volume loaded successfully:" << std::endl;
-        std::cout << "  Series: " << volume.seriesUID << std::endl;
-        std::cout << "  Modality: " << volume.modality << std::endl;
-        std::cout << "  Dimensions: " << volume.width << "x" << volume.height << "x" << volume.depth << std::endl;
-        std::cout << "  Spacing: " << volume.spacing[0] << ", " << volume.spacing[1] << ", " << volume.spacing[2] << " mm" << std::endl;
-        std::cout << "  Origin: " << volume.origin[0] << ", " << volume.origin[1] << ", " << volume.origin[2] << " mm" << std::endl;
-        std::cout << "  Value range: " << volume.vmin << " to " << volume.vmax << std::endl;
-        
-        return volume;
+        return true;
     }
     catch (const std::exception& e) {
-        s_lastError = std::string("Exception in loadFromSeriesInfo: ") + e.what();
-        return Volume3D{};
+        s_lastError = std::string("Exception preparing volume: ") + e.what();
+        return false;
     }
 }
 
+void DicomSeriesLoader::getStoredValueRange(const Volume3D& volume, int32_t storedMin, int32_t storedMax,
+                                            float& minValue, float& maxValue)
+{
+    // The rescale is monotonic, so the stored range maps onto the value range
+    const float a = static_cast<float>(volume.storedIntercept + volume.storedSlope * static_cast<float>(storedMin));
+    const float b = static_cast<float>(volume.storedIntercept + volume.storedSlope * static_cast<float>(storedMax));
+    minValue = std::min(a, b);
+    maxValue = std::max(a, b);
+}
+
 bool DicomSeriesLoader::extractSliceInfo(const std::string& filePath, SliceInfo& slice)
 {
     try {
-        gdcm::ImageReader reader;
+        gdcm::Reader reader;
         reader.SetFileName(filePath.c_str());
         
-        if (!reader.Read()) {
+        // Header only: pixel data is read once, later, by loadPixelData
+        if (!reader.ReadUpToTag(gdcm::Tag(0x7FE0, 0x0010))) {
             std::cout << "Failed to read DICOM file: " << filePath << std::endl;
             return false;
         }
         
-        const gdcm::File& file = reader.GetFile();
-        const gdcm::DataSet& ds = file.GetDataSet();
-        
         slice.filePath = filePath;
+        parseSliceHeader(reader.GetFile().GetDataSet(), slice);
         
-        // Extract Image Position Patient (0020,0032)
-        gdcm::Attribute<0x0020, 0x0032> ipp;
-        ipp.SetFromDataSet(ds);
-        if (ds.FindDataElement(ipp.GetTag())) {
-            const double* values = ipp.GetValues();
-            if (ipp.GetNumberOfValues() >= 3) {
-                slice.imagePosition[0] = values[0];
-                slice.imagePosition[1] = values[1];
-                slice.imagePosition[2] = values[2];
-            }
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception extracting slice info from " << filePath << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+void DicomSeriesLoader::parseSliceHeader(const gdcm::DataSet& ds, SliceInfo& slice)
+{
+    // Extract Image Position Patient (0020,0032)
+    gdcm::Attribute<0x0020, 0x0032> ipp;
+    ipp.SetFromDataSet(ds);
+    if (ds.FindDataElement(ipp.GetTag())) {
+        const double* values = ipp.GetValues();
+        if (ipp.GetNumberOfValues() >= 3) {
+            slice.imagePosition[0] = values[0];
+            slice.imagePosition[1] = values[1];
+            slice.imagePosition[2] = values[2];
         }
-        
-        // Extract Image Orientation Patient (0020,0037) 
-        gdcm::Attribute<0x0020, 0x0037> iop;
-        iop.SetFromDataSet(ds);
-        if (ds.FindDataElement(iop.GetTag())) {
-            const double* values = iop.GetValues();
-            if (iop.GetNumberOfValues() >= 6) {
-                for (int i = 0; i < 6; ++i) {
-                    slice.imageOrientation[i] = values[i];
-                }
+    }
+    
+    // Extract Image Orientation Patient (0020,0037) 
+    gdcm::Attribute<0x0020, 0x0037> iop;
+    iop.SetFromDataSet(ds);
+    if (ds.FindDataElement(iop.GetTag())) {
+        const double* values = iop.GetValues();
+        if (iop.GetNumberOfValues() >= 6) {
+            for (int i = 0; i < 6; ++i) {
+                slice.imageOrientation[i] = values[i];
             }
         }
-        
-        // Extract Slice Location (0020,1041) - optional
-        gdcm::Attribute<0x0020, 0x1041> sl;
-        sl.SetFromDataSet(ds);
-        if (ds.FindDataElement(sl.GetTag())) {
-            slice.sliceLocation = sl.GetValue();
+    }
+    
+    // Extract Slice Location (0020,1041) - optional
+    gdcm::Attribute<0x0020, 0x1041> sl;
+    sl.SetFromDataSet(ds);
+    if (ds.FindDataElement(sl.GetTag())) {
+        slice.sliceLocation = sl.GetValue();
+    }
+    
+    // Extract Instance Number (0020,0013)
+    gdcm::Attribute<0x0020, 0x0013> instanceNum;
+    instanceNum.SetFromDataSet(ds);
+    if (ds.FindDataElement(instanceNum.GetTag())) {
+        slice.instanceNumber = instanceNum.GetValue();
+    }
+    
+    // Extract image dimensions: Rows (0028,0010), Columns (0028,0011)
+    gdcm::Attribute<0x0028, 0x0010> rows;
+    rows.SetFromDataSet(ds);
+    if (ds.FindDataElement(rows.GetTag())) {
+        slice.rows = rows.GetValue();
+    }
+    
+    gdcm::Attribute<0x0028, 0x0011> columns;
+    columns.SetFromDataSet(ds);
+    if (ds.FindDataElement(columns.GetTag())) {
+        slice.columns = columns.GetValue();
+    }
+    
+    // Extract pixel format: Bits Allocated (0028,0100), Bits Stored (0028,0101),
+    // Pixel Representation (0028,0103)
+    gdcm::Attribute<0x0028, 0x0100> bitsAllocated;
+    bitsAllocated.SetFromDataSet(ds);
+    if (ds.FindDataElement(bitsAllocated.GetTag())) {
+        slice.bitsAllocated = bitsAllocated.GetValue();
+    }
+    
+    gdcm::Attribute<0x0028, 0x0101> bitsStored;
+    bitsStored.SetFromDataSet(ds);
+    if (ds.FindDataElement(bitsStored.GetTag())) {
+        slice.bitsStored = bitsStored.GetValue();
+    }
+    
+    gdcm::Attribute<0x0028, 0x0103> pixelRepresentation;
+    pixelRepresentation.SetFromDataSet(ds);
+    if (ds.FindDataElement(pixelRepresentation.GetTag())) {
+        slice.pixelRepresentation = pixelRepresentation.GetValue();
+    }
+    
+    // Extract rescale parameters (0028,1052) and (0028,1053)
+    gdcm::Attribute<0x0028, 0x1052> rescaleIntercept;
+    gdcm::Attribute<0x0028, 0x1053> rescaleSlope;
+    
+    rescaleIntercept.SetFromDataSet(ds);
+    rescaleSlope.SetFromDataSet(ds);
+    
+    if (ds.FindDataElement(rescaleIntercept.GetTag()) && ds.FindDataElement(rescaleSlope.GetTag())) {
+        slice.rescaleIntercept = rescaleIntercept.GetValue();
+        slice.rescaleSlope = rescaleSlope.GetValue();
+        slice.hasRescale = true;
+    }
+    
+    // Extract Pixel Spacing (0028,0030)
+    gdcm::Attribute<0x0028, 0x0030> pixelSpacing;
+    pixelSpacing.SetFromDataSet(ds);
+    if (ds.FindDataElement(pixelSpacing.GetTag())) {
+        const double* values = pixelSpacing.GetValues();
+        if (pixelSpacing.GetNumberOfValues() >= 2) {
+            slice.pixelSpacing[0] = values[0]; // Row spacing
+            slice.pixelSpacing[1] = values[1]; // Column spacing  
         }
-        
-        // Extract Instance Number (0020,0013)
-        gdcm::Attribute<0x0020, 0x0013> instanceNum;
-        instanceNum.SetFromDataSet(ds);
-        if (ds.FindDataElement(instanceNum.GetTag())) {
-            slice.instanceNumber = instanceNum.GetValue();
+    }
+    
+    // PET quantitation: Units (0054,1001), Decay Correction (0054,1102),
+    // Patient's Weight (0010,1030). Absent on other modalities.
+    slice.units = readString<0x0054, 0x1001>(ds);
+    slice.decayCorrection = readString<0x0054, 0x1102>(ds);
+    
+    gdcm::Attribute<0x0010, 0x1030> patientWeight;
+    patientWeight.SetFromDataSet(ds);
+    if (ds.FindDataElement(patientWeight.GetTag())) {
+        slice.patientWeight = patientWeight.GetValue();
+    }
+    
+    // Times as seconds since midnight of the Series Date (0008,0021), so that
+    // an injection before midnight and a scan after it keep their order
+    int64_t seriesDay = 0;
+    const bool hasSeriesDate = parseDate(readString<0x0008, 0x0021>(ds), seriesDay);
+    const auto timeOf = [&](const std::string& date, const std::string& time) {
+        double seconds = parseTime(time);
+        int64_t day = 0;
+        if (hasSeriesDate && parseDate(date, day)) {
+            seconds += static_cast<double>(day - seriesDay) * 86400.0;
         }
-        
-        // Extract image dimensions
-        const gdcm::Image& image = reader.GetImage();
-        const unsigned int* dims = image.GetDimensions();
-        slice.rows = dims[1];
-        slice.columns = dims[0];
-        
-        // Extract pixel format information
-        const gdcm::PixelFormat& pf = image.GetPixelFormat();
-        slice.bitsAllocated = pf.GetBitsAllocated();
-        slice.bitsStored = pf.GetBitsStored();
-        slice.pixelRepresentation = pf.GetPixelRepresentation();
-        
-        // Extract rescale parameters (0028,1052) and (0028,1053)
-        gdcm::Attribute<0x0028, 0x1052> rescaleIntercept;
-        gdcm::Attribute<0x0028, 0x1053> rescaleSlope;
-        
-        rescaleIntercept.SetFromDataSet(ds);
-        rescaleSlope.SetFromDataSet(ds);
-        
-        if (ds.FindDataElement(rescaleIntercept.GetTag()) && ds.FindDataElement(rescaleSlope.GetTag())) {
-            slice.rescaleIntercept = rescaleIntercept.GetValue();
-            slice.rescaleSlope = rescaleSlope.GetValue();
-            slice.hasRescale = true;
-        }
-        
-        // Extract Pixel Spacing (0028,0030)
-        gdcm::Attribute<0x0028, 0x0030> pixelSpacing;
-        pixelSpacing.SetFromDataSet(ds);
-        if (ds.FindDataElement(pixelSpacing.GetTag())) {
-            const double* values = pixelSpacing.GetValues();
-            if (pixelSpacing.GetNumberOfValues() >= 2) {
-                slice.pixelSpacing[0] = values[0]; // Row spacing
-                slice.pixelSpacing[1] = values[1]; // Column spacing  
+        return seconds;
+    };
+    
+    // Series Time (0008,0031), Acquisition Date/Time (0008,0022)/(0008,0032)
+    slice.seriesTime = timeOf(std::string(), readString<0x0008, 0x0031>(ds));
+    slice.acquisitionTime = timeOf(readString<0x0008, 0x0022>(ds), readString<0x0008, 0x0032>(ds));
+    
+    // Radiopharmaceutical Information Sequence (0054,0016), first item: Total Dose
+    // (0018,1074), Half Life (0018,1075), Start DateTime (0018,1078) or the older
+    // time-only Start Time (0018,1072)
+    const gdcm::Tag radiopharmaceuticalTag(0x0054, 0x0016);
+    if (ds.FindDataElement(radiopharmaceuticalTag)) {
+        gdcm::SmartPointer<gdcm::SequenceOfItems> items = ds.GetDataElement(radiopharmaceuticalTag).GetValueAsSQ();
+        if (items && items->GetNumberOfItems() > 0) {
+            const gdcm::DataSet& item = items->GetItem(1).GetNestedDataSet();
+            
+            gdcm::Attribute<0x0018, 0x1074> totalDose;
+            totalDose.SetFromDataSet(item);
+            if (item.FindDataElement(totalDose.GetTag())) {
+                slice.injectedDose = totalDose.GetValue();
+            }
+            
+            gdcm::Attribute<0x0018, 0x1075> halfLife;
+            halfLife.SetFromDataSet(item);
+            if (item.FindDataElement(halfLife.GetTag())) {
+                slice.halfLife = halfLife.GetValue();
+            }
+            
+            const std::string startDateTime = readString<0x0018, 0x1078>(item);
+            if (startDateTime.size() >= 10) {
+                slice.injectionTime = timeOf(startDateTime.substr(0, 8), startDateTime.substr(8));
+            } else {
+                slice.injectionTime = timeOf(std::string(), readString<0x0018, 0x1072>(item));
             }
         }
-        
-        return true;
-    }
-    catch (const std::exception& e) {
-        std::cout << "Exception extracting slice info from " << filePath << ": " << e.what() << std::endl;
-        return false;
     }
 }
 
@@ -382,7 +684,8 @@ double DicomSeriesLoader::calculateSliceSpacing(const std::vector<SliceInfo>& sl
     return medianSpacing > 1e-6 ? medianSpacing : 1.0;
 }
 
-bool DicomSeriesLoader::loadPixelData(const SliceInfo& slice, std::vector<float>& pixelData)
+bool DicomSeriesLoader::loadPixelData(const SliceInfo& slice, float* pixelData, std::vector<char>& buffer,
+                                      float& minValue, float& maxValue)
 {
     try {
         gdcm::ImageReader reader;
@@ -394,68 +697,90 @@ bool DicomSeriesLoader::loadPixelData(const SliceInfo& slice, std::vector<float>
         
         const gdcm::Image& image = reader.GetImage();
         
+        // The decoded image must match the header the volume was sized from
+        const unsigned int* dims = image.GetDimensions();
+        if (static_cast<int>(dims[0]) != slice.columns || static_cast<int>(dims[1]) != slice.rows) {
+            std::cout << "Pixel data dimensions differ from header: " << slice.filePath << std::endl;
+            return false;
+        }
+        
+        // Convert based on the pixel format of the decoded image
+        const gdcm::PixelFormat& pf = image.GetPixelFormat();
+        PixelConversion::StoredType storedType;
+        if (!PixelConversion::getStoredType(pf.GetBitsAllocated(), pf.GetPixelRepresentation(), storedType)) {
+            std::cout << "Unsupported pixel format: " << pf.GetBitsAllocated() << " bits" << std::endl;
+            return false;
+        }
+        const size_t numPixels = static_cast<size_t>(slice.rows) * slice.columns;
+        
         // Get raw pixel data
-        std::vector<char> buffer(image.GetBufferLength());
-        if (!image.GetBuffer(buffer.data())) {
+        buffer.resize(image.GetBufferLength());
+        if (buffer.size() < numPixels * PixelConversion::getStoredSize(storedType) ||
+            !image.GetBuffer(buffer.data())) {
+            return false;
+        }
+        
+        // Convert, rescale and track min/max in one pass
+        PixelConversion::Rescale rescale;
+        rescale.enabled = slice.hasRescale;
+        rescale.slope = slice.rescaleSlope;
+        rescale.intercept = slice.rescaleIntercept;
+        PixelConversion::convertToFloat(buffer.data(), storedType, numPixels, rescale,
+                                        pixelData, minValue, maxValue);
+        
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cout << "Exception loading pixel data: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool DicomSeriesLoader::loadStoredPixelData(const SliceInfo& slice, void* storedData, std::vector<char>& buffer,
+                                            int32_t& minValue, int32_t& maxValue)
+{
+    try {
+        gdcm::ImageReader reader;
+        reader.SetFileName(slice.filePath.c_str());
+        
+        if (!reader.Read()) {
             return false;
         }
         
-        // Prepare output
-        size_t numPixels = static_cast<size_t>(slice.rows) * slice.columns;
-        pixelData.resize(numPixels);
+        const gdcm::Image& image = reader.GetImage();
         
-        // Convert based on pixel format
+        // The decoded image must match the header the volume was sized and typed from
+        const unsigned int* dims = image.GetDimensions();
         const gdcm::PixelFormat& pf = image.GetPixelFormat();
+        if (static_cast<int>(dims[0]) != slice.columns || static_cast<int>(dims[1]) != slice.rows ||
+            pf.GetBitsAllocated() != slice.bitsAllocated ||
+            pf.GetPixelRepresentation() != slice.pixelRepresentation) {
+            std::cout << "Pixel data format differs from header: " << slice.filePath << std::endl;
+            return false;
+        }
         
-        if (pf.GetBitsAllocated() == 16) {
-            if (pf.GetPixelRepresentation() == 0) {
-                // Unsigned 16-bit
-                const uint16_t* pixels = reinterpret_cast<const uint16_t*>(buffer.data());
-                for (size_t i = 0; i < numPixels; ++i) {
-                    float value = static_cast<float>(pixels[i]);
-                    if (slice.hasRescale) {
-                        value = static_cast<float>(slice.rescaleIntercept + slice.rescaleSlope * value);
-                    }
-                    pixelData[i] = value;
-                }
-            } else {
-                // Signed 16-bit  
-                const int16_t* pixels = reinterpret_cast<const int16_t*>(buffer.data());
-                for (size_t i = 0; i < numPixels; ++i) {
-                    float value = static_cast<float>(pixels[i]);
-                    if (slice.hasRescale) {
-                        value = static_cast<float>(slice.rescaleIntercept + slice.rescaleSlope * value);
-                    }
-                    pixelData[i] = value;
-                }
-            }
-        } else if (pf.GetBitsAllocated() == 8) {
-            if (pf.GetPixelRepresentation() == 0) {
-                // Unsigned 8-bit
-                const uint8_t* pixels = reinterpret_cast<const uint8_t*>(buffer.data());
-                for (size_t i = 0; i < numPixels; ++i) {
-                    float value = static_cast<float>(pixels[i]);
-                    if (slice.hasRescale) {
-                        value = static_cast<float>(slice.rescaleIntercept + slice.rescaleSlope * value);
-                    }
-                    pixelData[i] = value;
-                }
-            } else {
-                // Signed 8-bit
-                const int8_t* pixels = reinterpret_cast<const int8_t*>(buffer.data());
-                for (size_t i = 0; i < numPixels; ++i) {
-                    float value = static_cast<float>(pixels[i]);
-                    if (slice.hasRescale) {
-                        value = static_cast<float>(slice.rescaleIntercept + slice.rescaleSlope * value);
-                    }
-                    pixelData[i] = value;
-                }
+        PixelConversion::StoredType storedType;
+        if (!PixelConversion::getStoredType(pf.GetBitsAllocated(), pf.GetPixelRepresentation(), storedType)) {
+            return false;
+        }
+        const size_t numPixels = static_cast<size_t>(slice.rows) * slice.columns;
+        const size_t sliceBytes = numPixels * PixelConversion::getStoredSize(storedType);
+        
+        // Decode straight into the volume when the frame is exactly one slice
+        const size_t bufferLength = image.GetBufferLength();
+        if (bufferLength == sliceBytes) {
+            if (!image.GetBuffer(static_cast<char*>(storedData))) {
+                return false;
             }
         } else {
-            std::cout << "Unsupported pixel format: " << pf.GetBitsAllocated() << " bits" << std::endl;
-            return false;
+            buffer.resize(bufferLength);
+            if (bufferLength < sliceBytes || !image.GetBuffer(buffer.data())) {
+                return false;
+            }
+            std::memcpy(storedData, buffer.data(), sliceBytes);
         }
         
+        PixelConversion::findStoredRange(storedData, storedType, numPixels, minValue, maxValue);
         return true;
     }
     catch (const std::exception& e) {
@@ -464,6 +789,30 @@ bool DicomSeriesLoader::loadPixelData(const SliceInfo& slice, std::vector<float>
     }
 }
 
+bool DicomSeriesLoader::getNativeVoxelType(const std::vector<SliceInfo>& slices, Volume3D::VoxelType& type)
+{
+    const SliceInfo& first = slices[0];
+    
+    if (first.bitsAllocated == 16) {
+        type = first.pixelRepresentation == 0 ? Volume3D::VoxelType::UInt16 : Volume3D::VoxelType::Int16;
+    } else if (first.bitsAllocated == 8 && first.pixelRepresentation == 0) {
+        type = Volume3D::VoxelType::UInt8;
+    } else {
+        return false;
+    }
+    
+    // A single slope/intercept must describe every slice (not the case for most PET)
+    for (const auto& slice : slices) {
+        if (slice.hasRescale != first.hasRescale ||
+            (slice.hasRescale && (slice.rescaleSlope != first.rescaleSlope ||
+                                  slice.rescaleIntercept != first.rescaleIntercept))) {
+            return false;
+        }
+    }
+    
+    return true;
+}
+
 void DicomSeriesLoader::computeSliceDirection(const double imageOrientation[6], double sliceDirection[3])
 {
     // Cross product of row and column directions
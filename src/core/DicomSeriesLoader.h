@@ -1,9 +1,24 @@
 #pragma once
 
 #include "Volume3D.h"
+#include "LoadProgress.h"
+#include <cstdint>
+#include <limits>
 #include <string>
 #include <vector>
 
+namespace gdcm { class DataSet; }
+
+/**
+ * @brief Options for DicomSeriesLoader::loadFromSeriesInfo
+ */
+struct SeriesLoadOptions
+{
+    unsigned threadCount{0};            // Decode threads (0 = hardware threads, 1 = serial)
+    bool nativeStorage{false};          // Keep stored 8/16-bit values plus slope/intercept instead of float32
+    LoadProgress* progress{nullptr};    // Optional progress counters and cancellation flag
+};
+
 /**
  * @brief GDCM-based DICOM series loader
  * 
@@ -14,6 +29,42 @@
 class DicomSeriesLoader
 {
 public:
+    /**
+     * @brief Structure to hold slice-specific information for sorting
+     */
+    struct SliceInfo
+    {
+        std::string filePath;
+        double imagePosition[3]{0.0, 0.0, 0.0};      // IPP - Image Position Patient
+        double imageOrientation[6]{1.0, 0.0, 0.0, 0.0, 1.0, 0.0}; // IOP - Image Orientation Patient
+        double sliceLocation{0.0};                     // Slice Location (if available)
+        double projectedPosition{0.0};                 // Position projected onto slice normal
+        int instanceNumber{0};                         // Instance Number
+        int sliceIndex{-1};                           // Final sorted index
+        
+        // Pixel data info
+        int rows{0};
+        int columns{0};
+        int bitsAllocated{0};
+        int bitsStored{0};
+        int pixelRepresentation{0};  // 0=unsigned, 1=signed
+        double rescaleIntercept{0.0};
+        double rescaleSlope{1.0};
+        bool hasRescale{false};
+        double pixelSpacing[2]{1.0, 1.0}; // row, column
+        
+        // PET quantitation (see PetAcquisition; times in seconds since midnight
+        // of the Series Date, NaN = absent)
+        std::string units;
+        std::string decayCorrection;
+        double patientWeight{0.0};
+        double injectedDose{0.0};
+        double halfLife{0.0};
+        double injectionTime{std::numeric_limits<double>::quiet_NaN()};
+        double seriesTime{std::numeric_limits<double>::quiet_NaN()};
+        double acquisitionTime{std::numeric_limits<double>::quiet_NaN()};
+    };
+    
     /**
      * @brief Structure to hold basic series information
      */
@@ -31,6 +82,7 @@ public:
         int imageRows{0};
         int imageCols{0};
         std::vector<std::string> filePaths; // All files belonging to this series
+        std::vector<SliceInfo> slices;      // Header fields per file, parallel to filePaths (empty = parse on load)
         
         bool isValid() const {
             return !seriesUID.empty() && numSlices > 0 && imageRows > 0 && imageCols > 0;
@@ -47,44 +99,60 @@ public:
     
     /**
      * @brief Load DICOM series from SeriesInfo
+     * 
+     * Slices are decoded concurrently, each directly into its place in the
+     * volume. The result is bit-identical for every thread count.
+     * 
+     * With options.nativeStorage, 16-bit and unsigned 8-bit series whose slices
+     * share one slope/intercept keep their stored values (half or a quarter of
+     * the float32 memory); other series fall back to float32.
+     * 
      * @param seriesInfo Series information with file paths
+     * @param options Thread count and storage mode
      * @return Volume3D with loaded data, or invalid volume on error
      */
-    static Volume3D loadFromSeriesInfo(const SeriesInfo& seriesInfo);
+    static Volume3D loadFromSeriesInfo(const SeriesInfo& seriesInfo,
+                                       const SeriesLoadOptions& options = SeriesLoadOptions());
     
     /**
-     * @brief Get last error message
+     * @brief Extract slice geometry, pixel format, rescale and PET fields from a parsed header
+     * @param ds Data set read at least up to (but not including) Pixel Data
+     * @param slice Output slice information (filePath is left untouched)
+     */
+    static void parseSliceHeader(const gdcm::DataSet& ds, SliceInfo& slice);
+    
+    /**
+     * @brief Get the last error message of the calling thread
      */
     static std::string getLastError();
 
 private:
+    friend class LazyVolume;
+    
     /**
-     * @brief Structure to hold slice-specific information for sorting
+     * @brief Read, validate and sort slice headers, then size the volume
+     * 
+     * Sets geometry, metadata and rescale and allocates the voxel buffer (native
+     * or float32 per options) without decoding any pixel data.
+     * 
+     * @param seriesInfo Series information with file paths
+     * @param options Storage mode
+     * @param zeroFill Allocate native storage as zero pages (float32 storage is always zeroed)
+     * @param slices Output slices in volume order
+     * @param volume Output volume
+     * @return true on success, false with s_lastError set
      */
-    struct SliceInfo
-    {
-        std::string filePath;
-        double imagePosition[3]{0.0, 0.0, 0.0};      // IPP - Image Position Patient
-        double imageOrientation[6];                    // IOP - Image Orientation Patient  
-        double sliceLocation{0.0};                     // Slice Location (if available)
-        double projectedPosition{0.0};                 // Position projected onto slice normal
-        int instanceNumber{0};                         // Instance Number
-        int sliceIndex{-1};                           // Final sorted index
-        
-        // Pixel data info
-        int rows{0};
-        int columns{0};
-        int bitsAllocated{0};
-        int bitsStored{0};
-        int pixelRepresentation{0};  // 0=unsigned, 1=signed
-        double rescaleIntercept{0.0};
-        double rescaleSlope{1.0};
-        bool hasRescale{false};
-        double pixelSpacing[2]{1.0, 1.0}; // row, column
-    };
+    static bool prepareVolume(const SeriesInfo& seriesInfo, const SeriesLoadOptions& options, bool zeroFill,
+                              std::vector<SliceInfo>& slices, Volume3D& volume);
+    
+    /**
+     * @brief Map a stored value range through the volume's rescale
+     */
+    static void getStoredValueRange(const Volume3D& volume, int32_t storedMin, int32_t storedMax,
+                                    float& minValue, float& maxValue);
     
     /**
-     * @brief Extract slice information from DICOM file
+     * @brief Extract slice information from DICOM file (header only, stops before Pixel Data)
      * @param filePath Path to DICOM file
      * @param slice Output slice information
      * @return true on success
@@ -106,12 +174,38 @@ private:
     static double calculateSliceSpacing(const std::vector<SliceInfo>& slices);
     
     /**
-     * @brief Load pixel data from DICOM file
+     * @brief Read and decode the pixel data of one slice
+     * 
+     * The file is parsed once; the pixel format is taken from the decoded image.
+     * Conversion, rescale and min/max tracking run in one SIMD pass (PixelConversion).
+     * 
      * @param slice Slice information
-     * @param pixelData Output buffer for pixel values (float32)
+     * @param pixelData Output for rows * columns float32 values (final position in the volume)
+     * @param buffer Scratch buffer for the raw pixel data, reused across calls
+     * @param minValue Running minimum, updated with this slice's values
+     * @param maxValue Running maximum, updated with this slice's values
      * @return true on success
      */
-    static bool loadPixelData(const SliceInfo& slice, std::vector<float>& pixelData);
+    static bool loadPixelData(const SliceInfo& slice, float* pixelData, std::vector<char>& buffer,
+                              float& minValue, float& maxValue);
+    
+    /**
+     * @brief Read one slice's stored pixel values without conversion
+     * @param slice Slice information
+     * @param storedData Output for rows * columns stored values (final position in the volume)
+     * @param buffer Scratch buffer, only used when the decoded frame is not exactly one slice
+     * @param minValue Running minimum stored value, updated with this slice
+     * @param maxValue Running maximum stored value, updated with this slice
+     * @return true on success
+     */
+    static bool loadStoredPixelData(const SliceInfo& slice, void* storedData, std::vector<char>& buffer,
+                                    int32_t& minValue, int32_t& maxValue);
+    
+    /**
+     * @brief Pick the native voxel type for a series
+     * @return false if the series must be stored as float32
+     */
+    static bool getNativeVoxelType(const std::vector<SliceInfo>& slices, Volume3D::VoxelType& type);
     
     /**
      * @brief Validate slice consistency (same dimensions, orientation, etc.)
@@ -143,5 +237,5 @@ private:
      */
     static void copyVector(const double src[3], double dst[3]);
     
-    static std::string s_lastError;
+    static thread_local std::string s_lastError;
 };
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include "DicomSeriesManager.h"
+#include "DicomScanIndex.h"
+#include "VolumeCache.h"
+#include "ThreadPool.h"
 #include <gdcmReader.h>
 #include <gdcmFile.h>
 #include <gdcmDataSet.h>
@@ -7,15 +10,85 @@
 #include <filesystem>
 #include <map>
 #include <algorithm>
+#include <limits>
 
-std::string DicomSeriesManager::s_lastError;
+namespace {
+    // Number of paths handed to a parser task at once
+    constexpr size_t kScanBatchSize = 64;
+    
+    struct PendingFile
+    {
+        std::string path;
+        uint64_t fileSize{0};
+        int64_t modifiedTime{0};
+        size_t order{0};  // Position in directory enumeration
+    };
+    
+    struct ScannedFile
+    {
+        PendingFile source;
+        DicomSeriesLoader::SeriesInfo fields;  // Series-level fields read from this file
+        DicomSeriesLoader::SliceInfo slice;
+    };
+    
+    /**
+     * @brief Files scanned by one thread, grouped by series UID
+     */
+    struct PartialScan
+    {
+        std::map<std::string, std::vector<ScannedFile>> series;
+        std::vector<PendingFile> rejected;  // Files that are not DICOM
+    };
+    
+    void addScannedFile(PartialScan& partial, ScannedFile&& file)
+    {
+        partial.series[file.fields.seriesUID].push_back(std::move(file));
+    }
+}
+
+thread_local std::string DicomSeriesManager::s_lastError;
+std::string DicomSeriesManager::s_scanIndexDirectory;
+std::string DicomSeriesManager::s_volumeCacheDirectory;
+uint64_t DicomSeriesManager::s_volumeCacheBudget = uint64_t(4) << 30;
 
 std::string DicomSeriesManager::getLastError()
 {
     return s_lastError;
 }
 
-std::vector<DicomSeriesLoader::SeriesInfo> DicomSeriesManager::scanDirectory(const std::string& directory)
+void DicomSeriesManager::setScanIndexDirectory(const std::string& directory)
+{
+    s_scanIndexDirectory = directory;
+}
+
+std::string DicomSeriesManager::getScanIndexDirectory()
+{
+    return s_scanIndexDirectory;
+}
+
+void DicomSeriesManager::setVolumeCacheDirectory(const std::string& directory)
+{
+    s_volumeCacheDirectory = directory;
+}
+
+std::string DicomSeriesManager::getVolumeCacheDirectory()
+{
+    return s_volumeCacheDirectory;
+}
+
+void DicomSeriesManager::setVolumeCacheBudget(uint64_t bytes)
+{
+    s_volumeCacheBudget = bytes;
+}
+
+uint64_t DicomSeriesManager::getVolumeCacheBudget()
+{
+    return s_volumeCacheBudget;
+}
+
+std::vector<DicomSeriesLoader::SeriesInfo> DicomSeriesManager::scanDirectory(const std::string& directory,
+                                                                             unsigned threadCount,
+                                                                             LoadProgress* progress)
 {
     s_lastError.clear();
     std::vector<DicomSeriesLoader::SeriesInfo> seriesList;
@@ -26,55 +99,184 @@ std::vector<DicomSeriesLoader::SeriesInfo> DicomSeriesManager::scanDirectory(con
             return seriesList;
         }
         
-        // Map to group files by series UID
-        std::map<std::string, DicomSeriesLoader::SeriesInfo> seriesMap;
+        // One spelling per root ("dir", "dir/", "./dir") so they share an index
+        std::error_code canonicalError;
+        std::filesystem::path canonicalRoot = std::filesystem::weakly_canonical(directory, canonicalError);
+        const std::string root = canonicalError ? directory : canonicalRoot.string();
+        
+        // Results of the previous scan of this root, if any
+        const bool useIndex = !s_scanIndexDirectory.empty();
+        const std::string indexPath = useIndex ? DicomScanIndex::indexPathFor(s_scanIndexDirectory, root)
+                                               : std::string();
+        DicomScanIndex previousIndex;
+        if (useIndex) {
+            previousIndex.load(indexPath, root);
+        }
+        
+        ThreadPool pool(threadCount);
+        ThreadPool::TaskGroup group;
+        
+        // One partial scan per thread; the scanning thread itself uses the last slot
+        std::vector<PartialScan> partials(pool.getThreadCount());
+        PartialScan cached;  // Unchanged files taken from the index
+        
+        auto parseBatch = [&pool, &partials, progress](std::vector<PendingFile> files) {
+            const int worker = pool.getCurrentWorkerIndex();
+            PartialScan& partial = partials[worker >= 0 ? static_cast<size_t>(worker) : partials.size() - 1];
+            
+            for (auto& pending : files) {
+                if (progress) {
+                    if (progress->isCancelled()) {
+                        return;
+                    }
+                    progress->filesScanned.fetch_add(1, std::memory_order_relaxed);
+                }
+                
+                // A single header-only read both detects DICOM and extracts all fields;
+                // non-DICOM files fail to parse and are skipped silently
+                ScannedFile file;
+                if (!extractSeriesInfo(pending.path, file.fields, file.slice)) {
+                    partial.rejected.push_back(std::move(pending));
+                    continue;
+                }
+                file.source = std::move(pending);
+                addScannedFile(partial, std::move(file));
+            }
+        };
         
-        // Iterate through all files in directory
-        for (const auto& entry : std::filesystem::recursive_directory_iterator(directory)) {
-            if (entry.is_regular_file()) {
-                std::string filePath = entry.path().string();
+        // Enumerate on this thread while the pool parses earlier batches
+        std::vector<PendingFile> batch;
+        batch.reserve(kScanBatchSize);
+        size_t enumerated = 0;
+        size_t fromIndex = 0;
+        
+        try {
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+                if (progress && progress->isCancelled()) {
+                    break;
+                }
+                if (!entry.is_regular_file()) {
+                    continue;
+                }
+                if (progress) {
+                    progress->filesFound.fetch_add(1, std::memory_order_relaxed);
+                }
+                
+                PendingFile pending;
+                pending.path = entry.path().string();
+                pending.order = enumerated++;
+                
+                std::error_code sizeError, timeError;
+                pending.fileSize = entry.file_size(sizeError);
+                pending.modifiedTime = static_cast<int64_t>(entry.last_write_time(timeError).time_since_epoch().count());
                 
-                if (isDicomFile(filePath)) {
-                    std::string seriesUID, modality, seriesDescription, patientID, studyUID, studyDate;
-                    double pixelSpacing[2];
-                    double sliceThickness;
-                    int rows, columns;
-                    
-                    if (extractSeriesInfo(filePath, seriesUID, modality, seriesDescription,
-                                        patientID, studyUID, studyDate, pixelSpacing, 
-                                        sliceThickness, rows, columns)) {
-                        
-                        // Add or update series info
-                        auto& seriesInfo = seriesMap[seriesUID];
-                        
-                        if (seriesInfo.seriesUID.empty()) {
-                            // First file in this series
-                            seriesInfo.seriesUID = seriesUID;
-                            seriesInfo.modality = modality;
-                            seriesInfo.seriesDescription = seriesDescription;
-                            seriesInfo.patientID = patientID;
-                            seriesInfo.studyUID = studyUID;
-                            seriesInfo.studyDate = studyDate;
-                            seriesInfo.pixelSpacing[0] = pixelSpacing[0];
-                            seriesInfo.pixelSpacing[1] = pixelSpacing[1];
-                            seriesInfo.sliceThickness = sliceThickness;
-                            seriesInfo.imageRows = rows;
-                            seriesInfo.imageCols = columns;
-                            seriesInfo.numSlices = 0;
-                        }
-                        
-                        // Add file to series
-                        seriesInfo.filePaths.push_back(filePath);
-                        seriesInfo.numSlices++;
-                    } else {
-                        std::cout << "Warning: Could not extract series info from " << filePath << std::endl;
+                // Unchanged files are answered from the index without opening them
+                const DicomScanIndex::Entry* known = (sizeError || timeError) ? nullptr
+                    : previousIndex.find(pending.path, pending.fileSize, pending.modifiedTime);
+                if (known) {
+                    ++fromIndex;
+                    if (progress) {
+                        progress->filesScanned.fetch_add(1, std::memory_order_relaxed);
                     }
-                } else {
-                    // Skip non-DICOM files silently
+                    if (known->seriesIndex < 0) {
+                        cached.rejected.push_back(std::move(pending));
+                        continue;
+                    }
+                    ScannedFile file;
+                    file.fields = previousIndex.getSeries(*known);
+                    file.fields.pixelSpacing[0] = known->slice.pixelSpacing[0];
+                    file.fields.pixelSpacing[1] = known->slice.pixelSpacing[1];
+                    file.fields.imageRows = known->slice.rows;
+                    file.fields.imageCols = known->slice.columns;
+                    file.slice = known->slice;
+                    file.source = std::move(pending);
+                    addScannedFile(cached, std::move(file));
+                    continue;
                 }
+                
+                batch.push_back(std::move(pending));
+                if (batch.size() == kScanBatchSize) {
+                    pool.run(group, [&parseBatch, files = std::move(batch)]() mutable {
+                        parseBatch(std::move(files));
+                    });
+                    batch.clear();
+                    batch.reserve(kScanBatchSize);
+                }
+            }
+            if (!batch.empty()) {
+                pool.run(group, [&parseBatch, files = std::move(batch)]() mutable {
+                    parseBatch(std::move(files));
+                });
+            }
+        }
+        catch (...) {
+            // Queued parsers reference this frame; let them finish before unwinding
+            pool.wait(group);
+            throw;
+        }
+        pool.wait(group);
+        
+        // A cancelled scan is incomplete, so neither results nor index are kept
+        if (progress && progress->isCancelled()) {
+            s_lastError = "Scan cancelled";
+            return seriesList;
+        }
+        
+        // Merge the per-thread results
+        partials.push_back(std::move(cached));
+        PartialScan merged;
+        for (auto& partial : partials) {
+            for (auto& pair : partial.series) {
+                auto& files = merged.series[pair.first];
+                files.insert(files.end(), std::make_move_iterator(pair.second.begin()),
+                             std::make_move_iterator(pair.second.end()));
+            }
+            merged.rejected.insert(merged.rejected.end(), std::make_move_iterator(partial.rejected.begin()),
+                                   std::make_move_iterator(partial.rejected.end()));
+        }
+        
+        // Rewrite the index from the files seen now, which drops removed files
+        if (useIndex) {
+            DicomScanIndex updatedIndex;
+            for (const auto& pair : merged.series) {
+                for (const auto& file : pair.second) {
+                    updatedIndex.addDicomFile(file.source.path, file.source.fileSize, file.source.modifiedTime,
+                                              file.fields, file.slice);
+                }
+            }
+            for (const auto& file : merged.rejected) {
+                updatedIndex.addNonDicomFile(file.path, file.fileSize, file.modifiedTime);
+            }
+            if (!updatedIndex.save(indexPath, root)) {
+                std::cout << "Warning: Could not write scan index " << indexPath << std::endl;
             }
         }
         
+        // Map to group files by series UID
+        std::map<std::string, DicomSeriesLoader::SeriesInfo> seriesMap;
+        
+        for (auto& pair : merged.series) {
+            auto& files = pair.second;
+            
+            // Restore directory enumeration order within the series
+            std::sort(files.begin(), files.end(),
+                      [](const ScannedFile& a, const ScannedFile& b) { return a.source.order < b.source.order; });
+            
+            // Series-level fields come from the first file, as in a serial scan
+            DicomSeriesLoader::SeriesInfo& seriesInfo = seriesMap[pair.first];
+            seriesInfo = std::move(files.front().fields);
+            seriesInfo.numSlices = static_cast<int>(files.size());
+            seriesInfo.filePaths.reserve(files.size());
+            seriesInfo.slices.reserve(files.size());
+            for (auto& file : files) {
+                seriesInfo.filePaths.push_back(file.source.path);
+                file.slice.filePath = file.source.path;
+                seriesInfo.slices.push_back(std::move(file.slice));
+            }
+        }
+        
+        std::cout << "Scanned " << enumerated << " files (" << fromIndex << " unchanged from index)" << std::endl;
+        
         // Convert map to vector
         seriesList.reserve(seriesMap.size());
         for (const auto& pair : seriesMap) {
@@ -108,44 +310,59 @@ std::vector<DicomSeriesLoader::SeriesInfo> DicomSeriesManager::scanDirectory(con
     return seriesList;
 }
 
-Volume3D DicomSeriesManager::loadSeries(const DicomSeriesLoader::SeriesInfo& seriesInfo)
+Volume3D DicomSeriesManager::loadSeries(const DicomSeriesLoader::SeriesInfo& seriesInfo,
+                                        const SeriesLoadOptions& options)
 {
     s_lastError.clear();
-    return DicomSeriesLoader::loadFromSeriesInfo(seriesInfo);
-}
-
-bool DicomSeriesManager::isDicomFile(const std::string& filePath)
-{
-    try {
-        // Simple check - try to read as DICOM file
-        gdcm::Reader reader;
-        reader.SetFileName(filePath.c_str());
-        
-        // Just check if the file can be opened as DICOM, don't do full read
-        return reader.CanRead();
+    
+    if (s_volumeCacheDirectory.empty()) {
+        return DicomSeriesLoader::loadFromSeriesInfo(seriesInfo, options);
     }
-    catch (...) {
-        return false;
+    
+    // Reopen from the mapped cache while every source file is unchanged
+    const std::string cachePath = VolumeCache::cachePathFor(s_volumeCacheDirectory, seriesInfo,
+                                                            options.nativeStorage);
+    std::vector<VolumeCache::SourceFile> sources;
+    const bool haveSources = VolumeCache::getSourceFiles(seriesInfo.filePaths, sources);
+    if (haveSources) {
+        Volume3D cached;
+        if (VolumeCache::load(cachePath, sources, cached)) {
+            std::cout << "Loaded volume from cache: " << cachePath << std::endl;
+            if (options.progress) {
+                options.progress->slicesTotal.store(static_cast<size_t>(cached.depth));
+                options.progress->slicesDecoded.store(static_cast<size_t>(cached.depth));
+                options.progress->bytesDecoded.fetch_add(cached.getVoxelMemoryUsage());
+            }
+            return cached;
+        }
+        if (!VolumeCache::getLastError().empty()) {
+            std::cout << VolumeCache::getLastError() << std::endl;
+        }
+    }
+    
+    Volume3D volume = DicomSeriesLoader::loadFromSeriesInfo(seriesInfo, options);
+    
+    if (!volume.isValid() || !haveSources || volume.getVoxelMemoryUsage() > s_volumeCacheBudget) {
+        return volume;
+    }
+    if (VolumeCache::save(cachePath, sources, volume)) {
+        VolumeCache::prune(s_volumeCacheDirectory, s_volumeCacheBudget, cachePath);
+    } else {
+        std::cout << "Volume cache not written: " << VolumeCache::getLastError() << std::endl;
     }
+    return volume;
 }
 
 bool DicomSeriesManager::extractSeriesInfo(const std::string& filePath,
-                                          std::string& seriesUID,
-                                          std::string& modality,
-                                          std::string& seriesDescription,
-                                          std::string& patientID,
-                                          std::string& studyUID,
-                                          std::string& studyDate,
-                                          double pixelSpacing[2],
-                                          double& sliceThickness,
-                                          int& rows,
-                                          int& columns)
+                                           DicomSeriesLoader::SeriesInfo& series,
+                                           DicomSeriesLoader::SliceInfo& slice)
 {
     try {
         gdcm::Reader reader;
         reader.SetFileName(filePath.c_str());
         
-        if (!reader.Read()) {
+        // Stop before Pixel Data (7FE0,0010): every tag we need precedes it
+        if (!reader.ReadUpToTag(gdcm::Tag(0x7FE0, 0x0010))) {
             return false;
         }
         
@@ -156,86 +373,67 @@ bool DicomSeriesManager::extractSeriesInfo(const std::string& filePath,
         gdcm::Attribute<0x0020, 0x000E> seriesInstanceUID;
         seriesInstanceUID.SetFromDataSet(ds);
         if (ds.FindDataElement(seriesInstanceUID.GetTag())) {
-            seriesUID = seriesInstanceUID.GetValue();
+            series.seriesUID = seriesInstanceUID.GetValue();
         }
         
         // Modality (0008,0060)
         gdcm::Attribute<0x0008, 0x0060> modalityAttr;
         modalityAttr.SetFromDataSet(ds);
         if (ds.FindDataElement(modalityAttr.GetTag())) {
-            modality = modalityAttr.GetValue();
+            series.modality = modalityAttr.GetValue();
         }
         
         // Series Description (0008,103E)
         gdcm::Attribute<0x0008, 0x103E> seriesDescAttr;
         seriesDescAttr.SetFromDataSet(ds);
         if (ds.FindDataElement(seriesDescAttr.GetTag())) {
-            seriesDescription = seriesDescAttr.GetValue();
+            series.seriesDescription = seriesDescAttr.GetValue();
         }
         
         // Patient ID (0010,0020)
         gdcm::Attribute<0x0010, 0x0020> patientIDAttr;
         patientIDAttr.SetFromDataSet(ds);
         if (ds.FindDataElement(patientIDAttr.GetTag())) {
-            patientID = patientIDAttr.GetValue();
+            series.patientID = patientIDAttr.GetValue();
         }
         
         // Study Instance UID (0020,000D)
         gdcm::Attribute<0x0020, 0x000D> studyInstanceUID;
         studyInstanceUID.SetFromDataSet(ds);
         if (ds.FindDataElement(studyInstanceUID.GetTag())) {
-            studyUID = studyInstanceUID.GetValue();
+            series.studyUID = studyInstanceUID.GetValue();
         }
         
         // Study Date (0008,0020)
         gdcm::Attribute<0x0008, 0x0020> studyDateAttr;
         studyDateAttr.SetFromDataSet(ds);
         if (ds.FindDataElement(studyDateAttr.GetTag())) {
-            studyDate = studyDateAttr.GetValue();
-        }
-        
-        // Pixel Spacing (0028,0030)
-        gdcm::Attribute<0x0028, 0x0030> pixelSpacingAttr;
-        pixelSpacingAttr.SetFromDataSet(ds);
-        if (ds.FindDataElement(pixelSpacingAttr.GetTag())) {
-            const double* values = pixelSpacingAttr.GetValues();
-            if (pixelSpacingAttr.GetNumberOfValues() >= 2) {
-                pixelSpacing[0] = values[0]; // Row spacing
-                pixelSpacing[1] = values[1]; // Column spacing
-            } else {
-                pixelSpacing[0] = pixelSpacing[1] = 1.0;
-            }
-        } else {
-            pixelSpacing[0] = pixelSpacing[1] = 1.0;
+            series.studyDate = studyDateAttr.GetValue();
         }
         
         // Slice Thickness (0018,0050)
         gdcm::Attribute<0x0018, 0x0050> sliceThicknessAttr;
         sliceThicknessAttr.SetFromDataSet(ds);
         if (ds.FindDataElement(sliceThicknessAttr.GetTag())) {
-            sliceThickness = sliceThicknessAttr.GetValue();
+            series.sliceThickness = sliceThicknessAttr.GetValue();
         } else {
-            sliceThickness = 1.0;
+            series.sliceThickness = 1.0;
         }
         
-        // Rows (0028,0010)
-        gdcm::Attribute<0x0028, 0x0010> rowsAttr;
-        rowsAttr.SetFromDataSet(ds);
-        if (ds.FindDataElement(rowsAttr.GetTag())) {
-            rows = rowsAttr.GetValue();
-        }
+        // Slice-level fields (IPP, IOP, instance number, dimensions, pixel format,
+        // rescale, pixel spacing) from the same parsed header
+        slice.filePath = filePath;
+        DicomSeriesLoader::parseSliceHeader(ds, slice);
         
-        // Columns (0028,0011)
-        gdcm::Attribute<0x0028, 0x0011> columnsAttr;
-        columnsAttr.SetFromDataSet(ds);
-        if (ds.FindDataElement(columnsAttr.GetTag())) {
-            columns = columnsAttr.GetValue();
-        }
+        series.pixelSpacing[0] = slice.pixelSpacing[0];
+        series.pixelSpacing[1] = slice.pixelSpacing[1];
+        series.imageRows = slice.rows;
+        series.imageCols = slice.columns;
         
-        return !seriesUID.empty() && rows > 0 && columns > 0;
+        return !series.seriesUID.empty() && slice.rows > 0 && slice.columns > 0;
     }
     catch (const std::exception& e) {
         std::cout << "Exception extracting series info from " << filePath << ": " << e.what() << std::endl;
         return false;
     }
-}
\ No newline at end of file
+}
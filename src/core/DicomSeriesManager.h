@@ -1,6 +1,7 @@
 #pragma once
 
 #include "DicomSeriesLoader.h"
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -15,57 +16,103 @@ class DicomSeriesManager
 public:
     /**
      * @brief Scan directory for DICOM series
+     * 
+     * The calling thread enumerates the directory tree and feeds batches of paths
+     * to a pool of header parsers. Each thread groups its files into a partial
+     * series map; the maps are merged at the end and files are restored to
+     * enumeration order, so the result does not depend on the thread count.
+     * 
      * @param directory Path to directory containing DICOM files
-     * @return Vector of series information found in directory
+     * @param threadCount Number of parser threads (0 = hardware threads, 1 = serial)
+     * @param progress Optional progress counters and cancellation flag
+     * @return Vector of series information found in directory (empty if cancelled)
      */
-    static std::vector<DicomSeriesLoader::SeriesInfo> scanDirectory(const std::string& directory);
+    static std::vector<DicomSeriesLoader::SeriesInfo> scanDirectory(const std::string& directory,
+                                                                    unsigned threadCount = 0,
+                                                                    LoadProgress* progress = nullptr);
     
     /**
      * @brief Load a specific series
+     * 
+     * A series that was loaded before is mapped from the volume cache when all
+     * of its files still have the recorded sizes and mtimes; otherwise it is
+     * decoded and the cache entry is (re)written.
+     * 
      * @param seriesInfo Series information from scanDirectory
+     * @param options Decode thread count and storage mode
      * @return Volume3D with loaded data, or invalid volume on error
      */
-    static Volume3D loadSeries(const DicomSeriesLoader::SeriesInfo& seriesInfo);
+    static Volume3D loadSeries(const DicomSeriesLoader::SeriesInfo& seriesInfo,
+                               const SeriesLoadOptions& options = SeriesLoadOptions());
     
     /**
-     * @brief Get last error message
+     * @brief Get the last error message of the calling thread
      */
     static std::string getLastError();
     
-private:
     /**
-     * @brief Check if file is a DICOM file
-     * @param filePath Path to file to check
-     * @return true if file appears to be DICOM
+     * @brief Set where per-root scan indexes are stored
+     * 
+     * scanDirectory keeps an index of file sizes, mtimes and extracted headers
+     * for every scanned root and only re-parses new or changed files. Roots are
+     * identified by their canonical path. The index records patient IDs and
+     * series UIDs, so it stays disabled until a private directory is set.
+     * 
+     * @param directory Index directory, or empty to disable the index
      */
-    static bool isDicomFile(const std::string& filePath);
+    static void setScanIndexDirectory(const std::string& directory);
     
     /**
-     * @brief Extract basic series information from DICOM file
-     * @param filePath Path to DICOM file
-     * @param seriesUID Output series instance UID
-     * @param modality Output modality
-     * @param seriesDescription Output series description
-     * @param patientID Output patient ID
-     * @param studyUID Output study instance UID
-     * @param studyDate Output study date
-     * @param pixelSpacing Output pixel spacing [row, column]
-     * @param sliceThickness Output slice thickness
-     * @param rows Output number of rows
-     * @param columns Output number of columns
-     * @return true on success
+     * @brief Get the directory scan indexes are stored in (empty = disabled)
+     */
+    static std::string getScanIndexDirectory();
+    
+    /**
+     * @brief Set where decoded volumes are cached for fast reopening
+     * 
+     * Cached volumes hold full pixel data and patient identifiers, so the cache
+     * stays disabled until a private directory is set.
+     * 
+     * @param directory Cache directory, or empty to disable the volume cache
+     */
+    static void setVolumeCacheDirectory(const std::string& directory);
+    
+    /**
+     * @brief Get the volume cache directory (empty = disabled)
+     */
+    static std::string getVolumeCacheDirectory();
+    
+    /**
+     * @brief Set the most bytes the volume cache directory may hold (default 4 GiB)
+     * 
+     * After each write the least recently used cached volumes are deleted until
+     * the directory fits. Volumes larger than the budget are not cached.
+     */
+    static void setVolumeCacheBudget(uint64_t bytes);
+    
+    /**
+     * @brief Get the volume cache byte budget
+     */
+    static uint64_t getVolumeCacheBudget();
+    
+private:
+    /**
+     * @brief Read the header of a DICOM file in a single pass
+     * 
+     * Parsing stops before Pixel Data (7FE0,0010), so only header bytes are read.
+     * Files that are not DICOM fail to parse and are rejected here.
+     * 
+     * @param filePath Path to candidate file
+     * @param series Output series-level fields (UIDs, description, spacing, dimensions)
+     * @param slice Output slice-level fields (IPP, IOP, instance number, rescale, pixel format)
+     * @return true if the file is a DICOM image with a series UID and valid dimensions
      */
     static bool extractSeriesInfo(const std::string& filePath,
-                                 std::string& seriesUID,
-                                 std::string& modality,
-                                 std::string& seriesDescription,
-                                 std::string& patientID,
-                                 std::string& studyUID,
-                                 std::string& studyDate,
-                                 double pixelSpacing[2],
-                                 double& sliceThickness,
-                                 int& rows,
-                                 int& columns);
+                                  DicomSeriesLoader::SeriesInfo& series,
+                                  DicomSeriesLoader::SliceInfo& slice);
     
-    static std::string s_lastError;
+    static thread_local std::string s_lastError;
+    static std::string s_scanIndexDirectory;
+    static std::string s_volumeCacheDirectory;
+    static uint64_t s_volumeCacheBudget;
 };
\ No newline at end of file
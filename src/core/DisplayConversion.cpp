@@ -0,0 +1,259 @@
+#include "DisplayConversion.h"
+#include "MPRReslicer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+
+#if AMPR_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    // Gathers read 4 bytes per entry, so the table carries 3 bytes of slack
+    constexpr size_t kLutPadding = 3;
+
+    using GrayMapping = DisplayConversion::GrayMapping;
+
+    void mapFloatScalar(const float* source, size_t count, const GrayMapping& mapping, uint8_t* destination)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            destination[i] = mapping.map(source[i]);
+        }
+    }
+
+    size_t getLutOffset(Volume3D::VoxelType type)
+    {
+        return type == Volume3D::VoxelType::Int16 ? 32768 : 0;
+    }
+
+    template <typename T>
+    void mapStoredScalar(const T* source, size_t count, const uint8_t* lut, uint8_t* destination)
+    {
+        constexpr int32_t offset = std::is_signed_v<T> ? 32768 : 0;
+        for (size_t i = 0; i < count; ++i) {
+            destination[i] = lut[static_cast<int32_t>(source[i]) + offset];
+        }
+    }
+
+#if AMPR_HAS_X86_SIMD
+    AMPR_TARGET_SSE41 void mapFloatSSE41(const float* source, size_t count, const GrayMapping& mapping,
+                                         uint8_t* destination)
+    {
+        const __m128 scale = _mm_set1_ps(mapping.scale);
+        const __m128 offset = _mm_set1_ps(mapping.offset);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 white = _mm_set1_ps(255.0f);
+
+        // All 16 inputs are loaded before the 16 outputs are stored, so the
+        // output may overlap the input from the front
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m128i gray[4];
+            for (int j = 0; j < 4; ++j) {
+                __m128 value = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(source + i + 4 * j), scale), offset);
+                value = _mm_min_ps(_mm_max_ps(value, zero), white);
+                gray[j] = _mm_cvttps_epi32(value);
+            }
+            const __m128i words0 = _mm_packus_epi32(gray[0], gray[1]);
+            const __m128i words1 = _mm_packus_epi32(gray[2], gray[3]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_packus_epi16(words0, words1));
+        }
+        mapFloatScalar(source + i, count - i, mapping, destination + i);
+    }
+
+    AMPR_TARGET_AVX2 void mapFloatAVX2(const float* source, size_t count, const GrayMapping& mapping,
+                                       uint8_t* destination)
+    {
+        const __m256 scale = _mm256_set1_ps(mapping.scale);
+        const __m256 offset = _mm256_set1_ps(mapping.offset);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 white = _mm256_set1_ps(255.0f);
+
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32) {
+            __m256i gray[4];
+            for (int j = 0; j < 4; ++j) {
+                __m256 value = _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(source + i + 8 * j), scale), offset);
+                value = _mm256_min_ps(_mm256_max_ps(value, zero), white);
+                gray[j] = _mm256_cvttps_epi32(value);
+            }
+            // packs work per 128-bit lane; the final permute restores the order
+            const __m256i words0 = _mm256_packus_epi32(gray[0], gray[1]);
+            const __m256i words1 = _mm256_packus_epi32(gray[2], gray[3]);
+            const __m256i bytes = _mm256_packus_epi16(words0, words1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i),
+                                _mm256_permutevar8x32_epi32(bytes, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7)));
+        }
+        mapFloatScalar(source + i, count - i, mapping, destination + i);
+    }
+
+    // Widen 8 stored values to 32-bit table indices
+    AMPR_TARGET_AVX2 inline __m256i loadIndices(const int16_t* p)
+    {
+        return _mm256_add_epi32(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))),
+                                _mm256_set1_epi32(32768));
+    }
+    AMPR_TARGET_AVX2 inline __m256i loadIndices(const uint16_t* p)
+    {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    AMPR_TARGET_AVX2 inline __m256i loadIndices(const uint8_t* p)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    template <typename T>
+    AMPR_TARGET_AVX2 void mapStoredAVX2(const T* source, size_t count, const uint8_t* lut, uint8_t* destination)
+    {
+        const int* table = reinterpret_cast<const int*>(lut);
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16) {
+            const __m256i indices0 = loadIndices(source + i);
+            const __m256i indices1 = loadIndices(source + i + 8);
+            const __m256i gray0 = _mm256_and_si256(_mm256_i32gather_epi32(table, indices0, 1), byteMask);
+            const __m256i gray1 = _mm256_and_si256(_mm256_i32gather_epi32(table, indices1, 1), byteMask);
+            const __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(gray0, gray1), 0xD8);
+            const __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), bytes);
+        }
+        mapStoredScalar(source + i, count - i, lut, destination + i);
+    }
+#endif
+
+    template <typename T>
+    void mapStoredTyped(const T* source, size_t count, const uint8_t* lut, uint8_t* destination,
+                        CpuFeatures::InstructionSet instructionSet)
+    {
+#if AMPR_HAS_X86_SIMD
+        if (instructionSet == CpuFeatures::InstructionSet::AVX2) {
+            mapStoredAVX2(source, count, lut, destination);
+            return;
+        }
+#else
+        (void)instructionSet;
+#endif
+        mapStoredScalar(source, count, lut, destination);
+    }
+}
+
+DisplayConversion::GrayMapping DisplayConversion::getGrayMapping(const WindowLevel& window, bool invert)
+{
+    const float low = window.getLow();
+    const float scale = 255.0f / std::max(window.width, std::numeric_limits<float>::min());
+    if (invert) {
+        return {-scale, 255.0f + low * scale + 0.5f};
+    }
+    return {scale, 0.5f - low * scale};
+}
+
+bool DisplayConversion::buildLut(const Volume3D& volume, const WindowLevel& window, bool invert,
+                                 std::vector<uint8_t>& lut)
+{
+    size_t entries = 0;
+    switch (volume.voxelType) {
+    case Volume3D::VoxelType::Int16:
+    case Volume3D::VoxelType::UInt16:
+        entries = 1 << 16;
+        break;
+    case Volume3D::VoxelType::UInt8:
+        entries = 1 << 8;
+        break;
+    default:
+        return false;
+    }
+
+    const GrayMapping mapping = getGrayMapping(window, invert);
+    const int32_t firstStored = -static_cast<int32_t>(getLutOffset(volume.voxelType));
+    lut.resize(entries + kLutPadding);
+    for (size_t index = 0; index < entries; ++index) {
+        // Same rescale as VoxelView::valueAt, then the float mapping
+        const float stored = static_cast<float>(firstStored + static_cast<int32_t>(index));
+        const float value = static_cast<float>(volume.storedIntercept + volume.storedSlope * stored);
+        lut[index] = mapping.map(value);
+    }
+    std::fill(lut.begin() + entries, lut.end(), 0);
+    return true;
+}
+
+void DisplayConversion::mapStored(const void* source, Volume3D::VoxelType type, size_t count,
+                                  const std::vector<uint8_t>& lut, uint8_t* destination)
+{
+    mapStored(source, type, count, lut, destination, CpuFeatures::getBestInstructionSet());
+}
+
+void DisplayConversion::mapStored(const void* source, Volume3D::VoxelType type, size_t count,
+                                  const std::vector<uint8_t>& lut, uint8_t* destination,
+                                  CpuFeatures::InstructionSet instructionSet)
+{
+    instructionSet = std::min(instructionSet, CpuFeatures::getBestInstructionSet());
+
+    switch (type) {
+    case Volume3D::VoxelType::Int16:
+        mapStoredTyped(static_cast<const int16_t*>(source), count, lut.data(), destination, instructionSet);
+        break;
+    case Volume3D::VoxelType::UInt16:
+        mapStoredTyped(static_cast<const uint16_t*>(source), count, lut.data(), destination, instructionSet);
+        break;
+    case Volume3D::VoxelType::UInt8:
+        mapStoredTyped(static_cast<const uint8_t*>(source), count, lut.data(), destination, instructionSet);
+        break;
+    default:
+        break;
+    }
+}
+
+void DisplayConversion::mapFloat(const float* source, size_t count, const WindowLevel& window, bool invert,
+                                 uint8_t* destination)
+{
+    mapFloat(source, count, window, invert, destination, CpuFeatures::getBestInstructionSet());
+}
+
+void DisplayConversion::mapFloat(const float* source, size_t count, const WindowLevel& window, bool invert,
+                                 uint8_t* destination, CpuFeatures::InstructionSet instructionSet)
+{
+    instructionSet = std::min(instructionSet, CpuFeatures::getBestInstructionSet());
+    const GrayMapping mapping = getGrayMapping(window, invert);
+
+#if AMPR_HAS_X86_SIMD
+    if (instructionSet == CpuFeatures::InstructionSet::AVX2) {
+        mapFloatAVX2(source, count, mapping, destination);
+        return;
+    }
+    if (instructionSet == CpuFeatures::InstructionSet::SSE41) {
+        mapFloatSSE41(source, count, mapping, destination);
+        return;
+    }
+#endif
+    mapFloatScalar(source, count, mapping, destination);
+}
+
+void DisplayConversion::mapImage(const SliceImage& image, const WindowLevel& window, bool invert,
+                                 uint8_t* destination, size_t stride, ThreadPool* pool)
+{
+    const size_t width = static_cast<size_t>(std::max(0, image.width));
+    const size_t height = static_cast<size_t>(std::max(0, image.height));
+    if (width == 0 || height == 0) {
+        return;
+    }
+
+    const auto* pixelBytes = reinterpret_cast<const uint8_t*>(image.pixels.data());
+    const bool inPlace = destination >= pixelBytes &&
+                         destination < pixelBytes + image.pixels.size() * sizeof(float);
+    if (inPlace) {
+        for (size_t y = 0; y < height; ++y) {
+            mapFloat(image.row(static_cast<int>(y)), width, window, invert, destination + y * stride);
+        }
+        return;
+    }
+
+    // A few hundred rows per chunk: a full-HD frame is well under a millisecond
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    threads.parallelFor(height, [&](size_t, size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            mapFloat(image.row(static_cast<int>(y)), width, window, invert, destination + y * stride);
+        }
+    }, 256);
+}
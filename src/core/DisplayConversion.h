@@ -0,0 +1,117 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "Volume3D.h"
+#include "WindowPresets.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct SliceImage;
+class ThreadPool;
+
+/**
+ * @brief Window/level mapping of voxel values to 8-bit gray for display
+ *
+ * gray = clamp((value - low) * 255 / width + 0.5, 0, 255), truncated, or
+ * 255 minus that when inverted (MONOCHROME1 style). NaN maps to black.
+ *
+ * Float values (reslicer output) go through an AVX2/SSE4.1 scale-and-clamp
+ * kernel. Stored integer values go through a lookup table with one entry per
+ * stored value, built once per window change with the same float arithmetic,
+ * so both paths give identical gray levels for the same voxel. The table
+ * lookup uses AVX2 gathers when available. All kernels produce identical
+ * output.
+ */
+class DisplayConversion
+{
+public:
+    /**
+     * @brief gray = value * scale + offset, clamped to [0, 255] and truncated
+     */
+    struct GrayMapping
+    {
+        float scale;
+        float offset;
+
+        /**
+         * @brief Gray level of one value, exactly as the SIMD kernels compute it
+         *
+         * Operand order as in maxps/minps, so NaN ends up as 0 everywhere.
+         */
+        uint8_t map(float value) const
+        {
+            const float gray = std::min(255.0f, std::max(0.0f, value * scale + offset));
+            return static_cast<uint8_t>(static_cast<int32_t>(gray));
+        }
+    };
+
+    /**
+     * @brief Scale and offset of a window, as used by every kernel here
+     */
+    static GrayMapping getGrayMapping(const WindowLevel& window, bool invert);
+
+    /**
+     * @brief Build the stored-value lookup table of a native-storage volume
+     * @param volume Volume whose storage type and rescale the table is for
+     * @param window Display window in rescaled units
+     * @param invert Map low values to white
+     * @param lut Output table, indexed like mapStored expects
+     * @return false for float32 storage (use mapFloat)
+     */
+    static bool buildLut(const Volume3D& volume, const WindowLevel& window, bool invert, std::vector<uint8_t>& lut);
+
+    /**
+     * @brief Map stored values through a table from buildLut
+     * @param source Stored values
+     * @param type Storage type the table was built for
+     * @param count Number of values
+     * @param lut Table from buildLut
+     * @param destination Output gray values; may be the source buffer (in place)
+     */
+    static void mapStored(const void* source, Volume3D::VoxelType type, size_t count,
+                          const std::vector<uint8_t>& lut, uint8_t* destination);
+
+    /**
+     * @brief Same as above with an explicit kernel (clamped to what the CPU supports)
+     */
+    static void mapStored(const void* source, Volume3D::VoxelType type, size_t count,
+                          const std::vector<uint8_t>& lut, uint8_t* destination,
+                          CpuFeatures::InstructionSet instructionSet);
+
+    /**
+     * @brief Map float values
+     * @param source Rescaled values
+     * @param count Number of values
+     * @param window Display window
+     * @param invert Map low values to white
+     * @param destination Output gray values; may be the source buffer (in place)
+     */
+    static void mapFloat(const float* source, size_t count, const WindowLevel& window, bool invert,
+                         uint8_t* destination);
+
+    /**
+     * @brief Same as above with an explicit kernel (clamped to what the CPU supports)
+     */
+    static void mapFloat(const float* source, size_t count, const WindowLevel& window, bool invert,
+                         uint8_t* destination, CpuFeatures::InstructionSet instructionSet);
+
+    /**
+     * @brief Map a reslicer output image
+     *
+     * Rows are split across the pool, except when the destination is the
+     * image's own pixel buffer: in-place conversion runs on the calling thread,
+     * because a later row's output would overwrite an earlier row's input.
+     * In place, the stride must not exceed 4 * image.width.
+     *
+     * @param image Reslicer output
+     * @param window Display window
+     * @param invert Map low values to white
+     * @param destination First output row (e.g. QImage::bits of a Grayscale8 image)
+     * @param stride Bytes between output rows (>= image.width)
+     * @param pool Pool to split rows over (nullptr = global pool)
+     */
+    static void mapImage(const SliceImage& image, const WindowLevel& window, bool invert,
+                         uint8_t* destination, size_t stride, ThreadPool* pool = nullptr);
+};
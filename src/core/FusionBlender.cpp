@@ -0,0 +1,168 @@
+#include "FusionBlender.h"
+#include "MPRReslicer.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+
+#if AMPR_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    using GrayMapping = DisplayConversion::GrayMapping;
+
+    /**
+     * @brief Per-call constants shared by the kernels
+     */
+    struct BlendConstants
+    {
+        GrayMapping ct;
+        GrayMapping pet;
+        float threshold;
+        int32_t alpha;       // Overlay weight out of 256
+        const uint32_t* lut;
+    };
+
+    BlendConstants getConstants(const FusionBlender::Parameters& parameters)
+    {
+        static const FusionBlender::ColorMap hot = FusionBlender::ColorMap::hot();
+
+        BlendConstants constants;
+        constants.ct = DisplayConversion::getGrayMapping(parameters.ctWindow, parameters.invertCT);
+        constants.pet = DisplayConversion::getGrayMapping(parameters.petWindow, false);
+        constants.threshold = parameters.petThreshold;
+        constants.alpha = static_cast<int32_t>(std::lround(std::clamp(parameters.alpha, 0.0f, 1.0f) * 256.0f));
+        constants.lut = (parameters.colorMap ? *parameters.colorMap : hot).entries.data();
+        return constants;
+    }
+
+    void blendScalar(const float* ct, const float* pet, size_t count, const BlendConstants& constants,
+                     uint32_t* destination)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            const int32_t gray = constants.ct.map(ct[i]);
+            const uint32_t color = constants.lut[constants.pet.map(pet[i])];
+            const int32_t alpha = pet[i] >= constants.threshold ? constants.alpha : 0;
+            const int32_t base = gray * (256 - alpha);
+            const uint32_t red = static_cast<uint32_t>(base + static_cast<int32_t>(color & 0xFF) * alpha) >> 8;
+            const uint32_t green = static_cast<uint32_t>(base + static_cast<int32_t>((color >> 8) & 0xFF) * alpha) >> 8;
+            const uint32_t blue = static_cast<uint32_t>(base + static_cast<int32_t>((color >> 16) & 0xFF) * alpha) >> 8;
+            destination[i] = red | green << 8 | blue << 16 | 0xFF000000u;
+        }
+    }
+
+#if AMPR_HAS_X86_SIMD
+    AMPR_TARGET_AVX2 inline __m256i mapLevelAVX2(__m256 value, __m256 scale, __m256 offset)
+    {
+        const __m256 level = _mm256_add_ps(_mm256_mul_ps(value, scale), offset);
+        return _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(level, _mm256_setzero_ps()), _mm256_set1_ps(255.0f)));
+    }
+
+    AMPR_TARGET_AVX2 void blendAVX2(const float* ct, const float* pet, size_t count, const BlendConstants& constants,
+                                    uint32_t* destination)
+    {
+        const __m256 ctScale = _mm256_set1_ps(constants.ct.scale);
+        const __m256 ctOffset = _mm256_set1_ps(constants.ct.offset);
+        const __m256 petScale = _mm256_set1_ps(constants.pet.scale);
+        const __m256 petOffset = _mm256_set1_ps(constants.pet.offset);
+        const __m256 threshold = _mm256_set1_ps(constants.threshold);
+        const __m256i alpha = _mm256_set1_epi32(constants.alpha);
+        const __m256i full = _mm256_set1_epi32(256);
+        const __m256i byteMask = _mm256_set1_epi32(0xFF);
+        const __m256i opaque = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+        const int* lut = reinterpret_cast<const int*>(constants.lut);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            const __m256 petValue = _mm256_loadu_ps(pet + i);
+            const __m256i gray = mapLevelAVX2(_mm256_loadu_ps(ct + i), ctScale, ctOffset);
+            const __m256i color = _mm256_i32gather_epi32(lut, mapLevelAVX2(petValue, petScale, petOffset), 4);
+
+            // Ordered compare: NaN PET gets no overlay
+            const __m256i overlay = _mm256_castps_si256(_mm256_cmp_ps(petValue, threshold, _CMP_GE_OQ));
+            const __m256i weight = _mm256_and_si256(overlay, alpha);
+
+            // All products and sums stay below 2^16, so 16-bit multiplies on zero-extended lanes are exact
+            const __m256i base = _mm256_mullo_epi16(gray, _mm256_sub_epi32(full, weight));
+            const __m256i red = _mm256_srli_epi32(
+                _mm256_add_epi32(base, _mm256_mullo_epi16(_mm256_and_si256(color, byteMask), weight)), 8);
+            const __m256i green = _mm256_srli_epi32(
+                _mm256_add_epi32(base, _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(color, 8), byteMask), weight)), 8);
+            const __m256i blue = _mm256_srli_epi32(
+                _mm256_add_epi32(base, _mm256_mullo_epi16(_mm256_and_si256(_mm256_srli_epi32(color, 16), byteMask), weight)), 8);
+
+            const __m256i pixels = _mm256_or_si256(_mm256_or_si256(red, _mm256_slli_epi32(green, 8)),
+                                                   _mm256_or_si256(_mm256_slli_epi32(blue, 16), opaque));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(destination + i), pixels);
+        }
+        blendScalar(ct + i, pet + i, count - i, constants, destination + i);
+    }
+#endif
+
+    void blendWith(const float* ct, const float* pet, size_t count, const BlendConstants& constants,
+                   uint32_t* destination, CpuFeatures::InstructionSet instructionSet)
+    {
+#if AMPR_HAS_X86_SIMD
+        if (instructionSet == CpuFeatures::InstructionSet::AVX2) {
+            blendAVX2(ct, pet, count, constants, destination);
+            return;
+        }
+#else
+        (void)instructionSet;
+#endif
+        blendScalar(ct, pet, count, constants, destination);
+    }
+}
+
+FusionBlender::ColorMap FusionBlender::ColorMap::hot()
+{
+    ColorMap map;
+    for (int i = 0; i < 256; ++i) {
+        // Red rises over the first third, green over the second, blue over the last
+        const int level = i * 3;
+        const auto ramp = [level](int start) {
+            return static_cast<uint8_t>(std::clamp(level - start, 0, 255));
+        };
+        map.entries[i] = pack(ramp(0), ramp(255), ramp(510));
+    }
+    return map;
+}
+
+void FusionBlender::blend(const float* ct, const float* pet, size_t count, const Parameters& parameters,
+                          uint32_t* destination)
+{
+    blend(ct, pet, count, parameters, destination, CpuFeatures::getBestInstructionSet());
+}
+
+void FusionBlender::blend(const float* ct, const float* pet, size_t count, const Parameters& parameters,
+                          uint32_t* destination, CpuFeatures::InstructionSet instructionSet)
+{
+    instructionSet = std::min(instructionSet, CpuFeatures::getBestInstructionSet());
+    blendWith(ct, pet, count, getConstants(parameters), destination, instructionSet);
+}
+
+bool FusionBlender::blendImage(const SliceImage& ct, const SliceImage& pet, const Parameters& parameters,
+                               uint8_t* destination, size_t stride, ThreadPool* pool)
+{
+    if (ct.width != pet.width || ct.height != pet.height) {
+        return false;
+    }
+    const size_t width = static_cast<size_t>(std::max(0, ct.width));
+    const size_t height = static_cast<size_t>(std::max(0, ct.height));
+    if (width == 0 || height == 0) {
+        return true;
+    }
+
+    const BlendConstants constants = getConstants(parameters);
+    const CpuFeatures::InstructionSet instructionSet = CpuFeatures::getBestInstructionSet();
+
+    // As in DisplayConversion::mapImage: a few hundred rows per chunk
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    threads.parallelFor(height, [&](size_t, size_t begin, size_t end) {
+        for (size_t y = begin; y < end; ++y) {
+            blendWith(ct.row(static_cast<int>(y)), pet.row(static_cast<int>(y)), width, constants,
+                      reinterpret_cast<uint32_t*>(destination + y * stride), instructionSet);
+        }
+    }, 256);
+    return true;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "DisplayConversion.h"
+#include "WindowPresets.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+struct SliceImage;
+class ThreadPool;
+
+/**
+ * @brief Fused PET/CT display: windowed CT gray with a thresholded PET color overlay
+ *
+ * Per pixel, in one pass and without intermediate images:
+ *   gray  = CT windowed as in DisplayConversion
+ *   index = PET windowed to [0, 255] the same way
+ *   color = colormap[index]
+ *   out   = gray * (256 - a) + color * a >> 8 per channel, where a is the
+ *           overlay alpha (0..256) if PET >= threshold, else 0 (pure gray)
+ *
+ * Output pixels are packed RGBA with bytes in R, G, B, A order (QImage
+ * Format_RGBA8888), alpha 255. NaN CT maps to black and NaN PET shows no
+ * overlay. The AVX2 kernel looks colors up with gathers and produces the same
+ * output as the scalar kernel.
+ */
+class FusionBlender
+{
+public:
+    /**
+     * @brief 256-entry color table, packed like the output pixels
+     */
+    struct ColorMap
+    {
+        std::array<uint32_t, 256> entries{};
+
+        /**
+         * @brief Black -> red -> yellow -> white ("hot iron"), the usual PET overlay
+         */
+        static ColorMap hot();
+
+        /**
+         * @brief Pack 8-bit channels in output byte order
+         */
+        static uint32_t pack(uint8_t red, uint8_t green, uint8_t blue)
+        {
+            return static_cast<uint32_t>(red) | static_cast<uint32_t>(green) << 8 |
+                   static_cast<uint32_t>(blue) << 16 | 0xFF000000u;
+        }
+    };
+
+    /**
+     * @brief Display settings of a fused view
+     */
+    struct Parameters
+    {
+        WindowLevel ctWindow;
+        bool invertCT{false};
+        WindowLevel petWindow;      // PET range spread over the colormap
+        float petThreshold{0.0f};   // PET below this shows plain CT
+        float alpha{0.5f};          // Overlay opacity [0, 1]
+        const ColorMap* colorMap{nullptr};  // nullptr = hot()
+    };
+
+    /**
+     * @brief Blend one run of pixels
+     * @param ct Windowed CT values (rescaled)
+     * @param pet PET values on the same pixels
+     * @param count Number of pixels
+     * @param parameters Display settings
+     * @param destination Output RGBA pixels
+     */
+    static void blend(const float* ct, const float* pet, size_t count, const Parameters& parameters,
+                      uint32_t* destination);
+
+    /**
+     * @brief Same as above with an explicit kernel (clamped to what the CPU supports)
+     */
+    static void blend(const float* ct, const float* pet, size_t count, const Parameters& parameters,
+                      uint32_t* destination, CpuFeatures::InstructionSet instructionSet);
+
+    /**
+     * @brief Blend two resliced planes of the same size, rows split across the pool
+     * @param ct CT plane
+     * @param pet PET plane on the same pixel grid (e.g. resliced from a resampled PET)
+     * @param parameters Display settings
+     * @param destination First output row (e.g. QImage::bits of a Format_RGBA8888 image)
+     * @param stride Bytes between output rows (>= 4 * width)
+     * @param pool Pool to split rows over (nullptr = global pool)
+     * @return false if the planes differ in size
+     */
+    static bool blendImage(const SliceImage& ct, const SliceImage& pet, const Parameters& parameters,
+                           uint8_t* destination, size_t stride, ThreadPool* pool = nullptr);
+};
@@ -0,0 +1,274 @@
+#include "LazyVolume.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <iostream>
+
+thread_local std::string LazyVolume::s_lastError;
+
+std::string LazyVolume::getLastError()
+{
+    return s_lastError;
+}
+
+std::shared_ptr<LazyVolume> LazyVolume::open(const DicomSeriesLoader::SeriesInfo& seriesInfo,
+                                             const SeriesLoadOptions& options)
+{
+    s_lastError.clear();
+
+    std::shared_ptr<LazyVolume> lazy(new LazyVolume());
+    if (!DicomSeriesLoader::prepareVolume(seriesInfo, options, true, lazy->m_slices, lazy->m_volume)) {
+        s_lastError = DicomSeriesLoader::getLastError();
+        return nullptr;
+    }
+
+    const size_t depth = lazy->m_slices.size();
+    lazy->m_brickRanges = BrickRangeGrid::Builder(lazy->m_volume);
+    lazy->m_states.reset(new std::atomic<uint8_t>[depth]);
+    for (size_t z = 0; z < depth; ++z) {
+        lazy->m_states[z].store(static_cast<uint8_t>(SliceState::Pending));
+    }
+    lazy->m_focus = depth / 2;
+    lazy->m_progress = options.progress;
+    if (lazy->m_progress) {
+        lazy->m_progress->slicesTotal.store(depth);
+    }
+
+    // The caller decodes what it is looking at; the workers fill in the rest
+    const unsigned hardware = ThreadPool::resolveThreadCount(0);
+    const unsigned workerCount = options.threadCount > 0 ? options.threadCount
+                                                         : std::max(1u, hardware - 1);
+    lazy->m_histogram = VolumeHistogram::Builder(lazy->m_volume, workerCount + 1);
+    lazy->m_callerPartial = workerCount;
+    try {
+        for (unsigned i = 0; i < workerCount; ++i) {
+            lazy->m_workers.emplace_back([raw = lazy.get(), i]() { raw->workerLoop(i); });
+        }
+    }
+    catch (const std::exception& e) {
+        // Already started workers are joined by the destructor
+        s_lastError = std::string("Failed to start decode threads: ") + e.what();
+        return nullptr;
+    }
+
+    std::cout << "Opened lazy volume " << lazy->m_volume.width << "x" << lazy->m_volume.height << "x"
+              << lazy->m_volume.depth << " with " << workerCount << " background decoders" << std::endl;
+    return lazy;
+}
+
+LazyVolume::~LazyVolume()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_cancel = true;
+    }
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+LazyVolume::SliceState LazyVolume::getSliceState(int z) const
+{
+    if (z < 0 || z >= m_volume.depth) {
+        return SliceState::Failed;
+    }
+    return static_cast<SliceState>(m_states[static_cast<size_t>(z)].load(std::memory_order_acquire));
+}
+
+bool LazyVolume::requestSlice(int z)
+{
+    if (z < 0 || z >= m_volume.depth) {
+        return false;
+    }
+    const size_t slice = static_cast<size_t>(z);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto state = static_cast<SliceState>(m_states[slice].load());
+    if (state == SliceState::Pending) {
+        // Nobody has started it: decode here rather than wait for the queue
+        m_states[slice].store(static_cast<uint8_t>(SliceState::Decoding));
+        lock.unlock();
+        std::vector<char> buffer;
+        decodeSlice(slice, buffer, m_callerPartial);
+        lock.lock();
+    } else if (state == SliceState::Decoding) {
+        m_sliceFinished.wait(lock, [this, slice]() {
+            return static_cast<SliceState>(m_states[slice].load()) != SliceState::Decoding;
+        });
+    }
+    return static_cast<SliceState>(m_states[slice].load()) == SliceState::Ready;
+}
+
+void LazyVolume::setFocus(int z)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_focus = static_cast<size_t>(std::clamp(z, 0, std::max(0, m_volume.depth - 1)));
+}
+
+size_t LazyVolume::getFinishedSliceCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_finished;
+}
+
+bool LazyVolume::waitUntilComplete()
+{
+    // Help the workers instead of only waiting
+    std::vector<char> buffer;
+    size_t z = 0;
+    while (claimNextSlice(z)) {
+        decodeSlice(z, buffer, m_callerPartial);
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_sliceFinished.wait(lock, [this]() { return m_finished == m_slices.size(); });
+    return m_failed == 0;
+}
+
+bool LazyVolume::getValueRange(float& minValue, float& maxValue) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_finished == m_failed) {
+        return false;
+    }
+    if (m_volume.voxelType == Volume3D::VoxelType::Float32) {
+        minValue = m_minValue;
+        maxValue = m_maxValue;
+    } else {
+        DicomSeriesLoader::getStoredValueRange(m_volume, m_storedMin, m_storedMax, minValue, maxValue);
+    }
+    return true;
+}
+
+Volume3D LazyVolume::toVolume()
+{
+    s_lastError.clear();
+
+    if (!waitUntilComplete()) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        s_lastError = m_error;
+        return Volume3D{};
+    }
+
+    Volume3D volume = m_volume;
+    getValueRange(volume.vmin, volume.vmax);
+    volume.brickRanges = m_brickRanges.build();
+    volume.histogram = m_histogram.build();
+    return volume;
+}
+
+void LazyVolume::workerLoop(size_t worker)
+{
+    std::vector<char> buffer;  // Raw pixel buffer reused across this worker's slices
+    size_t z = 0;
+    while (claimNextSlice(z)) {
+        decodeSlice(z, buffer, worker);
+    }
+}
+
+bool LazyVolume::claimNextSlice(size_t& z)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_cancel) {
+        return false;
+    }
+    if (m_progress && m_progress->isCancelled()) {
+        failPendingSlices();
+        return false;
+    }
+
+    // Nearest pending slice to the focus, alternating above and below it
+    const size_t depth = m_slices.size();
+    auto tryClaim = [this, &z](size_t candidate) {
+        if (static_cast<SliceState>(m_states[candidate].load()) != SliceState::Pending) {
+            return false;
+        }
+        m_states[candidate].store(static_cast<uint8_t>(SliceState::Decoding));
+        z = candidate;
+        return true;
+    };
+    for (size_t distance = 0; distance < depth; ++distance) {
+        const bool above = m_focus + distance < depth;
+        const bool below = distance > 0 && distance <= m_focus;
+        if (!above && !below && distance > m_focus) {
+            break;
+        }
+        if ((above && tryClaim(m_focus + distance)) || (below && tryClaim(m_focus - distance))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void LazyVolume::decodeSlice(size_t z, std::vector<char>& buffer, size_t worker)
+{
+    const size_t sliceSize = static_cast<size_t>(m_volume.width) * m_volume.height;
+    float minValue = std::numeric_limits<float>::max();
+    float maxValue = std::numeric_limits<float>::lowest();
+    int32_t storedMin = std::numeric_limits<int32_t>::max();
+    int32_t storedMax = std::numeric_limits<int32_t>::min();
+
+    // Each slice owns a disjoint part of the buffer, so no lock is held while decoding
+    bool ok;
+    if (m_volume.voxelType == Volume3D::VoxelType::Float32) {
+        float* destination = m_volume.voxels.data() + z * sliceSize;
+        ok = DicomSeriesLoader::loadPixelData(m_slices[z], destination, buffer, minValue, maxValue);
+    } else {
+        char* destination = static_cast<char*>(m_volume.storedVoxels.get()) +
+                            z * sliceSize * Volume3D::getVoxelTypeSize(m_volume.voxelType);
+        ok = DicomSeriesLoader::loadStoredPixelData(m_slices[z], destination, buffer, storedMin, storedMax);
+    }
+    if (ok) {
+        if (m_progress) {
+            const size_t bytesPerPixel = (m_slices[z].bitsAllocated + 7) / 8;
+            m_progress->slicesDecoded.fetch_add(1, std::memory_order_relaxed);
+            m_progress->bytesDecoded.fetch_add(sliceSize * bytesPerPixel, std::memory_order_relaxed);
+        }
+        m_brickRanges.addSlice(m_volume, static_cast<int>(z));
+        if (worker != m_callerPartial) {
+            m_histogram.addSlice(m_volume, static_cast<int>(z), worker);
+        } else {
+            std::lock_guard<std::mutex> lock(m_callerHistogramMutex);
+            m_histogram.addSlice(m_volume, static_cast<int>(z), worker);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (ok) {
+            m_minValue = std::min(m_minValue, minValue);
+            m_maxValue = std::max(m_maxValue, maxValue);
+            m_storedMin = std::min(m_storedMin, storedMin);
+            m_storedMax = std::max(m_storedMax, storedMax);
+        } else {
+            ++m_failed;
+            if (m_error.empty()) {
+                m_error = "Failed to load pixel data for slice " + std::to_string(z);
+            }
+        }
+        ++m_finished;
+        m_states[z].store(static_cast<uint8_t>(ok ? SliceState::Ready : SliceState::Failed),
+                          std::memory_order_release);
+    }
+    m_sliceFinished.notify_all();
+}
+
+void LazyVolume::failPendingSlices()
+{
+    bool failed = false;
+    for (size_t z = 0; z < m_slices.size(); ++z) {
+        if (static_cast<SliceState>(m_states[z].load()) == SliceState::Pending) {
+            m_states[z].store(static_cast<uint8_t>(SliceState::Failed), std::memory_order_release);
+            ++m_failed;
+            ++m_finished;
+            failed = true;
+        }
+    }
+    if (failed) {
+        if (m_error.empty()) {
+            m_error = "Loading cancelled";
+        }
+        m_sliceFinished.notify_all();
+    }
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "BrickRangeGrid.h"
+#include "DicomSeriesLoader.h"
+#include "LoadProgress.h"
+#include "Volume3D.h"
+#include "VolumeHistogram.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Demand-paged volume whose slices are decoded on first access
+ *
+ * open() reads only the headers, sizes the volume and returns immediately.
+ * Background workers then decode the remaining slices in order of distance
+ * from the focus slice, so the slices around the current view arrive first.
+ * requestSlice() decodes a slice on the calling thread if no worker has
+ * started it yet, which puts the first image on screen after a single decode.
+ *
+ * The voxel buffer is allocated up front and never moves; native storage comes
+ * from zero pages, so only decoded slices commit memory. Slices that are not
+ * ready yet read as zero (stored zero for native storage). Volume3D::vmin/vmax
+ * are only final in toVolume(); use getValueRange() while loading.
+ */
+class LazyVolume
+{
+public:
+    /**
+     * @brief Decode state of one slice
+     */
+    enum class SliceState : uint8_t
+    {
+        Pending,
+        Decoding,
+        Ready,
+        Failed
+    };
+
+    /**
+     * @brief Prepare a series and start the background decoders
+     * @param seriesInfo Series information with file paths
+     * @param options Storage mode, number of background decode threads
+     *                (0 = hardware threads minus one for the caller) and optional
+     *                progress, which must outlive the lazy volume. Cancelling
+     *                fails the slices not started yet.
+     * @return Lazy volume, or nullptr on error (see getLastError)
+     */
+    static std::shared_ptr<LazyVolume> open(const DicomSeriesLoader::SeriesInfo& seriesInfo,
+                                            const SeriesLoadOptions& options = SeriesLoadOptions());
+
+    ~LazyVolume();
+
+    LazyVolume(const LazyVolume&) = delete;
+    LazyVolume& operator=(const LazyVolume&) = delete;
+
+    /**
+     * @brief Geometry, metadata and the (partially filled) voxel buffer
+     */
+    const Volume3D& getVolume() const { return m_volume; }
+
+    /**
+     * @brief Number of slices (volume depth)
+     */
+    int getSliceCount() const { return m_volume.depth; }
+
+    /**
+     * @brief Get decode state of a slice without blocking
+     */
+    SliceState getSliceState(int z) const;
+
+    /**
+     * @brief Check if a slice has been decoded
+     */
+    bool isSliceReady(int z) const { return getSliceState(z) == SliceState::Ready; }
+
+    /**
+     * @brief Make sure a slice is decoded, blocking until it is
+     *
+     * Decodes on the calling thread when the slice has not been started, or waits
+     * for the worker that is decoding it.
+     *
+     * @param z Slice index [0, depth-1]
+     * @return true if the slice is ready, false if it failed to decode
+     */
+    bool requestSlice(int z);
+
+    /**
+     * @brief Move the background decode order to start around this slice
+     */
+    void setFocus(int z);
+
+    /**
+     * @brief Number of slices decoded so far (ready or failed)
+     */
+    size_t getFinishedSliceCount() const;
+
+    /**
+     * @brief Check if every slice has been decoded (or failed)
+     */
+    bool isComplete() const { return getFinishedSliceCount() == static_cast<size_t>(m_volume.depth); }
+
+    /**
+     * @brief Block until all slices are decoded
+     * @return true if no slice failed
+     */
+    bool waitUntilComplete();
+
+    /**
+     * @brief Value range over the slices decoded so far
+     * @return false if no slice is ready yet
+     */
+    bool getValueRange(float& minValue, float& maxValue) const;
+
+    /**
+     * @brief Complete volume with its final value range
+     *
+     * Waits for the remaining slices. Native storage is shared with this object,
+     * float32 storage is copied. The brick range grid and histogram are
+     * attached here.
+     *
+     * @return Volume, or invalid volume if a slice failed
+     */
+    Volume3D toVolume();
+
+    /**
+     * @brief Get the last error message of the calling thread
+     */
+    static std::string getLastError();
+
+private:
+    LazyVolume() = default;
+
+    void workerLoop(size_t worker);
+    bool claimNextSlice(size_t& z);
+
+    /**
+     * @brief Mark every slice nobody has started as failed (m_mutex held)
+     */
+    void failPendingSlices();
+
+    /**
+     * @brief Decode one claimed slice
+     * @param worker Worker index, or m_callerPartial for threads outside the pool
+     */
+    void decodeSlice(size_t z, std::vector<char>& buffer, size_t worker);
+
+    Volume3D m_volume;
+    std::vector<DicomSeriesLoader::SliceInfo> m_slices;  // In volume order
+
+    std::unique_ptr<std::atomic<uint8_t>[]> m_states;    // SliceState per slice, readable without the lock
+    BrickRangeGrid::Builder m_brickRanges;               // Filled per decoded slice, built in toVolume
+    VolumeHistogram::Builder m_histogram;                // One partial per worker, plus one for callers
+    size_t m_callerPartial{0};                           // = worker count, fixed before the workers start
+    std::mutex m_callerHistogramMutex;                   // Guards the callers' partial
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_sliceFinished;
+    size_t m_focus{0};
+    size_t m_finished{0};
+    size_t m_failed{0};
+    bool m_cancel{false};
+    std::string m_error;  // First decode failure
+    LoadProgress* m_progress{nullptr};
+
+    // Running range over decoded slices (stored values for native storage)
+    float m_minValue{std::numeric_limits<float>::max()};
+    float m_maxValue{std::numeric_limits<float>::lowest()};
+    int32_t m_storedMin{std::numeric_limits<int32_t>::max()};
+    int32_t m_storedMax{std::numeric_limits<int32_t>::min()};
+
+    std::vector<std::thread> m_workers;
+
+    static thread_local std::string s_lastError;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Progress counters and cancellation flag shared with a scan or load
+ * 
+ * Written by the worker threads and polled by the UI; all members are atomic,
+ * so the UI can read them at any time without locking.
+ */
+struct LoadProgress
+{
+    // Directory scan
+    std::atomic<size_t> filesFound{0};     // Regular files enumerated so far
+    std::atomic<size_t> filesScanned{0};   // Files parsed or answered from the scan index
+    
+    // Series load
+    std::atomic<size_t> slicesTotal{0};
+    std::atomic<size_t> slicesDecoded{0};
+    std::atomic<uint64_t> bytesDecoded{0}; // Decoded pixel bytes (stored size)
+    
+    std::atomic<bool> cancelled{false};
+    
+    /**
+     * @brief Ask the running scan or load to stop at the next file or slice
+     */
+    void cancel() { cancelled.store(true); }
+    
+    /**
+     * @brief Check if cancellation was requested
+     */
+    bool isCancelled() const { return cancelled.load(std::memory_order_relaxed); }
+};
@@ -0,0 +1,178 @@
+#include "MPRReslicer.h"
+#include "BrickedVolume.h"
+#include "PixelConversion.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+namespace {
+    // Rows per task: enough pixels to amortize scheduling on small planes
+    size_t minRowsPerChunk(int width)
+    {
+        return std::max<size_t>(1, 16384 / static_cast<size_t>(std::max(1, width)));
+    }
+    
+    template <typename T>
+    PixelConversion::StoredType storedTypeOf()
+    {
+        if constexpr (std::is_same_v<T, int16_t>) {
+            return PixelConversion::StoredType::Int16;
+        } else if constexpr (std::is_same_v<T, uint16_t>) {
+            return PixelConversion::StoredType::UInt16;
+        } else {
+            return PixelConversion::StoredType::UInt8;
+        }
+    }
+    
+    /**
+     * @brief Convert a contiguous run of voxels to rescaled floats
+     */
+    template <typename T>
+    void convertRun(const VoxelView<T>& view, size_t first, size_t count, float* destination)
+    {
+        if constexpr (std::is_same_v<T, float>) {
+            std::memcpy(destination, view.data + first, count * sizeof(float));
+        } else {
+            // Same rescale expression as VoxelView::valueAt, in the SIMD kernels
+            PixelConversion::Rescale rescale;
+            rescale.enabled = true;
+            rescale.slope = view.slope;
+            rescale.intercept = view.intercept;
+            float lo = std::numeric_limits<float>::max();
+            float hi = std::numeric_limits<float>::lowest();
+            PixelConversion::convertToFloat(view.data + first, storedTypeOf<T>(), count, rescale,
+                                            destination, lo, hi);
+        }
+    }
+}
+
+int MPRReslicer::getSliceCount(const Volume3D& volume, Orientation orientation)
+{
+    switch (orientation) {
+    case Orientation::Coronal:
+        return volume.height;
+    case Orientation::Sagittal:
+        return volume.width;
+    default:
+        return volume.depth;
+    }
+}
+
+void MPRReslicer::getSliceGeometry(const Volume3D& volume, Orientation orientation,
+                                   int& width, int& height, double pixelSpacing[2])
+{
+    switch (orientation) {
+    case Orientation::Coronal:
+        width = volume.width;
+        height = volume.depth;
+        pixelSpacing[0] = volume.spacing[0];
+        pixelSpacing[1] = volume.spacing[2];
+        break;
+    case Orientation::Sagittal:
+        width = volume.height;
+        height = volume.depth;
+        pixelSpacing[0] = volume.spacing[1];
+        pixelSpacing[1] = volume.spacing[2];
+        break;
+    default:
+        width = volume.width;
+        height = volume.height;
+        pixelSpacing[0] = volume.spacing[0];
+        pixelSpacing[1] = volume.spacing[1];
+        break;
+    }
+}
+
+bool MPRReslicer::extractSlice(const Volume3D& volume, Orientation orientation, int index,
+                               SliceImage& output, ThreadPool* pool)
+{
+    if (!volume.isValid() || index < 0 || index >= getSliceCount(volume, orientation)) {
+        return false;
+    }
+    
+    int width = 0, height = 0;
+    getSliceGeometry(volume, orientation, width, height, output.pixelSpacing);
+    output.resize(width, height);
+    
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    const size_t rowStride = static_cast<size_t>(volume.width);
+    const size_t sliceStride = rowStride * volume.height;
+    const int lastSlice = volume.depth - 1;
+    
+    volume.visitVoxels([&](const auto& view) {
+        threads.parallelFor(static_cast<size_t>(height), [&](size_t, size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                float* out = output.row(static_cast<int>(y));
+                switch (orientation) {
+                case Orientation::Axial:
+                    convertRun(view, index * sliceStride + y * rowStride, rowStride, out);
+                    break;
+                case Orientation::Coronal:
+                    convertRun(view, (lastSlice - y) * sliceStride + index * rowStride, rowStride, out);
+                    break;
+                case Orientation::Sagittal: {
+                    // Column `index` of one slice: a constant-stride gather
+                    size_t source = (lastSlice - y) * sliceStride + static_cast<size_t>(index);
+                    for (int x = 0; x < width; ++x, source += rowStride) {
+                        out[x] = view.valueAt(source);
+                    }
+                    break;
+                }
+                }
+            }
+        }, minRowsPerChunk(width));
+    });
+    
+    return true;
+}
+
+bool MPRReslicer::extractSlice(const Volume3D& volume, const BrickedVolume& bricks, Orientation orientation,
+                               int index, SliceImage& output, ThreadPool* pool)
+{
+    if (!volume.isValid() || !bricks.isValid() || bricks.getWidth() != volume.width ||
+        bricks.getHeight() != volume.height || bricks.getDepth() != volume.depth ||
+        index < 0 || index >= getSliceCount(volume, orientation)) {
+        return false;
+    }
+    
+    int width = 0, height = 0;
+    getSliceGeometry(volume, orientation, width, height, output.pixelSpacing);
+    output.resize(width, height);
+    
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    const int lastSlice = volume.depth - 1;
+    
+    bricks.visitVoxels([&](const auto& view) {
+        threads.parallelFor(static_cast<size_t>(height), [&](size_t, size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                float* out = output.row(static_cast<int>(y));
+                const int row = static_cast<int>(y);
+                
+                // Two of the three offsets are fixed per output row
+                size_t base = 0;
+                const size_t* step = nullptr;
+                switch (orientation) {
+                case Orientation::Axial:
+                    base = view.zOffset[index] + view.yOffset[row];
+                    step = view.xOffset;
+                    break;
+                case Orientation::Coronal:
+                    base = view.zOffset[lastSlice - row] + view.yOffset[index];
+                    step = view.xOffset;
+                    break;
+                case Orientation::Sagittal:
+                    base = view.zOffset[lastSlice - row] + view.xOffset[index];
+                    step = view.yOffset;
+                    break;
+                }
+                for (int x = 0; x < width; ++x) {
+                    out[x] = view.valueAt(base + step[x]);
+                }
+            }
+        }, minRowsPerChunk(width));
+    });
+    
+    return true;
+}
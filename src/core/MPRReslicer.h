@@ -0,0 +1,99 @@
+#pragma once
+
+#include "Volume3D.h"
+#include <vector>
+
+class BrickedVolume;
+class ThreadPool;
+
+/**
+ * @brief 2D float image produced by the reslicer
+ * 
+ * Reused across calls: the pixel buffer only grows, so scrolling through a
+ * volume does not allocate once the first slice has been extracted.
+ */
+struct SliceImage
+{
+    int width{0};
+    int height{0};
+    double pixelSpacing[2]{1.0, 1.0};  // column (x), row (y) spacing in mm
+    std::vector<float> pixels;         // Row-major, width * height
+    
+    /**
+     * @brief Set dimensions, growing the buffer only when needed
+     */
+    void resize(int w, int h)
+    {
+        width = w;
+        height = h;
+        const size_t count = static_cast<size_t>(w) * h;
+        if (pixels.size() < count) {
+            pixels.resize(count);
+        }
+    }
+    
+    float* row(int y) { return pixels.data() + static_cast<size_t>(y) * width; }
+    const float* row(int y) const { return pixels.data() + static_cast<size_t>(y) * width; }
+};
+
+/**
+ * @brief CPU extraction of orthogonal MPR planes from a Volume3D
+ * 
+ * Plane conventions (voxel axes of the volume):
+ * - Axial:    fixed z, image x = volume x, image y = volume y
+ * - Coronal:  fixed y, image x = volume x, image y = volume z (last slice at the top)
+ * - Sagittal: fixed x, image x = volume y, image y = volume z (last slice at the top)
+ * 
+ * For the usual feet-to-head sorted CT this puts superior at the top of the
+ * coronal and sagittal images.
+ * 
+ * Axial and coronal rows are contiguous runs of the volume and are converted
+ * with the SIMD pixel kernels; sagittal rows are strided gathers. Output rows
+ * are split across the thread pool. Values are the rescaled voxel values,
+ * identical to Volume3D::getVoxel.
+ */
+class MPRReslicer
+{
+public:
+    enum class Orientation
+    {
+        Axial,
+        Coronal,
+        Sagittal
+    };
+    
+    /**
+     * @brief Number of planes along an orientation
+     */
+    static int getSliceCount(const Volume3D& volume, Orientation orientation);
+    
+    /**
+     * @brief Output image size and pixel spacing of a plane
+     */
+    static void getSliceGeometry(const Volume3D& volume, Orientation orientation,
+                                 int& width, int& height, double pixelSpacing[2]);
+    
+    /**
+     * @brief Extract one orthogonal plane
+     * @param volume Source volume
+     * @param orientation Plane orientation
+     * @param index Plane index [0, getSliceCount-1]
+     * @param output Reused output image
+     * @param pool Pool to split rows over (nullptr = global pool)
+     * @return false if the volume is invalid or the index out of range
+     */
+    static bool extractSlice(const Volume3D& volume, Orientation orientation, int index,
+                             SliceImage& output, ThreadPool* pool = nullptr);
+    
+    /**
+     * @brief Extract one orthogonal plane from the bricked copy of a volume
+     * 
+     * Same output as the Volume3D overload; sagittal planes read far fewer cache
+     * lines from bricks than from the linear layout.
+     * 
+     * @param volume Volume the bricks were built from (geometry)
+     * @param bricks Bricked voxels of volume
+     */
+    static bool extractSlice(const Volume3D& volume, const BrickedVolume& bricks, Orientation orientation,
+                             int index, SliceImage& output, ThreadPool* pool = nullptr);
+};
@@ -0,0 +1,442 @@
+#include "ObliqueReslicer.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#if AMPR_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    using Interpolation = ObliqueReslicer::Interpolation;
+
+    /**
+     * @brief Per-call constants shared by every row kernel
+     */
+    struct SampleGrid
+    {
+        int size[3];            // Volume dimensions
+        size_t stride[3];       // Element stride per axis (1, width, width * height)
+        size_t neighbour[3];    // Stride to the +1 neighbour, 0 on single-voxel axes
+        float low[3];           // Valid sample range per axis for the mode
+        float high[3];
+        float slope;            // Rescale applied after interpolation
+        float intercept;
+        float background;       // Value outside the volume
+    };
+
+    /**
+     * @brief Catmull-Rom weights for a fractional offset t in [0, 1)
+     */
+    inline void cubicWeights(float t, float w[4])
+    {
+        const float t2 = t * t;
+        const float t3 = t2 * t;
+        w[0] = 0.5f * (-t3 + 2.0f * t2 - t);
+        w[1] = 0.5f * (3.0f * t3 - 5.0f * t2 + 2.0f);
+        w[2] = 0.5f * (-3.0f * t3 + 4.0f * t2 + t);
+        w[3] = 0.5f * (t3 - t2);
+    }
+
+    /**
+     * @brief Scalar sampler for one interpolation mode; positions are already clamped
+     */
+    template <Interpolation Mode, typename T>
+    struct Sampler
+    {
+        static float sample(const VoxelView<T>& view, const SampleGrid& grid, float x, float y, float z)
+        {
+            if constexpr (Mode == Interpolation::Nearest) {
+                const size_t index = static_cast<size_t>(x + 0.5f) * grid.stride[0] +
+                                     static_cast<size_t>(y + 0.5f) * grid.stride[1] +
+                                     static_cast<size_t>(z + 0.5f) * grid.stride[2];
+                return view.valueAt(index);
+            } else if constexpr (Mode == Interpolation::Linear) {
+                // The lower corner stops one short of the edge, so the +1 neighbour always exists
+                const int x0 = std::min(static_cast<int>(x), grid.size[0] - 1 - static_cast<int>(grid.neighbour[0] != 0));
+                const int y0 = std::min(static_cast<int>(y), grid.size[1] - 1 - static_cast<int>(grid.neighbour[1] != 0));
+                const int z0 = std::min(static_cast<int>(z), grid.size[2] - 1 - static_cast<int>(grid.neighbour[2] != 0));
+                const float tx = x - static_cast<float>(x0);
+                const float ty = y - static_cast<float>(y0);
+                const float tz = z - static_cast<float>(z0);
+
+                const T* p = view.data + x0 * grid.stride[0] + y0 * grid.stride[1] + z0 * grid.stride[2];
+                const size_t ox = grid.neighbour[0], oy = grid.neighbour[1], oz = grid.neighbour[2];
+                const float c00 = static_cast<float>(p[0]) + tx * (static_cast<float>(p[ox]) - static_cast<float>(p[0]));
+                const float c10 = static_cast<float>(p[oy]) + tx * (static_cast<float>(p[oy + ox]) - static_cast<float>(p[oy]));
+                const float c01 = static_cast<float>(p[oz]) + tx * (static_cast<float>(p[oz + ox]) - static_cast<float>(p[oz]));
+                const float c11 = static_cast<float>(p[oz + oy]) + tx * (static_cast<float>(p[oz + oy + ox]) - static_cast<float>(p[oz + oy]));
+                const float c0 = c00 + ty * (c10 - c00);
+                const float c1 = c01 + ty * (c11 - c01);
+                return (c0 + tz * (c1 - c0)) * grid.slope + grid.intercept;
+            } else {
+                const int xi = static_cast<int>(x);
+                const int yi = static_cast<int>(y);
+                const int zi = static_cast<int>(z);
+                float wx[4], wy[4], wz[4];
+                cubicWeights(x - static_cast<float>(xi), wx);
+                cubicWeights(y - static_cast<float>(yi), wy);
+                cubicWeights(z - static_cast<float>(zi), wz);
+
+                // Taps outside the volume repeat the edge voxel
+                size_t ox[4], oy[4], oz[4];
+                for (int k = 0; k < 4; ++k) {
+                    ox[k] = static_cast<size_t>(std::clamp(xi - 1 + k, 0, grid.size[0] - 1)) * grid.stride[0];
+                    oy[k] = static_cast<size_t>(std::clamp(yi - 1 + k, 0, grid.size[1] - 1)) * grid.stride[1];
+                    oz[k] = static_cast<size_t>(std::clamp(zi - 1 + k, 0, grid.size[2] - 1)) * grid.stride[2];
+                }
+
+                float sum = 0.0f;
+                for (int c = 0; c < 4; ++c) {
+                    float plane = 0.0f;
+                    for (int b = 0; b < 4; ++b) {
+                        const T* row = view.data + oz[c] + oy[b];
+                        const float line = wx[0] * static_cast<float>(row[ox[0]]) + wx[1] * static_cast<float>(row[ox[1]]) +
+                                           wx[2] * static_cast<float>(row[ox[2]]) + wx[3] * static_cast<float>(row[ox[3]]);
+                        plane += wy[b] * line;
+                    }
+                    sum += wz[c] * plane;
+                }
+                return sum * grid.slope + grid.intercept;
+            }
+        }
+    };
+
+    template <Interpolation Mode, typename T>
+    void sampleRowScalar(const VoxelView<T>& view, const SampleGrid& grid, const float start[3],
+                         const float step[3], int begin, int end, float* out)
+    {
+        for (int i = begin; i < end; ++i) {
+            const float fi = static_cast<float>(i);
+            const float x = std::min(std::max(start[0] + fi * step[0], grid.low[0]), grid.high[0]);
+            const float y = std::min(std::max(start[1] + fi * step[1], grid.low[1]), grid.high[1]);
+            const float z = std::min(std::max(start[2] + fi * step[2], grid.low[2]), grid.high[2]);
+            out[i] = Sampler<Mode, T>::sample(view, grid, x, y, z);
+        }
+    }
+
+#if AMPR_HAS_X86_SIMD
+    // Lower and upper 16-bit halves of each 32-bit lane as float
+    AMPR_TARGET_AVX2 inline void splitPairs(__m256i pairs, const int16_t*, __m256& low, __m256& high)
+    {
+        low = _mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pairs, 16), 16));
+        high = _mm256_cvtepi32_ps(_mm256_srai_epi32(pairs, 16));
+    }
+    AMPR_TARGET_AVX2 inline void splitPairs(__m256i pairs, const uint16_t*, __m256& low, __m256& high)
+    {
+        low = _mm256_cvtepi32_ps(_mm256_and_si256(pairs, _mm256_set1_epi32(0xFFFF)));
+        high = _mm256_cvtepi32_ps(_mm256_srli_epi32(pairs, 16));
+    }
+
+    /**
+     * @brief Voxel at index and its +x neighbour for 8 lanes
+     *
+     * 16-bit voxels: one 32-bit gather returns both (the lower corner never sits
+     * on the last column, so the read stays inside the buffer). Float: two gathers.
+     */
+    template <typename T>
+    AMPR_TARGET_AVX2 inline void gatherPair(const T* data, __m256i index, __m256& value, __m256& next)
+    {
+        if constexpr (std::is_same_v<T, float>) {
+            value = _mm256_i32gather_ps(data, index, 4);
+            next = _mm256_i32gather_ps(data + 1, index, 4);
+        } else {
+            const __m256i pairs = _mm256_i32gather_epi32(reinterpret_cast<const int*>(data), index, 2);
+            splitPairs(pairs, data, value, next);
+        }
+    }
+
+    /**
+     * @brief Trilinear row kernel, 8 pixels per step; same operations as Sampler<Linear>
+     */
+    template <typename T>
+    AMPR_TARGET_AVX2 int sampleRowLinearAVX2(const VoxelView<T>& view, const SampleGrid& grid,
+                                             const float start[3], const float step[3],
+                                             int begin, int end, float* out)
+    {
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 s[3], d[3], lo[3], hi[3];
+        __m256i lastCorner[3];
+        for (int a = 0; a < 3; ++a) {
+            s[a] = _mm256_set1_ps(start[a]);
+            d[a] = _mm256_set1_ps(step[a]);
+            lo[a] = _mm256_set1_ps(grid.low[a]);
+            hi[a] = _mm256_set1_ps(grid.high[a]);
+            lastCorner[a] = _mm256_set1_epi32(grid.size[a] - 2);
+        }
+        const __m256i strideY = _mm256_set1_epi32(static_cast<int>(grid.stride[1]));
+        const __m256i strideZ = _mm256_set1_epi32(static_cast<int>(grid.stride[2]));
+        const __m256i offsetY = strideY;
+        const __m256i offsetZ = strideZ;
+        const __m256 slope = _mm256_set1_ps(grid.slope);
+        const __m256 intercept = _mm256_set1_ps(grid.intercept);
+
+        int i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256 fi = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(i), lanes));
+            __m256i corner[3];
+            __m256 t[3];
+            for (int a = 0; a < 3; ++a) {
+                const __m256 p = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(s[a], _mm256_mul_ps(fi, d[a])), lo[a]), hi[a]);
+                corner[a] = _mm256_min_epi32(_mm256_cvttps_epi32(p), lastCorner[a]);
+                t[a] = _mm256_sub_ps(p, _mm256_cvtepi32_ps(corner[a]));
+            }
+            const __m256i index = _mm256_add_epi32(corner[0], _mm256_add_epi32(_mm256_mullo_epi32(corner[1], strideY),
+                                                                               _mm256_mullo_epi32(corner[2], strideZ)));
+
+            __m256 v000, v100, v010, v110, v001, v101, v011, v111;
+            gatherPair(view.data, index, v000, v100);
+            gatherPair(view.data, _mm256_add_epi32(index, offsetY), v010, v110);
+            gatherPair(view.data, _mm256_add_epi32(index, offsetZ), v001, v101);
+            gatherPair(view.data, _mm256_add_epi32(index, _mm256_add_epi32(offsetY, offsetZ)), v011, v111);
+
+            const __m256 c00 = _mm256_add_ps(v000, _mm256_mul_ps(t[0], _mm256_sub_ps(v100, v000)));
+            const __m256 c10 = _mm256_add_ps(v010, _mm256_mul_ps(t[0], _mm256_sub_ps(v110, v010)));
+            const __m256 c01 = _mm256_add_ps(v001, _mm256_mul_ps(t[0], _mm256_sub_ps(v101, v001)));
+            const __m256 c11 = _mm256_add_ps(v011, _mm256_mul_ps(t[0], _mm256_sub_ps(v111, v011)));
+            const __m256 c0 = _mm256_add_ps(c00, _mm256_mul_ps(t[1], _mm256_sub_ps(c10, c00)));
+            const __m256 c1 = _mm256_add_ps(c01, _mm256_mul_ps(t[1], _mm256_sub_ps(c11, c01)));
+            const __m256 value = _mm256_add_ps(c0, _mm256_mul_ps(t[2], _mm256_sub_ps(c1, c0)));
+            _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(value, slope), intercept));
+        }
+        return i;
+    }
+#endif
+
+    /**
+     * @brief Clip the pixel range [begin, end) of one row to where the samples lie inside the grid
+     */
+    void clipRow(const SampleGrid& grid, const double start[3], const double step[3], int& begin, int& end)
+    {
+        // Positions within rounding distance of the edge count as inside; the kernels clamp them
+        constexpr double kTolerance = 1e-3;
+        
+        double first = begin;
+        double last = end - 1;
+        for (int a = 0; a < 3; ++a) {
+            const double low = grid.low[a] - kTolerance;
+            const double high = grid.high[a] + kTolerance;
+            if (std::abs(step[a]) < 1e-12) {
+                if (start[a] < low || start[a] > high) {
+                    end = begin;
+                    return;
+                }
+                continue;
+            }
+            double t0 = (low - start[a]) / step[a];
+            double t1 = (high - start[a]) / step[a];
+            if (t0 > t1) {
+                std::swap(t0, t1);
+            }
+            first = std::max(first, std::ceil(t0));
+            last = std::min(last, std::floor(t1));
+        }
+        if (first > last) {
+            end = begin;
+            return;
+        }
+        begin = static_cast<int>(first);
+        end = static_cast<int>(last) + 1;
+    }
+
+    template <Interpolation Mode, typename T>
+    void resliceRows(const VoxelView<T>& view, const SampleGrid& grid, const ObliqueReslicer::Affine& affine,
+                     int width, float* output, size_t rowStride, bool useAVX2, size_t begin, size_t end)
+    {
+        const float stepU[3] = {static_cast<float>(affine.stepU[0]), static_cast<float>(affine.stepU[1]),
+                                static_cast<float>(affine.stepU[2])};
+
+        for (size_t j = begin; j < end; ++j) {
+            float* out = output + j * rowStride;
+
+            // Row origin in double, so rows do not accumulate error down the image
+            const double rowStart[3] = {affine.origin[0] + j * affine.stepV[0],
+                                        affine.origin[1] + j * affine.stepV[1],
+                                        affine.origin[2] + j * affine.stepV[2]};
+            int first = 0;
+            int last = width;
+            clipRow(grid, rowStart, affine.stepU, first, last);
+
+            std::fill(out, out + first, grid.background);
+            std::fill(out + std::max(first, last), out + width, grid.background);
+            if (first >= last) {
+                continue;
+            }
+
+            const float start[3] = {static_cast<float>(rowStart[0]), static_cast<float>(rowStart[1]),
+                                    static_cast<float>(rowStart[2])};
+            int i = first;
+#if AMPR_HAS_X86_SIMD
+            if constexpr (Mode == Interpolation::Linear && !std::is_same_v<T, uint8_t>) {
+                if (useAVX2) {
+                    i = sampleRowLinearAVX2(view, grid, start, stepU, first, last, out);
+                }
+            }
+#endif
+            sampleRowScalar<Mode, T>(view, grid, start, stepU, i, last, out);
+        }
+        (void)useAVX2;
+    }
+
+    SampleGrid makeGrid(const Volume3D& volume, Interpolation mode, bool rescale, float background)
+    {
+        SampleGrid grid;
+        grid.size[0] = volume.width;
+        grid.size[1] = volume.height;
+        grid.size[2] = volume.depth;
+        grid.stride[0] = 1;
+        grid.stride[1] = static_cast<size_t>(volume.width);
+        grid.stride[2] = static_cast<size_t>(volume.width) * volume.height;
+        for (int a = 0; a < 3; ++a) {
+            grid.neighbour[a] = grid.size[a] > 1 ? grid.stride[a] : 0;
+            // Nearest covers each voxel's full extent; interpolating modes stop at the centers
+            grid.low[a] = mode == Interpolation::Nearest ? -0.5f : 0.0f;
+            grid.high[a] = mode == Interpolation::Nearest ? std::nextafter(grid.size[a] - 0.5f, 0.0f)
+                                                          : static_cast<float>(grid.size[a] - 1);
+        }
+        const bool native = rescale && volume.voxelType != Volume3D::VoxelType::Float32;
+        grid.slope = native ? static_cast<float>(volume.storedSlope) : 1.0f;
+        grid.intercept = native ? static_cast<float>(volume.storedIntercept) : 0.0f;
+        grid.background = background;
+        return grid;
+    }
+
+    // The pair gather needs a +x neighbour and 32-bit element indices
+    bool canUseAVX2(const Volume3D& volume)
+    {
+        return CpuFeatures::hasAVX2() && volume.width > 1 && volume.height > 1 && volume.depth > 1 &&
+               volume.getTotalVoxels() < static_cast<size_t>(std::numeric_limits<int32_t>::max());
+    }
+}
+
+ObliqueReslicer::Affine ObliqueReslicer::computeAffine(const Volume3D& volume, const ObliquePlane& plane)
+{
+    // World -> voxel: project onto the volume axes and divide by spacing
+    auto toVoxelDirection = [&volume](const double world[3], double voxel[3]) {
+        voxel[0] = (world[0] * volume.rowDir[0] + world[1] * volume.rowDir[1] + world[2] * volume.rowDir[2]) / volume.spacing[0];
+        voxel[1] = (world[0] * volume.colDir[0] + world[1] * volume.colDir[1] + world[2] * volume.colDir[2]) / volume.spacing[1];
+        voxel[2] = (world[0] * volume.sliceDir[0] + world[1] * volume.sliceDir[1] + world[2] * volume.sliceDir[2]) / volume.spacing[2];
+    };
+
+    Affine affine;
+    const double worldU[3] = {plane.axisU[0] * plane.pixelSpacing[0], plane.axisU[1] * plane.pixelSpacing[0],
+                              plane.axisU[2] * plane.pixelSpacing[0]};
+    const double worldV[3] = {plane.axisV[0] * plane.pixelSpacing[1], plane.axisV[1] * plane.pixelSpacing[1],
+                              plane.axisV[2] * plane.pixelSpacing[1]};
+    toVoxelDirection(worldU, affine.stepU);
+    toVoxelDirection(worldV, affine.stepV);
+
+    double center[3];
+    volume.worldToVoxel(plane.center[0], plane.center[1], plane.center[2], center[0], center[1], center[2]);
+
+    // Pixel (0, 0) is half the image away from the center along both axes
+    const double halfU = 0.5 * (plane.width - 1);
+    const double halfV = 0.5 * (plane.height - 1);
+    for (int a = 0; a < 3; ++a) {
+        affine.origin[a] = center[a] - halfU * affine.stepU[a] - halfV * affine.stepV[a];
+    }
+    return affine;
+}
+
+template <ObliqueReslicer::Interpolation Mode>
+bool ObliqueReslicer::extractSlice(const Volume3D& volume, const ObliquePlane& plane, SliceImage& output,
+                                   ThreadPool* pool)
+{
+    if (!volume.isValid() || plane.width <= 0 || plane.height <= 0) {
+        return false;
+    }
+
+    output.resize(plane.width, plane.height);
+    output.pixelSpacing[0] = plane.pixelSpacing[0];
+    output.pixelSpacing[1] = plane.pixelSpacing[1];
+
+    const Affine affine = computeAffine(volume, plane);
+    const SampleGrid grid = makeGrid(volume, Mode, true, volume.vmin);
+    const bool useAVX2 = canUseAVX2(volume);
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    const size_t minRows = std::max<size_t>(1, 16384 / static_cast<size_t>(plane.width));
+
+    volume.visitVoxels([&](const auto& view) {
+        threads.parallelFor(static_cast<size_t>(plane.height), [&](size_t, size_t begin, size_t end) {
+            resliceRows<Mode>(view, grid, affine, output.width, output.pixels.data(),
+                              static_cast<size_t>(output.width), useAVX2, begin, end);
+        }, minRows);
+    });
+
+    return true;
+}
+
+template bool ObliqueReslicer::extractSlice<ObliqueReslicer::Interpolation::Nearest>(
+    const Volume3D&, const ObliquePlane&, SliceImage&, ThreadPool*);
+template bool ObliqueReslicer::extractSlice<ObliqueReslicer::Interpolation::Linear>(
+    const Volume3D&, const ObliquePlane&, SliceImage&, ThreadPool*);
+template bool ObliqueReslicer::extractSlice<ObliqueReslicer::Interpolation::Cubic>(
+    const Volume3D&, const ObliquePlane&, SliceImage&, ThreadPool*);
+
+bool ObliqueReslicer::extractSlice(const Volume3D& volume, const ObliquePlane& plane, Interpolation interpolation,
+                                   SliceImage& output, ThreadPool* pool)
+{
+    switch (interpolation) {
+    case Interpolation::Nearest:
+        return extractSlice<Interpolation::Nearest>(volume, plane, output, pool);
+    case Interpolation::Cubic:
+        return extractSlice<Interpolation::Cubic>(volume, plane, output, pool);
+    default:
+        return extractSlice<Interpolation::Linear>(volume, plane, output, pool);
+    }
+}
+
+void ObliqueReslicer::sampleRows(const Volume3D& volume, const Affine& affine, Interpolation interpolation,
+                                 int width, int rowCount, bool rescale, float background,
+                                 float* output, size_t rowStride)
+{
+    if (!volume.isValid() || width <= 0 || rowCount <= 0) {
+        return;
+    }
+
+    const SampleGrid grid = makeGrid(volume, interpolation, rescale, background);
+    const bool useAVX2 = canUseAVX2(volume);
+    const size_t rows = static_cast<size_t>(rowCount);
+    volume.visitVoxels([&](const auto& view) {
+        switch (interpolation) {
+        case Interpolation::Nearest:
+            resliceRows<Interpolation::Nearest>(view, grid, affine, width, output, rowStride, useAVX2, 0, rows);
+            break;
+        case Interpolation::Cubic:
+            resliceRows<Interpolation::Cubic>(view, grid, affine, width, output, rowStride, useAVX2, 0, rows);
+            break;
+        default:
+            resliceRows<Interpolation::Linear>(view, grid, affine, width, output, rowStride, useAVX2, 0, rows);
+            break;
+        }
+    });
+}
+
+ObliquePlane ObliqueReslicer::makeOrthogonalPlane(const Volume3D& volume, MPRReslicer::Orientation orientation)
+{
+    ObliquePlane plane;
+    volume.voxelToWorld(0.5 * (volume.width - 1), 0.5 * (volume.height - 1), 0.5 * (volume.depth - 1),
+                        plane.center[0], plane.center[1], plane.center[2]);
+    MPRReslicer::getSliceGeometry(volume, orientation, plane.width, plane.height, plane.pixelSpacing);
+
+    // Same pixel layout as MPRReslicer: coronal/sagittal rows run from the last slice down
+    const double* u = volume.rowDir;
+    const double* v = volume.colDir;
+    double down[3] = {-volume.sliceDir[0], -volume.sliceDir[1], -volume.sliceDir[2]};
+    if (orientation == MPRReslicer::Orientation::Coronal) {
+        v = down;
+    } else if (orientation == MPRReslicer::Orientation::Sagittal) {
+        u = volume.colDir;
+        v = down;
+    }
+    for (int a = 0; a < 3; ++a) {
+        plane.axisU[a] = u[a];
+        plane.axisV[a] = v[a];
+    }
+    return plane;
+}
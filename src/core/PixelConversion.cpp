@@ -0,0 +1,437 @@
+#include "PixelConversion.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if AMPR_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    using Rescale = PixelConversion::Rescale;
+
+    template <typename T>
+    void convertScalar(const T* source, size_t count, const Rescale& rescale,
+                       float* destination, float& minValue, float& maxValue)
+    {
+        float lo = minValue;
+        float hi = maxValue;
+
+        if (rescale.enabled) {
+            for (size_t i = 0; i < count; ++i) {
+                const float value = static_cast<float>(rescale.intercept +
+                                                       rescale.slope * static_cast<float>(source[i]));
+                destination[i] = value;
+                lo = std::min(lo, value);
+                hi = std::max(hi, value);
+            }
+        } else {
+            for (size_t i = 0; i < count; ++i) {
+                const float value = static_cast<float>(source[i]);
+                destination[i] = value;
+                lo = std::min(lo, value);
+                hi = std::max(hi, value);
+            }
+        }
+
+        minValue = lo;
+        maxValue = hi;
+    }
+
+#if AMPR_HAS_X86_SIMD
+    // Widen 4 stored values to 32-bit integers
+    AMPR_TARGET_SSE41 inline __m128i load4(const uint8_t* p)
+    {
+        int32_t bits;
+        std::memcpy(&bits, p, sizeof(bits));
+        return _mm_cvtepu8_epi32(_mm_cvtsi32_si128(bits));
+    }
+    AMPR_TARGET_SSE41 inline __m128i load4(const int8_t* p)
+    {
+        int32_t bits;
+        std::memcpy(&bits, p, sizeof(bits));
+        return _mm_cvtepi8_epi32(_mm_cvtsi32_si128(bits));
+    }
+    AMPR_TARGET_SSE41 inline __m128i load4(const uint16_t* p)
+    {
+        return _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+    AMPR_TARGET_SSE41 inline __m128i load4(const int16_t* p)
+    {
+        return _mm_cvtepi16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    // Widen 8 stored values to 32-bit integers
+    AMPR_TARGET_AVX2 inline __m256i load8(const uint8_t* p)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+    AMPR_TARGET_AVX2 inline __m256i load8(const int8_t* p)
+    {
+        return _mm256_cvtepi8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+    AMPR_TARGET_AVX2 inline __m256i load8(const uint16_t* p)
+    {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    AMPR_TARGET_AVX2 inline __m256i load8(const int16_t* p)
+    {
+        return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    template <typename T>
+    AMPR_TARGET_SSE41 void convertSSE41(const T* source, size_t count, const Rescale& rescale,
+                                        float* destination, float& minValue, float& maxValue)
+    {
+        __m128 lo = _mm_set1_ps(minValue);
+        __m128 hi = _mm_set1_ps(maxValue);
+        size_t i = 0;
+
+        if (rescale.enabled) {
+            // Rescale in double precision, exactly like the scalar kernel
+            const __m128d slope = _mm_set1_pd(rescale.slope);
+            const __m128d intercept = _mm_set1_pd(rescale.intercept);
+            for (; i + 4 <= count; i += 4) {
+                const __m128i stored = load4(source + i);
+                const __m128d low = _mm_add_pd(intercept, _mm_mul_pd(slope, _mm_cvtepi32_pd(stored)));
+                const __m128d high = _mm_add_pd(intercept,
+                                                _mm_mul_pd(slope, _mm_cvtepi32_pd(_mm_srli_si128(stored, 8))));
+                const __m128 value = _mm_movelh_ps(_mm_cvtpd_ps(low), _mm_cvtpd_ps(high));
+                _mm_storeu_ps(destination + i, value);
+                lo = _mm_min_ps(lo, value);
+                hi = _mm_max_ps(hi, value);
+            }
+        } else {
+            for (; i + 4 <= count; i += 4) {
+                const __m128 value = _mm_cvtepi32_ps(load4(source + i));
+                _mm_storeu_ps(destination + i, value);
+                lo = _mm_min_ps(lo, value);
+                hi = _mm_max_ps(hi, value);
+            }
+        }
+
+        float lanesLo[4], lanesHi[4];
+        _mm_storeu_ps(lanesLo, lo);
+        _mm_storeu_ps(lanesHi, hi);
+        for (int lane = 0; lane < 4; ++lane) {
+            minValue = std::min(minValue, lanesLo[lane]);
+            maxValue = std::max(maxValue, lanesHi[lane]);
+        }
+
+        convertScalar(source + i, count - i, rescale, destination + i, minValue, maxValue);
+    }
+
+    template <typename T>
+    AMPR_TARGET_AVX2 void convertAVX2(const T* source, size_t count, const Rescale& rescale,
+                                      float* destination, float& minValue, float& maxValue)
+    {
+        __m256 lo = _mm256_set1_ps(minValue);
+        __m256 hi = _mm256_set1_ps(maxValue);
+        size_t i = 0;
+
+        if (rescale.enabled) {
+            // Rescale in double precision, exactly like the scalar kernel
+            const __m256d slope = _mm256_set1_pd(rescale.slope);
+            const __m256d intercept = _mm256_set1_pd(rescale.intercept);
+            for (; i + 8 <= count; i += 8) {
+                const __m256i stored = load8(source + i);
+                const __m256d low = _mm256_add_pd(
+                    intercept, _mm256_mul_pd(slope, _mm256_cvtepi32_pd(_mm256_castsi256_si128(stored))));
+                const __m256d high = _mm256_add_pd(
+                    intercept, _mm256_mul_pd(slope, _mm256_cvtepi32_pd(_mm256_extracti128_si256(stored, 1))));
+                const __m256 value = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)),
+                                                          _mm256_cvtpd_ps(high), 1);
+                _mm256_storeu_ps(destination + i, value);
+                lo = _mm256_min_ps(lo, value);
+                hi = _mm256_max_ps(hi, value);
+            }
+        } else {
+            for (; i + 8 <= count; i += 8) {
+                const __m256 value = _mm256_cvtepi32_ps(load8(source + i));
+                _mm256_storeu_ps(destination + i, value);
+                lo = _mm256_min_ps(lo, value);
+                hi = _mm256_max_ps(hi, value);
+            }
+        }
+
+        float lanesLo[8], lanesHi[8];
+        _mm256_storeu_ps(lanesLo, lo);
+        _mm256_storeu_ps(lanesHi, hi);
+        for (int lane = 0; lane < 8; ++lane) {
+            minValue = std::min(minValue, lanesLo[lane]);
+            maxValue = std::max(maxValue, lanesHi[lane]);
+        }
+
+        convertScalar(source + i, count - i, rescale, destination + i, minValue, maxValue);
+    }
+
+    // Lane-wise integer min/max per stored type
+    AMPR_TARGET_SSE41 inline __m128i minLanes(__m128i a, __m128i b, uint8_t) { return _mm_min_epu8(a, b); }
+    AMPR_TARGET_SSE41 inline __m128i maxLanes(__m128i a, __m128i b, uint8_t) { return _mm_max_epu8(a, b); }
+    AMPR_TARGET_SSE41 inline __m128i minLanes(__m128i a, __m128i b, int8_t) { return _mm_min_epi8(a, b); }
+    AMPR_TARGET_SSE41 inline __m128i maxLanes(__m128i a, __m128i b, int8_t) { return _mm_max_epi8(a, b); }
+    AMPR_TARGET_SSE41 inline __m128i minLanes(__m128i a, __m128i b, uint16_t) { return _mm_min_epu16(a, b); }
+    AMPR_TARGET_SSE41 inline __m128i maxLanes(__m128i a, __m128i b, uint16_t) { return _mm_max_epu16(a, b); }
+    AMPR_TARGET_SSE41 inline __m128i minLanes(__m128i a, __m128i b, int16_t) { return _mm_min_epi16(a, b); }
+    AMPR_TARGET_SSE41 inline __m128i maxLanes(__m128i a, __m128i b, int16_t) { return _mm_max_epi16(a, b); }
+
+    AMPR_TARGET_AVX2 inline __m256i minLanes(__m256i a, __m256i b, uint8_t) { return _mm256_min_epu8(a, b); }
+    AMPR_TARGET_AVX2 inline __m256i maxLanes(__m256i a, __m256i b, uint8_t) { return _mm256_max_epu8(a, b); }
+    AMPR_TARGET_AVX2 inline __m256i minLanes(__m256i a, __m256i b, int8_t) { return _mm256_min_epi8(a, b); }
+    AMPR_TARGET_AVX2 inline __m256i maxLanes(__m256i a, __m256i b, int8_t) { return _mm256_max_epi8(a, b); }
+    AMPR_TARGET_AVX2 inline __m256i minLanes(__m256i a, __m256i b, uint16_t) { return _mm256_min_epu16(a, b); }
+    AMPR_TARGET_AVX2 inline __m256i maxLanes(__m256i a, __m256i b, uint16_t) { return _mm256_max_epu16(a, b); }
+    AMPR_TARGET_AVX2 inline __m256i minLanes(__m256i a, __m256i b, int16_t) { return _mm256_min_epi16(a, b); }
+    AMPR_TARGET_AVX2 inline __m256i maxLanes(__m256i a, __m256i b, int16_t) { return _mm256_max_epi16(a, b); }
+#endif
+
+    template <typename T>
+    void rangeScalar(const T* source, size_t count, int32_t& minValue, int32_t& maxValue)
+    {
+        int32_t lo = minValue;
+        int32_t hi = maxValue;
+        for (size_t i = 0; i < count; ++i) {
+            lo = std::min<int32_t>(lo, source[i]);
+            hi = std::max<int32_t>(hi, source[i]);
+        }
+        minValue = lo;
+        maxValue = hi;
+    }
+
+#if AMPR_HAS_X86_SIMD
+    template <typename T>
+    AMPR_TARGET_SSE41 void rangeSSE41(const T* source, size_t count, int32_t& minValue, int32_t& maxValue)
+    {
+        constexpr size_t lanes = sizeof(__m128i) / sizeof(T);
+        size_t i = 0;
+        if (count >= lanes) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+            __m128i hi = lo;
+            for (i = lanes; i + lanes <= count; i += lanes) {
+                const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+                lo = minLanes(lo, value, T{});
+                hi = maxLanes(hi, value, T{});
+            }
+            T lanesLo[lanes], lanesHi[lanes];
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanesLo), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(lanesHi), hi);
+            rangeScalar(lanesLo, lanes, minValue, maxValue);
+            rangeScalar(lanesHi, lanes, minValue, maxValue);
+        }
+        rangeScalar(source + i, count - i, minValue, maxValue);
+    }
+
+    template <typename T>
+    AMPR_TARGET_AVX2 void rangeAVX2(const T* source, size_t count, int32_t& minValue, int32_t& maxValue)
+    {
+        constexpr size_t lanes = sizeof(__m256i) / sizeof(T);
+        size_t i = 0;
+        if (count >= lanes) {
+            __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source));
+            __m256i hi = lo;
+            for (i = lanes; i + lanes <= count; i += lanes) {
+                const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+                lo = minLanes(lo, value, T{});
+                hi = maxLanes(hi, value, T{});
+            }
+            T lanesLo[lanes], lanesHi[lanes];
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanesLo), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanesHi), hi);
+            rangeScalar(lanesLo, lanes, minValue, maxValue);
+            rangeScalar(lanesHi, lanes, minValue, maxValue);
+        }
+        rangeScalar(source + i, count - i, minValue, maxValue);
+    }
+#endif
+
+    template <typename T>
+    void rangeTyped(const void* source, size_t count, int32_t& minValue, int32_t& maxValue)
+    {
+        const T* typed = static_cast<const T*>(source);
+
+#if AMPR_HAS_X86_SIMD
+        const CpuFeatures::InstructionSet best = CpuFeatures::getBestInstructionSet();
+        if (best == CpuFeatures::InstructionSet::AVX2) {
+            rangeAVX2(typed, count, minValue, maxValue);
+            return;
+        }
+        if (best == CpuFeatures::InstructionSet::SSE41) {
+            rangeSSE41(typed, count, minValue, maxValue);
+            return;
+        }
+#endif
+        rangeScalar(typed, count, minValue, maxValue);
+    }
+
+    /**
+     * @brief Range of source * factor (Scale) or of source, optionally storing the values
+     */
+    template <bool Scale>
+    void floatScalar(const float* source, size_t count, float factor, float* destination,
+                     float& minValue, float& maxValue)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            const float value = Scale ? source[i] * factor : source[i];
+            if constexpr (Scale) {
+                destination[i] = value;
+            }
+            minValue = std::min(minValue, value);
+            maxValue = std::max(maxValue, value);
+        }
+    }
+
+#if AMPR_HAS_X86_SIMD
+    template <bool Scale>
+    AMPR_TARGET_AVX2 void floatAVX2(const float* source, size_t count, float factor, float* destination,
+                                    float& minValue, float& maxValue)
+    {
+        const __m256 scale = _mm256_set1_ps(factor);
+        __m256 lo = _mm256_set1_ps(minValue);
+        __m256 hi = _mm256_set1_ps(maxValue);
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 value = _mm256_loadu_ps(source + i);
+            if constexpr (Scale) {
+                value = _mm256_mul_ps(value, scale);
+                _mm256_storeu_ps(destination + i, value);
+            }
+            // Accumulator second: like std::min/max, a NaN value leaves it unchanged
+            lo = _mm256_min_ps(value, lo);
+            hi = _mm256_max_ps(value, hi);
+        }
+
+        float lanesLo[8], lanesHi[8];
+        _mm256_storeu_ps(lanesLo, lo);
+        _mm256_storeu_ps(lanesHi, hi);
+        for (int lane = 0; lane < 8; ++lane) {
+            minValue = std::min(minValue, lanesLo[lane]);
+            maxValue = std::max(maxValue, lanesHi[lane]);
+        }
+        floatScalar<Scale>(source + i, count - i, factor, destination + (Scale ? i : 0), minValue, maxValue);
+    }
+#endif
+
+    template <bool Scale>
+    void floatTyped(const float* source, size_t count, float factor, float* destination,
+                    float& minValue, float& maxValue)
+    {
+#if AMPR_HAS_X86_SIMD
+        if (CpuFeatures::getBestInstructionSet() == CpuFeatures::InstructionSet::AVX2) {
+            floatAVX2<Scale>(source, count, factor, destination, minValue, maxValue);
+            return;
+        }
+#endif
+        floatScalar<Scale>(source, count, factor, destination, minValue, maxValue);
+    }
+
+    template <typename T>
+    void convertTyped(const void* source, size_t count, const Rescale& rescale,
+                      float* destination, float& minValue, float& maxValue,
+                      CpuFeatures::InstructionSet instructionSet)
+    {
+        const T* typed = static_cast<const T*>(source);
+
+#if AMPR_HAS_X86_SIMD
+        if (instructionSet == CpuFeatures::InstructionSet::AVX2) {
+            convertAVX2(typed, count, rescale, destination, minValue, maxValue);
+            return;
+        }
+        if (instructionSet == CpuFeatures::InstructionSet::SSE41) {
+            convertSSE41(typed, count, rescale, destination, minValue, maxValue);
+            return;
+        }
+#else
+        (void)instructionSet;
+#endif
+        convertScalar(typed, count, rescale, destination, minValue, maxValue);
+    }
+}
+
+bool PixelConversion::getStoredType(int bitsAllocated, int pixelRepresentation, StoredType& type)
+{
+    if (bitsAllocated == 16) {
+        type = pixelRepresentation == 0 ? StoredType::UInt16 : StoredType::Int16;
+        return true;
+    }
+    if (bitsAllocated == 8) {
+        type = pixelRepresentation == 0 ? StoredType::UInt8 : StoredType::Int8;
+        return true;
+    }
+    return false;
+}
+
+PixelConversion::StoredType PixelConversion::getStoredType(Volume3D::VoxelType voxelType)
+{
+    switch (voxelType) {
+    case Volume3D::VoxelType::Int16:
+        return StoredType::Int16;
+    case Volume3D::VoxelType::UInt16:
+        return StoredType::UInt16;
+    default:
+        return StoredType::UInt8;
+    }
+}
+
+size_t PixelConversion::getStoredSize(StoredType type)
+{
+    return (type == StoredType::UInt16 || type == StoredType::Int16) ? 2 : 1;
+}
+
+void PixelConversion::convertToFloat(const void* source, StoredType type, size_t count, const Rescale& rescale,
+                                     float* destination, float& minValue, float& maxValue)
+{
+    convertToFloat(source, type, count, rescale, destination, minValue, maxValue,
+                   CpuFeatures::getBestInstructionSet());
+}
+
+void PixelConversion::convertToFloat(const void* source, StoredType type, size_t count, const Rescale& rescale,
+                                     float* destination, float& minValue, float& maxValue,
+                                     CpuFeatures::InstructionSet instructionSet)
+{
+    instructionSet = std::min(instructionSet, CpuFeatures::getBestInstructionSet());
+
+    switch (type) {
+    case StoredType::UInt8:
+        convertTyped<uint8_t>(source, count, rescale, destination, minValue, maxValue, instructionSet);
+        break;
+    case StoredType::Int8:
+        convertTyped<int8_t>(source, count, rescale, destination, minValue, maxValue, instructionSet);
+        break;
+    case StoredType::UInt16:
+        convertTyped<uint16_t>(source, count, rescale, destination, minValue, maxValue, instructionSet);
+        break;
+    case StoredType::Int16:
+        convertTyped<int16_t>(source, count, rescale, destination, minValue, maxValue, instructionSet);
+        break;
+    }
+}
+
+void PixelConversion::findStoredRange(const void* source, StoredType type, size_t count,
+                                      int32_t& minValue, int32_t& maxValue)
+{
+    switch (type) {
+    case StoredType::UInt8:
+        rangeTyped<uint8_t>(source, count, minValue, maxValue);
+        break;
+    case StoredType::Int8:
+        rangeTyped<int8_t>(source, count, minValue, maxValue);
+        break;
+    case StoredType::UInt16:
+        rangeTyped<uint16_t>(source, count, minValue, maxValue);
+        break;
+    case StoredType::Int16:
+        rangeTyped<int16_t>(source, count, minValue, maxValue);
+        break;
+    }
+}
+
+void PixelConversion::findFloatRange(const float* source, size_t count, float& minValue, float& maxValue)
+{
+    floatTyped<false>(source, count, 1.0f, nullptr, minValue, maxValue);
+}
+
+void PixelConversion::scaleFloat(const float* source, size_t count, float factor, float* destination,
+                                 float& minValue, float& maxValue)
+{
+    floatTyped<true>(source, count, factor, destination, minValue, maxValue);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "CpuFeatures.h"
+#include "Volume3D.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Stored-pixel to float32 conversion kernels
+ *
+ * Converts 8/16-bit stored DICOM values to float, applies the modality rescale
+ * and tracks the output min/max in a single pass, or finds the range of stored
+ * values for volumes kept in their native type. Float32 volumes get the same
+ * single-pass range (and scale) kernel. AVX2 and SSE4.1 kernels are
+ * selected at runtime with a scalar fallback. The rescale is evaluated as
+ * float(intercept + slope * double(value)) in every kernel, so all kernels
+ * produce bit-identical output.
+ */
+class PixelConversion
+{
+public:
+    /**
+     * @brief Stored pixel type (Bits Allocated + Pixel Representation)
+     */
+    enum class StoredType
+    {
+        UInt8,
+        Int8,
+        UInt16,
+        Int16
+    };
+
+    /**
+     * @brief Modality rescale (Rescale Slope / Rescale Intercept)
+     */
+    struct Rescale
+    {
+        bool enabled{false};
+        double slope{1.0};
+        double intercept{0.0};
+    };
+
+    /**
+     * @brief Map DICOM pixel format to a stored type
+     * @param bitsAllocated Bits Allocated (0028,0100)
+     * @param pixelRepresentation Pixel Representation (0028,0103), 0 = unsigned
+     * @param type Output stored type
+     * @return false if the format is not supported
+     */
+    static bool getStoredType(int bitsAllocated, int pixelRepresentation, StoredType& type);
+
+    /**
+     * @brief Stored type of a native-storage volume (voxelType must not be Float32)
+     */
+    static StoredType getStoredType(Volume3D::VoxelType voxelType);
+
+    /**
+     * @brief Size of one stored value in bytes
+     */
+    static size_t getStoredSize(StoredType type);
+
+    /**
+     * @brief Convert stored values to float using the best available kernel
+     * @param source Stored values
+     * @param type Stored type of source
+     * @param count Number of values
+     * @param rescale Rescale to apply
+     * @param destination Output float values (may not alias source)
+     * @param minValue In: running minimum, out: combined with the converted values
+     * @param maxValue In: running maximum, out: combined with the converted values
+     */
+    static void convertToFloat(const void* source, StoredType type, size_t count, const Rescale& rescale,
+                               float* destination, float& minValue, float& maxValue);
+
+    /**
+     * @brief Same as above with an explicit kernel (clamped to what the CPU supports)
+     */
+    static void convertToFloat(const void* source, StoredType type, size_t count, const Rescale& rescale,
+                               float* destination, float& minValue, float& maxValue,
+                               CpuFeatures::InstructionSet instructionSet);
+
+    /**
+     * @brief Min/max of stored values without converting them
+     * @param source Stored values
+     * @param type Stored type of source
+     * @param count Number of values
+     * @param minValue In: running minimum, out: combined with source
+     * @param maxValue In: running maximum, out: combined with source
+     */
+    static void findStoredRange(const void* source, StoredType type, size_t count,
+                                int32_t& minValue, int32_t& maxValue);
+
+    /**
+     * @brief Min/max of float values
+     * @param minValue In: running minimum, out: combined with source
+     * @param maxValue In: running maximum, out: combined with source
+     */
+    static void findFloatRange(const float* source, size_t count, float& minValue, float& maxValue);
+
+    /**
+     * @brief destination = source * factor, tracking the output min/max like convertToFloat
+     * @param destination Output values (may be source)
+     */
+    static void scaleFloat(const float* source, size_t count, float factor, float* destination,
+                           float& minValue, float& maxValue);
+};
@@ -0,0 +1,403 @@
+#include "ROIStatistics.h"
+#include "PixelConversion.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+ROIStatistics::ROIStatistics(std::shared_ptr<const Volume3D> volume, std::vector<double> sliceFactors)
+    : m_volume(std::move(volume))
+    , m_sliceFactors(std::move(sliceFactors))
+{
+    if (m_volume) {
+        m_tableBytes = 2 * sizeof(double) * static_cast<size_t>(std::max(m_volume->width + 1, 0)) *
+                       static_cast<size_t>(std::max(m_volume->height + 1, 0));
+    }
+}
+
+bool ROIStatistics::isValid() const
+{
+    return m_volume && m_volume->isValid() &&
+           (m_sliceFactors.empty() || m_sliceFactors.size() == static_cast<size_t>(m_volume->depth));
+}
+
+ROIStatistics::Stats ROIStatistics::rectangle(int z, int x0, int y0, int x1, int y1)
+{
+    return box(x0, y0, z, x1, y1, z);
+}
+
+ROIStatistics::Stats ROIStatistics::ellipse(int z, double centerX, double centerY, double radiusX, double radiusY)
+{
+    if (!isValid() || z < 0 || z >= m_volume->depth || !(radiusX > 0.0) || !(radiusY > 0.0)) {
+        return Stats{};
+    }
+
+    std::vector<Span> spans;
+    ellipseSpans(centerX, centerY, radiusX, radiusY, 0.0, spans);
+
+    Stats stats;
+    double m2 = 0.0;
+    addPartial(z, measureSpans(z, spans, false, true), stats, m2);
+    return finish(stats, m2, true);
+}
+
+ROIStatistics::Stats ROIStatistics::box(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+    if (!isValid()) {
+        return Stats{};
+    }
+
+    // Normalize and clip the corners
+    const auto clip = [](int& a, int& b, int size) {
+        if (a > b) {
+            std::swap(a, b);
+        }
+        a = std::max(a, 0);
+        b = std::min(b, size - 1);
+        return a <= b;
+    };
+    if (!clip(x0, x1, m_volume->width) || !clip(y0, y1, m_volume->height) || !clip(z0, z1, m_volume->depth)) {
+        return Stats{};
+    }
+
+    std::vector<Span> spans;
+    spans.reserve(static_cast<size_t>(y1 - y0 + 1));
+    for (int y = y0; y <= y1; ++y) {
+        spans.push_back(Span{y, x0, x1});
+    }
+
+    Stats stats;
+    double m2 = 0.0;
+    const bool buildTables = static_cast<size_t>(z1 - z0 + 1) <= getCacheCapacity();
+    for (int z = z0; z <= z1; ++z) {
+        addPartial(z, measureSpans(z, spans, true, buildTables), stats, m2);
+    }
+    return finish(stats, m2, z0 == z1);
+}
+
+ROIStatistics::Stats ROIStatistics::ellipsoid(double centerX, double centerY, double centerZ,
+                                              double radiusX, double radiusY, double radiusZ)
+{
+    if (!isValid() || !(radiusX > 0.0) || !(radiusY > 0.0) || !(radiusZ > 0.0)) {
+        return Stats{};
+    }
+
+    const int zBegin = std::max(static_cast<int>(std::floor(centerZ - radiusZ)), 0);
+    const int zEnd = std::min(static_cast<int>(std::ceil(centerZ + radiusZ)), m_volume->depth - 1);
+
+    Stats stats;
+    double m2 = 0.0;
+    std::vector<Span> spans;
+    const bool buildTables = zEnd < zBegin || static_cast<size_t>(zEnd - zBegin + 1) <= getCacheCapacity();
+    for (int z = zBegin; z <= zEnd; ++z) {
+        const double dz = (z - centerZ) / radiusZ;
+        ellipseSpans(centerX, centerY, radiusX, radiusY, dz * dz, spans);
+        if (!spans.empty()) {
+            addPartial(z, measureSpans(z, spans, false, buildTables), stats, m2);
+        }
+    }
+    return finish(stats, m2, false);
+}
+
+ROIStatistics::Stats ROIStatistics::sphere(double centerX, double centerY, double centerZ, double radiusMm)
+{
+    if (!isValid()) {
+        return Stats{};
+    }
+    return ellipsoid(centerX, centerY, centerZ, radiusMm / m_volume->spacing[0], radiusMm / m_volume->spacing[1],
+                     radiusMm / m_volume->spacing[2]);
+}
+
+void ROIStatistics::ellipseSpans(double centerX, double centerY, double radiusX, double radiusY, double dz2,
+                                 std::vector<Span>& spans) const
+{
+    spans.clear();
+    if (!(dz2 <= 1.0)) {
+        return;
+    }
+
+    // The inclusion test is the only authority; the sqrt estimate of each
+    // span's ends is corrected against it so rounding cannot move a voxel in or out
+    const auto inside = [&](int x, double dy2) {
+        const double dx = (x - centerX) / radiusX;
+        return dx * dx + dy2 + dz2 <= 1.0;
+    };
+
+    const int yBegin = std::max(static_cast<int>(std::floor(centerY - radiusY)), 0);
+    const int yEnd = std::min(static_cast<int>(std::ceil(centerY + radiusY)), m_volume->height - 1);
+    for (int y = yBegin; y <= yEnd; ++y) {
+        const double dy = (y - centerY) / radiusY;
+        const double dy2 = dy * dy;
+        const double remaining = 1.0 - dy2 - dz2;
+        if (remaining < 0.0) {
+            continue;
+        }
+        const double half = radiusX * std::sqrt(remaining);
+        int x0 = static_cast<int>(std::ceil(centerX - half));
+        int x1 = static_cast<int>(std::floor(centerX + half));
+        while (x0 <= x1 && !inside(x0, dy2)) {
+            ++x0;
+        }
+        while (inside(x0 - 1, dy2)) {
+            --x0;
+        }
+        while (x1 >= x0 && !inside(x1, dy2)) {
+            --x1;
+        }
+        while (x1 >= x0 && inside(x1 + 1, dy2)) {
+            ++x1;
+        }
+
+        x0 = std::max(x0, 0);
+        x1 = std::min(x1, m_volume->width - 1);
+        if (x0 <= x1) {
+            spans.push_back(Span{y, x0, x1});
+        }
+    }
+}
+
+ROIStatistics::SlicePartial ROIStatistics::measureSpans(int z, const std::vector<Span>& spans, bool rectangle,
+                                                        bool buildTable)
+{
+    SlicePartial partial;
+    if (spans.empty()) {
+        return partial;
+    }
+
+    const std::shared_ptr<const SliceTable> table = getTable(z, buildTable);
+    const size_t sliceOffset = static_cast<size_t>(z) * m_volume->width * m_volume->height;
+    const size_t stride = static_cast<size_t>(m_volume->width) + 1;
+    const auto area = [&](const std::vector<double>& sat, int y0, int x0, int y1, int x1) {
+        // Inclusive [x0, x1] x [y0, y1]
+        const size_t top = static_cast<size_t>(y0) * stride;
+        const size_t bottom = static_cast<size_t>(y1 + 1) * stride;
+        return sat[bottom + x1 + 1] - sat[top + x1 + 1] - sat[bottom + x0] + sat[top + x0];
+    };
+
+    if (!table) {
+        // Not cached and not worth building: sum the covered voxels directly
+        m_volume->visitVoxels([&](const auto& view) {
+            for (const Span& span : spans) {
+                const auto* row = view.data + sliceOffset + static_cast<size_t>(span.y) * m_volume->width;
+                for (int x = span.x0; x <= span.x1; ++x) {
+                    const double value = static_cast<double>(row[x]);
+                    partial.sum += value;
+                    partial.sumSq += value * value;
+                }
+                partial.count += static_cast<size_t>(span.x1 - span.x0 + 1);
+            }
+        });
+    } else if (rectangle) {
+        const Span& first = spans.front();
+        const int lastRow = spans.back().y;
+        partial.count = static_cast<size_t>(lastRow - first.y + 1) * static_cast<size_t>(first.x1 - first.x0 + 1);
+        partial.sum = area(table->sum, first.y, first.x0, lastRow, first.x1);
+        partial.sumSq = area(table->sumSq, first.y, first.x0, lastRow, first.x1);
+    } else {
+        for (const Span& span : spans) {
+            partial.count += static_cast<size_t>(span.x1 - span.x0 + 1);
+            partial.sum += area(table->sum, span.y, span.x0, span.y, span.x1);
+            partial.sumSq += area(table->sumSq, span.y, span.x0, span.y, span.x1);
+        }
+    }
+
+    // Range: one SIMD pass per span over the voxels themselves
+    if (m_volume->voxelType == Volume3D::VoxelType::Float32) {
+        float minValue = std::numeric_limits<float>::max();
+        float maxValue = std::numeric_limits<float>::lowest();
+        for (const Span& span : spans) {
+            const float* row = m_volume->voxels.data() + sliceOffset + static_cast<size_t>(span.y) * m_volume->width;
+            PixelConversion::findFloatRange(row + span.x0, static_cast<size_t>(span.x1 - span.x0 + 1),
+                                            minValue, maxValue);
+        }
+        partial.rawMin = minValue;
+        partial.rawMax = maxValue;
+    } else {
+        const PixelConversion::StoredType type = PixelConversion::getStoredType(m_volume->voxelType);
+        const size_t voxelSize = Volume3D::getVoxelTypeSize(m_volume->voxelType);
+        const char* base = static_cast<const char*>(m_volume->storedVoxels.get());
+        int32_t minValue = std::numeric_limits<int32_t>::max();
+        int32_t maxValue = std::numeric_limits<int32_t>::min();
+        for (const Span& span : spans) {
+            const size_t first = sliceOffset + static_cast<size_t>(span.y) * m_volume->width + span.x0;
+            PixelConversion::findStoredRange(base + first * voxelSize, type, static_cast<size_t>(span.x1 - span.x0 + 1),
+                                             minValue, maxValue);
+        }
+        partial.rawMin = minValue;
+        partial.rawMax = maxValue;
+    }
+    return partial;
+}
+
+void ROIStatistics::addPartial(int z, const SlicePartial& partial, Stats& stats, double& m2) const
+{
+    if (partial.count == 0) {
+        return;
+    }
+
+    // value = a + b * raw, with the slice factor folded in
+    const double factor = m_sliceFactors.empty() ? 1.0 : m_sliceFactors[z];
+    const bool native = m_volume->voxelType != Volume3D::VoxelType::Float32;
+    const double a = native ? m_volume->storedIntercept * factor : 0.0;
+    const double b = native ? m_volume->storedSlope * factor : factor;
+
+    // Same per-voxel expressions as VoxelView::valueAt and SUVCalculator::View::getSUV
+    const auto toValue = [&](double raw) {
+        return native ? static_cast<float>(a + b * raw) : static_cast<float>(raw) * static_cast<float>(factor);
+    };
+    const float low = std::min(toValue(partial.rawMin), toValue(partial.rawMax));
+    const float high = std::max(toValue(partial.rawMin), toValue(partial.rawMax));
+
+    // Slice mean and squared deviations from the raw sums, merged pairwise (Chan et al.)
+    const double n = static_cast<double>(partial.count);
+    const double sliceMean = a + b * (partial.sum / n);
+    const double sliceM2 = b * b * std::max(0.0, partial.sumSq - partial.sum * partial.sum / n);
+
+    if (stats.count == 0) {
+        stats.min = low;
+        stats.max = high;
+        stats.mean = sliceMean;
+        m2 = sliceM2;
+    } else {
+        stats.min = std::min(stats.min, low);
+        stats.max = std::max(stats.max, high);
+        const double total = static_cast<double>(stats.count) + n;
+        const double delta = sliceMean - stats.mean;
+        stats.mean += delta * n / total;
+        m2 += sliceM2 + delta * delta * static_cast<double>(stats.count) * n / total;
+    }
+    stats.count += partial.count;
+    stats.sum += a * n + b * partial.sum;
+}
+
+ROIStatistics::Stats ROIStatistics::finish(Stats stats, double m2, bool planar) const
+{
+    if (stats.count == 0) {
+        return Stats{};
+    }
+    const double n = static_cast<double>(stats.count);
+    stats.mean = stats.sum / n;
+    stats.stdDev = std::sqrt(std::max(0.0, m2 / n));
+    const double pixelArea = m_volume->spacing[0] * m_volume->spacing[1];
+    stats.areaMm2 = planar ? n * pixelArea : 0.0;
+    stats.volumeMm3 = n * pixelArea * m_volume->spacing[2];
+    return stats;
+}
+
+std::shared_ptr<const ROIStatistics::SliceTable> ROIStatistics::buildTable(int z) const
+{
+    const int width = m_volume->width;
+    const int height = m_volume->height;
+    const size_t stride = static_cast<size_t>(width) + 1;
+
+    auto table = std::make_shared<SliceTable>();
+    table->sum.assign(stride * (static_cast<size_t>(height) + 1), 0.0);
+    table->sumSq.assign(table->sum.size(), 0.0);
+
+    m_volume->visitVoxels([&](const auto& view) {
+        const auto* slice = view.data + static_cast<size_t>(z) * width * height;
+        for (int y = 0; y < height; ++y) {
+            const auto* row = slice + static_cast<size_t>(y) * width;
+            const double* above = table->sum.data() + static_cast<size_t>(y) * stride;
+            const double* aboveSq = table->sumSq.data() + static_cast<size_t>(y) * stride;
+            double* current = table->sum.data() + static_cast<size_t>(y + 1) * stride;
+            double* currentSq = table->sumSq.data() + static_cast<size_t>(y + 1) * stride;
+
+            // Integers stay exact: every partial sum is far below 2^53
+            double rowSum = 0.0;
+            double rowSumSq = 0.0;
+            for (int x = 0; x < width; ++x) {
+                const double value = static_cast<double>(row[x]);
+                rowSum += value;
+                rowSumSq += value * value;
+                current[x + 1] = above[x + 1] + rowSum;
+                currentSq[x + 1] = aboveSq[x + 1] + rowSumSq;
+            }
+        }
+    });
+    return table;
+}
+
+std::shared_ptr<const ROIStatistics::SliceTable> ROIStatistics::getTable(int z, bool build)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_tables.find(z);
+        if (it != m_tables.end()) {
+            it->second.lastUse = ++m_useClock;
+            return it->second.table;
+        }
+    }
+    if (!build) {
+        return nullptr;
+    }
+
+    // Build outside the lock; a concurrent build of the same slice just loses the race
+    std::shared_ptr<const SliceTable> table = buildTable(z);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_tables.find(z);
+    if (it != m_tables.end()) {
+        it->second.lastUse = ++m_useClock;
+        return it->second.table;
+    }
+    insertLocked(z, table);
+    return table;
+}
+
+void ROIStatistics::insertLocked(int z, std::shared_ptr<const SliceTable> table)
+{
+    // Make room first, always keeping the new table
+    while (!m_tables.empty() && (m_tables.size() + 1) * m_tableBytes > m_budget) {
+        auto oldest = std::min_element(m_tables.begin(), m_tables.end(), [](const auto& a, const auto& b) {
+            return a.second.lastUse < b.second.lastUse;
+        });
+        m_tables.erase(oldest);
+    }
+    m_tables[z] = CacheEntry{std::move(table), ++m_useClock};
+}
+
+void ROIStatistics::prepareSlices(int zBegin, int zEnd, ThreadPool* pool)
+{
+    if (!isValid()) {
+        return;
+    }
+    zBegin = std::max(zBegin, 0);
+    zEnd = std::min(zEnd, m_volume->depth);
+    if (zBegin >= zEnd) {
+        return;
+    }
+
+    // No point building more than the cache keeps
+    const size_t count = std::min(static_cast<size_t>(zEnd - zBegin), getCacheCapacity());
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    threads.parallelFor(count, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            getTable(zBegin + static_cast<int>(i), true);
+        }
+    });
+}
+
+size_t ROIStatistics::getCacheCapacity() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return std::max<size_t>(1, m_tableBytes > 0 ? m_budget / m_tableBytes : 1);
+}
+
+void ROIStatistics::setCacheBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = bytes;
+    while (m_tables.size() > 1 && m_tables.size() * m_tableBytes > m_budget) {
+        auto oldest = std::min_element(m_tables.begin(), m_tables.end(), [](const auto& a, const auto& b) {
+            return a.second.lastUse < b.second.lastUse;
+        });
+        m_tables.erase(oldest);
+    }
+}
+
+size_t ROIStatistics::getMemoryUsage() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tables.size() * m_tableBytes;
+}
@@ -0,0 +1,187 @@
+#pragma once
+
+#include "Volume3D.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Min/max/mean/std of rectangle, ellipse, box and ellipsoid ROIs
+ *
+ * Meant to be queried on every mouse move while an ROI is dragged. Each
+ * queried axial slice gets a summed-area table of values and squared values
+ * ((width + 1) x (height + 1) doubles each), built on first use and kept in a
+ * small LRU cache, so:
+ * - a rectangle's sum and sum of squares take four lookups per slice;
+ * - an ellipse is evaluated as one span per row, each span four lookups;
+ * - boxes and ellipsoids add up their slices' rectangles and ellipses.
+ * A box or ellipsoid covering more slices than the cache holds would evict
+ * its own tables on every query, so slices it finds uncached are summed
+ * directly over the covered spans instead of getting a table.
+ * Min and max are not decomposable; they come from one SIMD range pass over
+ * the covered spans, which stays in the microseconds for typical ROIs.
+ *
+ * Native storage sums stored integers, which doubles hold exactly for any
+ * slice up to 1024 x 1024; the rescale (and the optional per-slice factor,
+ * e.g. SUV) is applied to the exact sums afterwards, so mean and standard
+ * deviation differ from a brute-force pass only by that pass's own rounding.
+ * Float32 sums agree to double rounding. Min and max are exact.
+ *
+ * A voxel belongs to an ellipse or ellipsoid when its center is inside:
+ * ((x - cx) / rx)^2 + ((y - cy) / ry)^2 [+ ((z - cz) / rz)^2] <= 1.
+ * The standard deviation is the population one (divided by the count).
+ *
+ * All methods are thread-safe.
+ */
+class ROIStatistics
+{
+public:
+    /**
+     * @brief Result of one query (all zero for an empty ROI)
+     */
+    struct Stats
+    {
+        size_t count{0};        // Voxels inside
+        float min{0.0f};
+        float max{0.0f};
+        double mean{0.0};
+        double stdDev{0.0};
+        double sum{0.0};
+        double areaMm2{0.0};    // count * in-plane voxel area (planar ROIs)
+        double volumeMm3{0.0};  // count * voxel volume
+    };
+
+    /**
+     * @brief Statistics engine over a volume
+     * @param volume Volume to measure (kept alive by the engine)
+     * @param sliceFactors Optional factor per slice applied to the values
+     *                     (e.g. SUVCalculator::View::sliceFactors; empty = 1)
+     */
+    explicit ROIStatistics(std::shared_ptr<const Volume3D> volume,
+                           std::vector<double> sliceFactors = std::vector<double>());
+
+    bool isValid() const;
+
+    /**
+     * @brief Axis-aligned rectangle on slice z
+     *
+     * Corners are inclusive voxel indices in any order, clipped to the slice.
+     */
+    Stats rectangle(int z, int x0, int y0, int x1, int y1);
+
+    /**
+     * @brief Ellipse on slice z, center and radii in voxels
+     */
+    Stats ellipse(int z, double centerX, double centerY, double radiusX, double radiusY);
+
+    /**
+     * @brief Box of whole voxels, inclusive corners in any order
+     */
+    Stats box(int x0, int y0, int z0, int x1, int y1, int z1);
+
+    /**
+     * @brief Ellipsoid, center and radii in voxels
+     */
+    Stats ellipsoid(double centerX, double centerY, double centerZ, double radiusX, double radiusY, double radiusZ);
+
+    /**
+     * @brief Sphere with a radius in mm; anisotropic spacing makes it an ellipsoid in voxels
+     */
+    Stats sphere(double centerX, double centerY, double centerZ, double radiusMm);
+
+    /**
+     * @brief Build the tables of slices [zBegin, zEnd) ahead of time across the pool
+     *
+     * Only as many as fit the cache budget are kept.
+     */
+    void prepareSlices(int zBegin, int zEnd, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Bytes the table cache may hold (default 128 MiB, at least one slice is always kept)
+     */
+    void setCacheBudget(size_t bytes);
+
+    size_t getMemoryUsage() const;
+
+private:
+    /**
+     * @brief Summed-area tables of one slice, in stored (or float) units
+     */
+    struct SliceTable
+    {
+        std::vector<double> sum;    // sum[(y + 1) * (width + 1) + x + 1] = sum over [0, x] x [0, y]
+        std::vector<double> sumSq;
+    };
+
+    /**
+     * @brief Sums over one slice's part of the ROI, before the rescale
+     */
+    struct SlicePartial
+    {
+        size_t count{0};
+        double sum{0.0};
+        double sumSq{0.0};
+        double rawMin{0.0};
+        double rawMax{0.0};
+    };
+
+    /**
+     * @brief Row spans covered on one slice (x1 < x0 = empty row)
+     */
+    struct Span
+    {
+        int y;
+        int x0;
+        int x1;
+    };
+
+    /**
+     * @brief Cached table of slice z, built on a miss when build is set (nullptr otherwise)
+     */
+    std::shared_ptr<const SliceTable> getTable(int z, bool build);
+    std::shared_ptr<const SliceTable> buildTable(int z) const;
+    void insertLocked(int z, std::shared_ptr<const SliceTable> table);
+
+    /**
+     * @brief Number of slice tables the budget holds (at least one)
+     */
+    size_t getCacheCapacity() const;
+
+    /**
+     * @brief Sums and raw range over spans of slice z
+     * @param rectangle Spans are consecutive rows with the same columns (sums from one table lookup)
+     * @param buildTable Build the slice's table on a cache miss; otherwise sum the spans directly
+     */
+    SlicePartial measureSpans(int z, const std::vector<Span>& spans, bool rectangle, bool buildTable);
+
+    /**
+     * @brief Fold a slice's partial into the totals in value units (m2 = sum of squared deviations)
+     */
+    void addPartial(int z, const SlicePartial& partial, Stats& stats, double& m2) const;
+    Stats finish(Stats stats, double m2, bool planar) const;
+
+    /**
+     * @brief Spans of the voxels with ((x - cx) / rx)^2 + ((y - cy) / ry)^2 + dz2 <= 1 on one slice
+     */
+    void ellipseSpans(double centerX, double centerY, double radiusX, double radiusY, double dz2,
+                      std::vector<Span>& spans) const;
+
+    std::shared_ptr<const Volume3D> m_volume;
+    std::vector<double> m_sliceFactors;
+    size_t m_tableBytes{0};  // Per slice
+
+    mutable std::mutex m_mutex;
+    struct CacheEntry
+    {
+        std::shared_ptr<const SliceTable> table;
+        uint64_t lastUse{0};
+    };
+    std::unordered_map<int, CacheEntry> m_tables;
+    uint64_t m_useClock{0};
+    size_t m_budget{size_t(128) << 20};
+};
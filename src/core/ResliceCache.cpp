@@ -0,0 +1,310 @@
+#include "ResliceCache.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+
+namespace {
+    /**
+     * @brief Same view: everything but the plane index matches
+     */
+    bool isSameView(const ResliceCache::Key& a, const ResliceCache::Key& b)
+    {
+        return a.volumeId == b.volumeId && a.orientation == b.orientation && a.level == b.level &&
+               a.mode == b.mode && a.thickness == b.thickness;
+    }
+
+    // Scroll states kept; one per open view is plenty
+    constexpr size_t kMaxScrollStates = 16;
+}
+
+bool ResliceCache::Key::operator==(const Key& other) const
+{
+    return isSameView(*this, other) && index == other.index;
+}
+
+size_t ResliceCache::KeyHash::operator()(const Key& key) const
+{
+    uint32_t thicknessBits;
+    std::memcpy(&thicknessBits, &key.thickness, sizeof(thicknessBits));
+    size_t hash = std::hash<uint64_t>()(key.volumeId);
+    auto combine = [&hash](size_t value) {
+        hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    };
+    combine(static_cast<size_t>(key.orientation));
+    combine(static_cast<size_t>(key.index));
+    combine(static_cast<size_t>(key.level));
+    combine(static_cast<size_t>(key.mode));
+    combine(thicknessBits);
+    return hash;
+}
+
+ResliceCache::ResliceCache(size_t maxBytes, int prefetchDepth)
+    : m_maxBytes(maxBytes)
+    , m_prefetchDepth(std::max(0, prefetchDepth))
+{
+    m_prefetchThread = std::thread(&ResliceCache::prefetchLoop, this);
+}
+
+ResliceCache::~ResliceCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_prefetchWake.notify_all();
+    m_prefetchThread.join();
+}
+
+uint64_t ResliceCache::addVolume(std::shared_ptr<const Volume3D> volume, std::shared_ptr<const VolumePyramid> pyramid)
+{
+    if (!volume) {
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const uint64_t id = m_nextVolumeId++;
+    m_sources[id] = Source{std::move(volume), std::move(pyramid)};
+    return id;
+}
+
+void ResliceCache::removeVolume(uint64_t volumeId)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_sources.erase(volumeId);
+
+    for (auto it = m_lru.begin(); it != m_lru.end();) {
+        if (it->key.volumeId == volumeId) {
+            m_entries.erase(it->key);
+            m_bytes -= it->bytes;
+            it = m_lru.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    auto sameVolume = [volumeId](const Key& key) { return key.volumeId == volumeId; };
+    m_prefetchQueue.erase(std::remove_if(m_prefetchQueue.begin(), m_prefetchQueue.end(), sameVolume),
+                          m_prefetchQueue.end());
+    m_scroll.erase(std::remove_if(m_scroll.begin(), m_scroll.end(),
+                                  [&](const ScrollState& state) { return sameVolume(state.last); }),
+                   m_scroll.end());
+}
+
+std::shared_ptr<const SliceImage> ResliceCache::get(const Key& key, ThreadPool* pool)
+{
+    Source source;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        const auto found = m_sources.find(key.volumeId);
+        if (found == m_sources.end()) {
+            return nullptr;
+        }
+        source = found->second;
+        if (key.index < 0 || key.index >= MPRReslicer::getSliceCount(*source.volume, key.orientation)) {
+            return nullptr;
+        }
+
+        schedulePrefetchLocked(key, source);
+
+        while (true) {
+            const auto entry = m_entries.find(key);
+            if (entry != m_entries.end()) {
+                m_lru.splice(m_lru.begin(), m_lru, entry->second);
+                ++m_stats.hits;
+                if (entry->second->prefetched) {
+                    entry->second->prefetched = false;
+                    ++m_stats.prefetchHits;
+                }
+                return entry->second->image;
+            }
+            // The prefetcher is already on this plane: waiting is cheaper than rendering it twice
+            if (!m_prefetchBusy || !(m_prefetchKey == key)) {
+                break;
+            }
+            m_renderFinished.wait(lock);
+        }
+        ++m_stats.misses;
+    }
+
+    std::shared_ptr<SliceImage> image;
+    {
+        std::lock_guard<std::mutex> renderLock(m_renderMutex);
+        ThreadPool& threads = pool ? *pool : ThreadPool::global();
+        image = render(source, key, m_slabRenderers[static_cast<int>(key.orientation)], threads);
+    }
+    if (!image) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_sources.count(key.volumeId)) {
+        insertLocked(key, image, false);
+    }
+    return image;
+}
+
+void ResliceCache::setMaxBytes(size_t maxBytes)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxBytes = maxBytes;
+    evictLocked();
+}
+
+void ResliceCache::setPrefetchDepth(int prefetchDepth)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_prefetchDepth = std::max(0, prefetchDepth);
+    if (m_prefetchQueue.size() > static_cast<size_t>(m_prefetchDepth)) {
+        m_prefetchQueue.resize(m_prefetchDepth);
+    }
+}
+
+ResliceCache::Stats ResliceCache::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats = m_stats;
+    stats.entries = m_entries.size();
+    stats.bytes = m_bytes;
+    return stats;
+}
+
+void ResliceCache::resetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats = Stats();
+}
+
+void ResliceCache::clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_lru.clear();
+    m_entries.clear();
+    m_bytes = 0;
+    m_prefetchQueue.clear();
+}
+
+std::shared_ptr<SliceImage> ResliceCache::render(const Source& source, const Key& key, SlabRenderer& slabRenderer,
+                                                 ThreadPool& pool)
+{
+    // Without a pyramid only level 0 exists, and plane indices stay level-0 indices
+    const int level = source.pyramid ? std::clamp(key.level, 0, source.pyramid->getLevelCount() - 1) : 0;
+    const Volume3D& volume = source.pyramid ? source.pyramid->getLevel(*source.volume, level) : *source.volume;
+    const int index = std::min(VolumePyramid::toLevelIndex(key.index, level),
+                               MPRReslicer::getSliceCount(volume, key.orientation) - 1);
+
+    auto image = std::make_shared<SliceImage>();
+    bool ok;
+    if (SlabRenderer::getSlabPlaneCount(volume, key.orientation, key.thickness) > 1) {
+        // No visible range: culled slabs would depend on the window
+        slabRenderer.clearVisibleRange();
+        ok = slabRenderer.render(volume, key.orientation, index, key.thickness, key.mode, *image, &pool);
+    } else {
+        ok = MPRReslicer::extractSlice(volume, key.orientation, index, *image, &pool);
+    }
+    return ok ? image : nullptr;
+}
+
+void ResliceCache::insertLocked(const Key& key, std::shared_ptr<const SliceImage> image, bool prefetched)
+{
+    if (m_entries.count(key)) {
+        return;  // Rendered by both the caller and the prefetcher; keep the first
+    }
+    Entry entry;
+    entry.key = key;
+    entry.bytes = sizeof(SliceImage) + image->pixels.capacity() * sizeof(float);
+    entry.image = std::move(image);
+    entry.prefetched = prefetched;
+
+    m_bytes += entry.bytes;
+    m_lru.push_front(std::move(entry));
+    m_entries[key] = m_lru.begin();
+    evictLocked();
+}
+
+void ResliceCache::evictLocked()
+{
+    while (m_bytes > m_maxBytes && !m_lru.empty()) {
+        const Entry& entry = m_lru.back();
+        if (entry.prefetched) {
+            ++m_stats.prefetchWasted;
+        }
+        ++m_stats.evictions;
+        m_bytes -= entry.bytes;
+        m_entries.erase(entry.key);
+        m_lru.pop_back();
+    }
+}
+
+void ResliceCache::schedulePrefetchLocked(const Key& key, const Source& source)
+{
+    auto state = std::find_if(m_scroll.begin(), m_scroll.end(),
+                              [&](const ScrollState& s) { return isSameView(s.last, key); });
+    if (state == m_scroll.end()) {
+        if (m_scroll.size() >= kMaxScrollStates) {
+            m_scroll.erase(m_scroll.begin());
+        }
+        m_scroll.push_back(ScrollState{key, 0});
+        return;
+    }
+
+    const int delta = key.index - state->last.index;
+    state->last = key;
+    if (delta == 0) {
+        return;  // Redraw without scrolling: keep whatever is queued
+    }
+    state->direction = delta > 0 ? 1 : -1;
+
+    m_prefetchQueue.clear();
+    const int planeCount = MPRReslicer::getSliceCount(*source.volume, key.orientation);
+    // At coarser levels neighbouring level-0 indices share a plane, so step a whole level plane
+    const int step = state->direction << std::max(0, source.pyramid ? key.level : 0);
+    Key ahead = key;
+    for (int k = 1; k <= m_prefetchDepth; ++k) {
+        ahead.index = key.index + k * step;
+        if (ahead.index < 0 || ahead.index >= planeCount) {
+            break;
+        }
+        if (!m_entries.count(ahead)) {
+            m_prefetchQueue.push_back(ahead);
+        }
+    }
+    if (!m_prefetchQueue.empty()) {
+        m_prefetchWake.notify_one();
+    }
+}
+
+void ResliceCache::prefetchLoop()
+{
+    // Own renderers and a single thread, so prefetching never holds up the interactive render
+    ThreadPool serial(1);
+    SlabRenderer slabRenderers[3];
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (true) {
+        m_prefetchWake.wait(lock, [this] { return m_stop || !m_prefetchQueue.empty(); });
+        if (m_stop) {
+            return;
+        }
+
+        const Key key = m_prefetchQueue.front();
+        m_prefetchQueue.pop_front();
+        const auto found = m_sources.find(key.volumeId);
+        if (found == m_sources.end() || m_entries.count(key)) {
+            continue;
+        }
+        const Source source = found->second;
+        m_prefetchBusy = true;
+        m_prefetchKey = key;
+        lock.unlock();
+
+        std::shared_ptr<SliceImage> image = render(source, key, slabRenderers[static_cast<int>(key.orientation)],
+                                                   serial);
+
+        lock.lock();
+        m_prefetchBusy = false;
+        if (image && m_sources.count(key.volumeId) && !m_entries.count(key)) {
+            insertLocked(key, std::move(image), true);
+            ++m_stats.prefetched;
+        }
+        m_renderFinished.notify_all();
+    }
+}
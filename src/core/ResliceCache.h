@@ -0,0 +1,189 @@
+#pragma once
+
+#include "MPRReslicer.h"
+#include "SlabRenderer.h"
+#include "Volume3D.h"
+#include "VolumePyramid.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief LRU cache of rendered orthogonal planes with scroll-direction prefetch
+ *
+ * Scrolling back and forth through a stack asks for the same planes again and
+ * again; this keeps the rendered SliceImages, keyed by volume, orientation,
+ * plane index, pyramid level and slab mode/thickness, up to a byte budget, and
+ * evicts the least recently used planes beyond it.
+ *
+ * Every get() also updates the scroll direction of its view (same volume,
+ * orientation, level and slab). When the index moved, a background thread
+ * renders the next planes in that direction so they are cached by the time
+ * the user gets there. A newer request replaces the pending prefetch queue,
+ * so the prefetcher never works on planes the user has scrolled away from.
+ * Prefetching renders on a single thread so it does not compete with the
+ * interactive render for the whole pool.
+ *
+ * Slabs are rendered without visible-range culling, so cached planes stay valid
+ * when the window changes. Images are shared: an evicted plane stays alive as
+ * long as a caller holds it.
+ */
+class ResliceCache
+{
+public:
+    /**
+     * @brief What a cached plane was rendered from
+     */
+    struct Key
+    {
+        uint64_t volumeId{0};
+        MPRReslicer::Orientation orientation{MPRReslicer::Orientation::Axial};
+        int index{0};         // Plane index at level 0
+        int level{0};         // Pyramid level
+        SlabRenderer::Mode mode{SlabRenderer::Mode::Maximum};
+        float thickness{0.0f};  // Slab thickness in mm; below the spacing = single plane
+
+        bool operator==(const Key& other) const;
+    };
+
+    /**
+     * @brief Counters for tuning the budget and prefetch depth
+     */
+    struct Stats
+    {
+        uint64_t hits{0};
+        uint64_t misses{0};
+        uint64_t prefetchHits{0};     // Hits on planes the prefetcher rendered (first use)
+        uint64_t prefetched{0};       // Planes rendered by the prefetcher
+        uint64_t prefetchWasted{0};   // Prefetched planes evicted without being used
+        uint64_t evictions{0};
+        size_t entries{0};
+        size_t bytes{0};
+
+        double getHitRate() const
+        {
+            const uint64_t total = hits + misses;
+            return total ? static_cast<double>(hits) / total : 0.0;
+        }
+    };
+
+    /**
+     * @brief Create a cache and start its prefetch thread
+     * @param maxBytes Budget for cached images
+     * @param prefetchDepth Planes to render ahead of the scroll position (0 = no prefetch)
+     */
+    explicit ResliceCache(size_t maxBytes, int prefetchDepth = 4);
+    ~ResliceCache();
+
+    ResliceCache(const ResliceCache&) = delete;
+    ResliceCache& operator=(const ResliceCache&) = delete;
+
+    /**
+     * @brief Register a volume
+     * @param volume Source volume (level 0)
+     * @param pyramid Coarser levels of volume, or nullptr for level 0 only
+     * @return Id for Key::volumeId; ids are never reused
+     */
+    uint64_t addVolume(std::shared_ptr<const Volume3D> volume, std::shared_ptr<const VolumePyramid> pyramid = nullptr);
+
+    /**
+     * @brief Forget a volume and drop its planes
+     */
+    void removeVolume(uint64_t volumeId);
+
+    /**
+     * @brief Get a plane, rendering it on the calling thread on a miss
+     * @param key Plane to get
+     * @param pool Pool to render a miss with (nullptr = global pool)
+     * @return Image, or nullptr if the volume is unknown or the index out of range
+     */
+    std::shared_ptr<const SliceImage> get(const Key& key, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Change the byte budget, evicting immediately if needed
+     */
+    void setMaxBytes(size_t maxBytes);
+
+    /**
+     * @brief Change the number of planes rendered ahead
+     */
+    void setPrefetchDepth(int prefetchDepth);
+
+    Stats getStats() const;
+    void resetStats();
+
+    /**
+     * @brief Drop all cached planes (volumes stay registered)
+     */
+    void clear();
+
+private:
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const;
+    };
+
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<const SliceImage> image;
+        size_t bytes{0};
+        bool prefetched{false};  // Rendered ahead and not used yet
+    };
+
+    struct Source
+    {
+        std::shared_ptr<const Volume3D> volume;
+        std::shared_ptr<const VolumePyramid> pyramid;
+    };
+
+    /**
+     * @brief Last index requested per view, for the scroll direction
+     */
+    struct ScrollState
+    {
+        Key last;
+        int direction{0};
+    };
+
+    static std::shared_ptr<SliceImage> render(const Source& source, const Key& key, SlabRenderer& slabRenderer,
+                                              ThreadPool& pool);
+
+    void insertLocked(const Key& key, std::shared_ptr<const SliceImage> image, bool prefetched);
+    void evictLocked();
+    void schedulePrefetchLocked(const Key& key, const Source& source);
+    void prefetchLoop();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_prefetchWake;
+    std::condition_variable m_renderFinished;
+
+    size_t m_maxBytes{0};
+    int m_prefetchDepth{0};
+    uint64_t m_nextVolumeId{1};
+    std::unordered_map<uint64_t, Source> m_sources;
+
+    std::list<Entry> m_lru;  // Most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> m_entries;
+    size_t m_bytes{0};
+    Stats m_stats;
+
+    std::vector<ScrollState> m_scroll;  // One per view, few
+    std::deque<Key> m_prefetchQueue;    // Nearest first
+    bool m_prefetchBusy{false};
+    Key m_prefetchKey;                  // Plane the prefetcher is rendering while busy
+    bool m_stop{false};
+
+    SlabRenderer m_slabRenderers[3];    // Foreground misses per orientation; guarded by m_renderMutex
+    std::mutex m_renderMutex;
+    std::thread m_prefetchThread;
+};
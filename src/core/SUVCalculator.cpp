@@ -0,0 +1,254 @@
+#include "SUVCalculator.h"
+#include "PixelConversion.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+thread_local std::string SUVCalculator::s_lastError;
+
+namespace {
+    constexpr double kSecondsPerDay = 86400.0;
+
+    /**
+     * @brief Convert count voxels of slice z starting at offset, widening the range
+     */
+    void convertRun(const Volume3D& volume, int z, double factor, size_t offset, size_t count, float* output,
+                    float& minValue, float& maxValue)
+    {
+        const size_t first = static_cast<size_t>(z) * volume.width * volume.height + offset;
+        if (volume.voxelType == Volume3D::VoxelType::Float32) {
+            PixelConversion::scaleFloat(volume.voxels.data() + first, count, static_cast<float>(factor), output,
+                                        minValue, maxValue);
+            return;
+        }
+
+        // Stored values: the factor folds into the rescale
+        PixelConversion::Rescale rescale;
+        rescale.enabled = true;
+        rescale.slope = volume.storedSlope * factor;
+        rescale.intercept = volume.storedIntercept * factor;
+        const char* source = static_cast<const char*>(volume.storedVoxels.get()) +
+                             first * Volume3D::getVoxelTypeSize(volume.voxelType);
+        PixelConversion::convertToFloat(source, PixelConversion::getStoredType(volume.voxelType), count, rescale,
+                                        output, minValue, maxValue);
+    }
+
+    void copyHeader(const Volume3D& source, Volume3D& target)
+    {
+        target.width = source.width;
+        target.height = source.height;
+        target.depth = source.depth;
+        for (int i = 0; i < 3; ++i) {
+            target.spacing[i] = source.spacing[i];
+            target.origin[i] = source.origin[i];
+            target.rowDir[i] = source.rowDir[i];
+            target.colDir[i] = source.colDir[i];
+            target.sliceDir[i] = source.sliceDir[i];
+        }
+        target.modality = source.modality;
+        target.patientID = source.patientID;
+        target.studyUID = source.studyUID;
+        target.seriesUID = source.seriesUID;
+        target.studyDate = source.studyDate;
+        target.seriesDescription = source.seriesDescription;
+        target.rescaleIntercept = source.rescaleIntercept;
+        target.rescaleSlope = source.rescaleSlope;
+        target.hasRescaleParams = source.hasRescaleParams;
+        if (source.pet) {
+            // Already SUV: converting again is a no-op
+            auto pet = std::make_shared<PetAcquisition>(*source.pet);
+            pet->units = "GML";
+            target.pet = std::move(pet);
+        }
+    }
+}
+
+std::string SUVCalculator::getLastError()
+{
+    return s_lastError;
+}
+
+bool SUVCalculator::View::isValid() const
+{
+    return volume && volume->isValid() && sliceFactors.size() == static_cast<size_t>(volume->depth);
+}
+
+bool SUVCalculator::View::isUniform() const
+{
+    return std::all_of(sliceFactors.begin(), sliceFactors.end(),
+                       [this](double factor) { return factor == sliceFactors.front(); });
+}
+
+float SUVCalculator::View::getSUV(int x, int y, int z) const
+{
+    if (!isValid() || x < 0 || x >= volume->width || y < 0 || y >= volume->height || z < 0 || z >= volume->depth) {
+        return 0.0f;
+    }
+    const size_t index = (static_cast<size_t>(z) * volume->height + y) * volume->width + x;
+    const double factor = sliceFactors[z];
+    if (volume->voxelType == Volume3D::VoxelType::Float32) {
+        return volume->voxels[index] * static_cast<float>(factor);
+    }
+    // Same expression as the conversion kernels, so getSUV and readSUV agree exactly
+    return volume->visitVoxels([&](const auto& view) {
+        using Scaled = std::decay_t<decltype(view)>;
+        return Scaled{view.data, view.slope * factor, view.intercept * factor}.valueAt(index);
+    });
+}
+
+void SUVCalculator::View::readSUV(int z, size_t offset, size_t count, float* output) const
+{
+    float minValue = std::numeric_limits<float>::max();
+    float maxValue = std::numeric_limits<float>::lowest();
+    convertRun(*volume, z, sliceFactors[z], offset, count, output, minValue, maxValue);
+}
+
+bool SUVCalculator::computeSliceFactors(const Volume3D& volume, std::vector<double>& factors)
+{
+    s_lastError.clear();
+    factors.clear();
+
+    if (!volume.pet) {
+        s_lastError = "Volume has no PET acquisition fields";
+        return false;
+    }
+    const PetAcquisition& pet = *volume.pet;
+    const size_t depth = static_cast<size_t>(std::max(volume.depth, 0));
+
+    if (pet.units == "GML") {
+        factors.assign(depth, 1.0);
+        return true;
+    }
+    if (pet.units != "BQML") {
+        s_lastError = "Unsupported PET units for SUV: '" + pet.units + "' (BQML or GML needed)";
+        return false;
+    }
+    if (!(pet.patientWeight > 0.0) || !(pet.injectedDose > 0.0)) {
+        s_lastError = "PET series lacks patient weight or injected dose";
+        return false;
+    }
+
+    // Weight in g over the dose decayed by `elapsed` seconds after injection
+    const double weightGrams = pet.patientWeight * 1000.0;
+    const auto factorAt = [&](double elapsed) {
+        if (elapsed < 0.0) {
+            elapsed += kSecondsPerDay;
+        }
+        return weightGrams / (pet.injectedDose * std::exp(-std::log(2.0) * elapsed / pet.halfLife));
+    };
+
+    if (pet.decayCorrection == "ADMIN") {
+        factors.assign(depth, weightGrams / pet.injectedDose);
+        return true;
+    }
+    if (!(pet.halfLife > 0.0) || !std::isfinite(pet.injectionTime)) {
+        s_lastError = "PET series lacks radionuclide half life or injection time";
+        return false;
+    }
+
+    if (pet.decayCorrection == "START") {
+        double scanTime = pet.seriesTime;
+        for (double time : pet.sliceAcquisitionTimes) {
+            if (std::isfinite(time) && !(time >= scanTime)) {
+                scanTime = time;
+            }
+        }
+        if (!std::isfinite(scanTime)) {
+            s_lastError = "PET series lacks series and acquisition times";
+            return false;
+        }
+        factors.assign(depth, factorAt(scanTime - pet.injectionTime));
+        return true;
+    }
+
+    if (pet.decayCorrection == "NONE") {
+        if (pet.sliceAcquisitionTimes.size() != depth ||
+            !std::all_of(pet.sliceAcquisitionTimes.begin(), pet.sliceAcquisitionTimes.end(),
+                         [](double time) { return std::isfinite(time); })) {
+            s_lastError = "Decay correction NONE needs an acquisition time for every slice";
+            return false;
+        }
+        factors.reserve(depth);
+        for (double time : pet.sliceAcquisitionTimes) {
+            factors.push_back(factorAt(time - pet.injectionTime));
+        }
+        return true;
+    }
+
+    s_lastError = "Unsupported PET decay correction: '" + pet.decayCorrection + "'";
+    return false;
+}
+
+bool SUVCalculator::createView(const std::shared_ptr<const Volume3D>& pet, View& view)
+{
+    view = View{};
+    if (!pet || !pet->isValid()) {
+        s_lastError = "Invalid PET volume";
+        return false;
+    }
+    if (!computeSliceFactors(*pet, view.sliceFactors)) {
+        return false;
+    }
+    view.volume = pet;
+    return true;
+}
+
+bool SUVCalculator::materialize(const View& view, Volume3D& output, ThreadPool* pool)
+{
+    s_lastError.clear();
+
+    if (!view.isValid()) {
+        s_lastError = "Invalid SUV view";
+        return false;
+    }
+    const Volume3D& source = *view.volume;
+
+    Volume3D result;
+    copyHeader(source, result);
+
+    if (source.voxelType != Volume3D::VoxelType::Float32 && view.isUniform()) {
+        // Share the stored block; only the rescale changes
+        const double factor = view.sliceFactors.front();
+        result.voxelType = source.voxelType;
+        result.storedVoxels = source.storedVoxels;
+        result.storedSlope = source.storedSlope * factor;
+        result.storedIntercept = source.storedIntercept * factor;
+
+        int32_t storedMin = std::numeric_limits<int32_t>::max();
+        int32_t storedMax = std::numeric_limits<int32_t>::min();
+        PixelConversion::findStoredRange(source.storedVoxels.get(), PixelConversion::getStoredType(source.voxelType),
+                                         source.getTotalVoxels(), storedMin, storedMax);
+        const float a = static_cast<float>(result.storedIntercept + result.storedSlope * static_cast<float>(storedMin));
+        const float b = static_cast<float>(result.storedIntercept + result.storedSlope * static_cast<float>(storedMax));
+        result.vmin = std::min(a, b);
+        result.vmax = std::max(a, b);
+        output = std::move(result);
+        return true;
+    }
+
+    // One SIMD pass per slice, straight into the float buffer
+    const size_t sliceSize = static_cast<size_t>(source.width) * source.height;
+    const size_t depth = static_cast<size_t>(source.depth);
+    result.voxels.resize(result.getTotalVoxels());
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    std::vector<std::pair<float, float>> ranges(threads.getChunkCount(depth),
+                                                {std::numeric_limits<float>::max(), std::numeric_limits<float>::lowest()});
+    threads.parallelFor(depth, [&](size_t chunk, size_t begin, size_t end) {
+        for (size_t z = begin; z < end; ++z) {
+            convertRun(source, static_cast<int>(z), view.sliceFactors[z], 0, sliceSize,
+                       result.voxels.data() + z * sliceSize, ranges[chunk].first, ranges[chunk].second);
+        }
+    });
+
+    result.vmin = std::numeric_limits<float>::max();
+    result.vmax = std::numeric_limits<float>::lowest();
+    for (const auto& range : ranges) {
+        result.vmin = std::min(result.vmin, range.first);
+        result.vmax = std::max(result.vmax, range.second);
+    }
+    output = std::move(result);
+    return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Volume3D.h"
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Body-weight standardized uptake values (SUVbw) of PET volumes
+ *
+ * SUV = activity concentration (Bq/ml) * patient weight (g) / dose (Bq),
+ * with the injected dose decayed to the time the image activity refers to,
+ * per Decay Correction (0054,1102):
+ * - START: the scan start, one factor for the whole volume. The scan start is
+ *   the Series Time, or the earliest Acquisition Time when that is earlier
+ *   (some scanners rewrite the Series Time on reconstruction);
+ * - ADMIN: the injection, so the dose is used as is;
+ * - NONE: each slice's own Acquisition Time, one factor per slice.
+ * Images in GML (g/ml) are already SUV and get a factor of 1. Without DICOM
+ * dates, an injection time after the scan time is taken as the previous day.
+ *
+ * A View converts on read: it shares the PET volume and keeps one factor per
+ * slice, so no second full-size float copy exists unless materialize() is
+ * called. Native storage folds the factor into the stored rescale and goes
+ * through the PixelConversion kernels.
+ */
+class SUVCalculator
+{
+public:
+    /**
+     * @brief SUV on top of a PET volume, converted when read
+     */
+    struct View
+    {
+        std::shared_ptr<const Volume3D> volume;
+        std::vector<double> sliceFactors;   // SUV = value * sliceFactors[z]
+
+        bool isValid() const;
+
+        /**
+         * @brief Whether every slice has the same factor
+         */
+        bool isUniform() const;
+
+        /**
+         * @brief SUV of one voxel (0 outside the volume)
+         */
+        float getSUV(int x, int y, int z) const;
+
+        /**
+         * @brief Convert a run of voxels within one slice
+         * @param z Slice index
+         * @param offset First voxel within the slice (y * width + x)
+         * @param count Number of voxels (offset + count <= width * height)
+         * @param output SUV values
+         */
+        void readSUV(int z, size_t offset, size_t count, float* output) const;
+    };
+
+    /**
+     * @brief SUV factor of every slice of a PET volume
+     * @param pet Volume with PET acquisition fields (Volume3D::pet)
+     * @param factors Output, one per slice
+     * @return false if the fields are missing or unsupported (see getLastError)
+     */
+    static bool computeSliceFactors(const Volume3D& pet, std::vector<double>& factors);
+
+    /**
+     * @brief Create an SUV view sharing the PET volume
+     * @return false if the factors cannot be computed (see getLastError)
+     */
+    static bool createView(const std::shared_ptr<const Volume3D>& pet, View& view);
+
+    /**
+     * @brief Materialize a view as a volume in SUV units
+     *
+     * A native-storage volume with one factor for all slices shares the voxel
+     * block (until either side is written) and only changes its rescale, so
+     * nothing is copied. Otherwise the result is float32, converted slice by
+     * slice across the pool. Brick
+     * ranges and the histogram are not carried over; the PET fields are, with
+     * GML units so the result converts with a factor of 1.
+     *
+     * @param view View to materialize
+     * @param output Output volume
+     * @param pool Pool to split slices over (nullptr = global pool)
+     * @return false if the view is invalid
+     */
+    static bool materialize(const View& view, Volume3D& output, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Get the last error message of the calling thread
+     */
+    static std::string getLastError();
+
+private:
+    static thread_local std::string s_lastError;
+};
@@ -0,0 +1,314 @@
+#include "SUVMetrics.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+thread_local std::string SUVMetrics::s_lastError;
+
+namespace {
+    /**
+     * @brief One x-run of the sphere: voxels (dx, dy, dz) with |dx| <= halfWidth
+     */
+    struct KernelRow
+    {
+        int dy;
+        int dz;
+        int halfWidth;
+    };
+
+    // Sphere membership of a voxel offset, evaluated in this order everywhere
+    inline bool insideSphere(int dx, int dy, int dz, const double spacing[3], double radiusSq)
+    {
+        const double x = dx * spacing[0];
+        const double y = dy * spacing[1];
+        const double z = dz * spacing[2];
+        return x * x + y * y + z * z <= radiusSq;
+    }
+
+    std::vector<KernelRow> getSphereRows(const double spacing[3], double radius, int reach[3])
+    {
+        const double radiusSq = radius * radius;
+        const int ky = static_cast<int>(std::ceil(radius / spacing[1]));
+        const int kz = static_cast<int>(std::ceil(radius / spacing[2]));
+
+        std::vector<KernelRow> rows;
+        reach[0] = reach[1] = reach[2] = 0;
+        for (int dz = -kz; dz <= kz; ++dz) {
+            for (int dy = -ky; dy <= ky; ++dy) {
+                if (!insideSphere(0, dy, dz, spacing, radiusSq)) {
+                    continue;
+                }
+                int halfWidth = 0;
+                while (insideSphere(halfWidth + 1, dy, dz, spacing, radiusSq)) {
+                    ++halfWidth;
+                }
+                rows.push_back(KernelRow{dy, dz, halfWidth});
+                reach[0] = std::max(reach[0], halfWidth);
+                reach[1] = std::max(reach[1], std::abs(dy));
+                reach[2] = std::max(reach[2], std::abs(dz));
+            }
+        }
+        return rows;
+    }
+
+    // Prefix sums held at once; larger ROIs are processed in z tiles
+    constexpr size_t kPrefixBudgetBytes = size_t(64) << 20;
+
+    /**
+     * @brief Per-chunk partial results, merged in chunk order
+     */
+    struct Partial
+    {
+        size_t count{0};
+        double sum{0.0};
+        float max{-std::numeric_limits<float>::infinity()};
+        int maxPosition[3]{0, 0, 0};
+        double peak{-std::numeric_limits<double>::infinity()};
+        int peakCenter[3]{0, 0, 0};
+        size_t peakVoxels{0};
+    };
+}
+
+std::string SUVMetrics::getLastError()
+{
+    return s_lastError;
+}
+
+SUVMetrics::Region SUVMetrics::Region::box(int x0, int y0, int z0, int x1, int y1, int z1)
+{
+    Region region;
+    region.begin[0] = std::min(x0, x1);
+    region.begin[1] = std::min(y0, y1);
+    region.begin[2] = std::min(z0, z1);
+    region.end[0] = std::max(x0, x1) + 1;
+    region.end[1] = std::max(y0, y1) + 1;
+    region.end[2] = std::max(z0, z1) + 1;
+    return region;
+}
+
+SUVMetrics::Region SUVMetrics::Region::ellipsoid(double centerX, double centerY, double centerZ,
+                                                 double radiusX, double radiusY, double radiusZ)
+{
+    Region region;
+    if (!(radiusX > 0.0) || !(radiusY > 0.0) || !(radiusZ > 0.0)) {
+        return region;
+    }
+    const double center[3] = {centerX, centerY, centerZ};
+    const double radius[3] = {radiusX, radiusY, radiusZ};
+    for (int a = 0; a < 3; ++a) {
+        region.begin[a] = static_cast<int>(std::floor(center[a] - radius[a]));
+        region.end[a] = static_cast<int>(std::ceil(center[a] + radius[a])) + 1;
+    }
+
+    const int size[3] = {region.end[0] - region.begin[0], region.end[1] - region.begin[1],
+                         region.end[2] - region.begin[2]};
+    region.mask.assign(static_cast<size_t>(size[0]) * size[1] * size[2], 0);
+    size_t index = 0;
+    for (int z = region.begin[2]; z < region.end[2]; ++z) {
+        const double dz = (z - centerZ) / radiusZ;
+        const double dz2 = dz * dz;
+        for (int y = region.begin[1]; y < region.end[1]; ++y) {
+            const double dy = (y - centerY) / radiusY;
+            const double dy2 = dy * dy;
+            for (int x = region.begin[0]; x < region.end[0]; ++x, ++index) {
+                const double dx = (x - centerX) / radiusX;
+                region.mask[index] = dx * dx + dy2 + dz2 <= 1.0 ? 1 : 0;
+            }
+        }
+    }
+    return region;
+}
+
+bool SUVMetrics::Region::contains(int x, int y, int z) const
+{
+    if (x < begin[0] || x >= end[0] || y < begin[1] || y >= end[1] || z < begin[2] || z >= end[2]) {
+        return false;
+    }
+    if (mask.empty()) {
+        return true;
+    }
+    const size_t width = static_cast<size_t>(end[0] - begin[0]);
+    const size_t height = static_cast<size_t>(end[1] - begin[1]);
+    return mask[(static_cast<size_t>(z - begin[2]) * height + (y - begin[1])) * width + (x - begin[0])] != 0;
+}
+
+double SUVMetrics::sphereRadius(double volumeMl)
+{
+    // 1 ml = 1000 mm^3
+    return std::cbrt(3.0 * volumeMl * 1000.0 / (4.0 * std::numbers::pi));
+}
+
+bool SUVMetrics::compute(const SUVCalculator::View& view, const Region& region, Result& result,
+                         double sphereVolumeMl, ThreadPool* pool)
+{
+    s_lastError.clear();
+    result = Result{};
+
+    if (!view.isValid()) {
+        s_lastError = "Invalid SUV view";
+        return false;
+    }
+    if (!(sphereVolumeMl > 0.0)) {
+        s_lastError = "Peak sphere volume must be positive";
+        return false;
+    }
+    const Volume3D& volume = *view.volume;
+    const int dims[3] = {volume.width, volume.height, volume.depth};
+
+    // ROI clipped to the volume, and the box the sphere can reach from it
+    int lo[3], hi[3];
+    for (int a = 0; a < 3; ++a) {
+        lo[a] = std::max(region.begin[a], 0);
+        hi[a] = std::min(region.end[a], dims[a]);
+        if (lo[a] >= hi[a]) {
+            s_lastError = "ROI is outside the volume";
+            return false;
+        }
+    }
+
+    int reach[3];
+    const std::vector<KernelRow> kernel = getSphereRows(volume.spacing, sphereRadius(sphereVolumeMl), reach);
+
+    // The prefix box spans the ROI grown by the sphere reach in x and y; in z
+    // it is built one tile of center slices at a time to bound its memory
+    int p0[2], pn[2];
+    for (int a = 0; a < 2; ++a) {
+        p0[a] = std::max(lo[a] - reach[a], 0);
+        pn[a] = std::min(hi[a] + reach[a], dims[a]) - p0[a];
+    }
+    const size_t stride = static_cast<size_t>(pn[0]) + 1;
+    const size_t sliceBytes = static_cast<size_t>(pn[1]) * stride * sizeof(double);
+    const int tileSlices = std::max(1, static_cast<int>(kPrefixBudgetBytes / sliceBytes) - 2 * reach[2]);
+
+    // SUVmean is summed per ROI row and reduced in row order, independent of the pool
+    const int roiHeight = hi[1] - lo[1];
+    std::vector<double> rowSums(static_cast<size_t>(roiHeight) * (hi[2] - lo[2]), 0.0);
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    constexpr size_t kMinRows = 8;
+    std::vector<double> prefix;
+    Partial total;
+    for (int tileBegin = lo[2]; tileBegin < hi[2]; tileBegin += tileSlices) {
+        const int tileEnd = std::min(tileBegin + tileSlices, hi[2]);
+        const int z0 = std::max(tileBegin - reach[2], 0);
+        const int depth = std::min(tileEnd + reach[2], dims[2]) - z0;
+
+        // Pass 1: read SUV rows once, build per-row prefix sums, and collect max/mean
+        // over the tile's ROI voxels on the way
+        const size_t prefixRows = static_cast<size_t>(pn[1]) * depth;
+        prefix.resize(prefixRows * stride);
+        std::vector<Partial> partials(threads.getChunkCount(prefixRows, kMinRows));
+        threads.parallelFor(prefixRows, [&](size_t chunk, size_t begin, size_t end) {
+            Partial& partial = partials[chunk];
+            std::vector<float> values(static_cast<size_t>(pn[0]));
+            for (size_t row = begin; row < end; ++row) {
+                const int y = p0[1] + static_cast<int>(row % pn[1]);
+                const int z = z0 + static_cast<int>(row / pn[1]);
+                view.readSUV(z, static_cast<size_t>(y) * volume.width + p0[0], values.size(), values.data());
+
+                double* sums = prefix.data() + row * stride;
+                double running = 0.0;
+                sums[0] = 0.0;
+                for (int i = 0; i < pn[0]; ++i) {
+                    running += values[i];
+                    sums[i + 1] = running;
+                }
+
+                // Reach rows belong to the neighbouring tiles
+                if (y < lo[1] || y >= hi[1] || z < tileBegin || z >= tileEnd) {
+                    continue;
+                }
+                double rowSum = 0.0;
+                for (int x = lo[0]; x < hi[0]; ++x) {
+                    if (!region.contains(x, y, z)) {
+                        continue;
+                    }
+                    const float value = values[x - p0[0]];
+                    ++partial.count;
+                    rowSum += value;
+                    if (value > partial.max) {
+                        partial.max = value;
+                        partial.maxPosition[0] = x;
+                        partial.maxPosition[1] = y;
+                        partial.maxPosition[2] = z;
+                    }
+                }
+                rowSums[static_cast<size_t>(z - lo[2]) * roiHeight + (y - lo[1])] = rowSum;
+            }
+        }, kMinRows);
+
+        for (const Partial& partial : partials) {
+            total.count += partial.count;
+            if (partial.count > 0 && partial.max > total.max) {
+                total.max = partial.max;
+                std::copy(partial.maxPosition, partial.maxPosition + 3, total.maxPosition);
+            }
+        }
+
+        // Pass 2: sphere mean at every ROI voxel of the tile, one prefix difference per kernel row
+        const size_t centerRows = static_cast<size_t>(roiHeight) * (tileEnd - tileBegin);
+        std::vector<Partial> peaks(threads.getChunkCount(centerRows, kMinRows));
+        threads.parallelFor(centerRows, [&](size_t chunk, size_t begin, size_t end) {
+            Partial& partial = peaks[chunk];
+            for (size_t row = begin; row < end; ++row) {
+                const int y = lo[1] + static_cast<int>(row % roiHeight);
+                const int z = tileBegin + static_cast<int>(row / roiHeight);
+                for (int x = lo[0]; x < hi[0]; ++x) {
+                    if (!region.contains(x, y, z)) {
+                        continue;
+                    }
+                    double sum = 0.0;
+                    size_t count = 0;
+                    for (const KernelRow& k : kernel) {
+                        // Rows outside the prefix box are outside the volume
+                        const int py = y + k.dy - p0[1];
+                        const int pz = z + k.dz - z0;
+                        if (py < 0 || py >= pn[1] || pz < 0 || pz >= depth) {
+                            continue;
+                        }
+                        const int x0 = std::max(x - k.halfWidth - p0[0], 0);
+                        const int x1 = std::min(x + k.halfWidth - p0[0], pn[0] - 1);
+                        const double* sums = prefix.data() + (static_cast<size_t>(pz) * pn[1] + py) * stride;
+                        sum += sums[x1 + 1] - sums[x0];
+                        count += static_cast<size_t>(x1 - x0 + 1);
+                    }
+                    const double mean = sum / static_cast<double>(count);
+                    if (mean > partial.peak) {
+                        partial.peak = mean;
+                        partial.peakCenter[0] = x;
+                        partial.peakCenter[1] = y;
+                        partial.peakCenter[2] = z;
+                        partial.peakVoxels = count;
+                    }
+                }
+            }
+        }, kMinRows);
+
+        for (const Partial& partial : peaks) {
+            if (partial.peak > total.peak) {
+                total.peak = partial.peak;
+                std::copy(partial.peakCenter, partial.peakCenter + 3, total.peakCenter);
+                total.peakVoxels = partial.peakVoxels;
+            }
+        }
+    }
+
+    if (total.count == 0) {
+        s_lastError = "ROI has no voxels inside the volume";
+        return false;
+    }
+    for (double rowSum : rowSums) {
+        total.sum += rowSum;
+    }
+
+    result.count = total.count;
+    result.mean = total.sum / static_cast<double>(total.count);
+    result.max = total.max;
+    std::copy(total.maxPosition, total.maxPosition + 3, result.maxPosition);
+    result.peak = total.peak;
+    std::copy(total.peakCenter, total.peakCenter + 3, result.peakCenter);
+    result.peakVoxels = total.peakVoxels;
+    return true;
+}
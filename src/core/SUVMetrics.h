@@ -0,0 +1,92 @@
+#pragma once
+
+#include "SUVCalculator.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief SUVmax, SUVmean and SUVpeak of a lesion ROI
+ *
+ * SUVpeak is the highest mean SUV over a sphere of fixed volume (1 ml by
+ * default, radius 6.2 mm) whose center is a voxel inside the ROI; the sphere
+ * itself may reach outside the ROI. A voxel belongs to the sphere when its
+ * center lies within the radius in mm, so anisotropic spacing shapes the
+ * sphere correctly in voxels. Near the volume edge only the voxels inside
+ * the volume are averaged.
+ *
+ * A sphere is not separable, but it is a set of x-runs, one per (dy, dz)
+ * offset. SUV values of the ROI bounding box grown by the radius are read
+ * once through the SUV view and turned into per-row prefix sums, so each
+ * candidate center costs one subtraction per run (O(k^2) instead of O(k^3)
+ * for a k-voxel-wide sphere). The prefix sums of a large ROI are built in z
+ * tiles of at most 64 MiB, so a whole-volume ROI does not need one double per
+ * voxel at once. Rows are split across the pool; SUVmean is summed per row and
+ * reduced in row order, so results are identical for any thread count, ties
+ * going to the first center in z, y, x order.
+ */
+class SUVMetrics
+{
+public:
+    /**
+     * @brief Lesion ROI: a box of voxels, optionally narrowed by a mask
+     */
+    struct Region
+    {
+        int begin[3]{0, 0, 0};  // First voxel (x, y, z)
+        int end[3]{0, 0, 0};    // One past the last voxel
+        std::vector<uint8_t> mask;  // Over the box, x fastest; nonzero = inside (empty = whole box)
+
+        /**
+         * @brief Box with inclusive corners in any order
+         */
+        static Region box(int x0, int y0, int z0, int x1, int y1, int z1);
+
+        /**
+         * @brief Ellipsoid in voxels, same inclusion rule as ROIStatistics
+         */
+        static Region ellipsoid(double centerX, double centerY, double centerZ,
+                                double radiusX, double radiusY, double radiusZ);
+
+        bool contains(int x, int y, int z) const;
+    };
+
+    struct Result
+    {
+        size_t count{0};            // ROI voxels inside the volume
+        double mean{0.0};           // SUVmean
+        float max{0.0f};            // SUVmax
+        int maxPosition[3]{0, 0, 0};
+        double peak{0.0};           // SUVpeak
+        int peakCenter[3]{0, 0, 0};
+        size_t peakVoxels{0};       // Voxels averaged for the peak sphere
+    };
+
+    /**
+     * @brief Radius in mm of a sphere with the given volume in ml
+     */
+    static double sphereRadius(double volumeMl);
+
+    /**
+     * @brief Compute SUVmax, SUVmean and SUVpeak
+     * @param view SUV view of the PET volume
+     * @param region Lesion ROI (clipped to the volume)
+     * @param result Output
+     * @param sphereVolumeMl Peak sphere volume
+     * @param pool Pool to split rows over (nullptr = global pool)
+     * @return false if the view is invalid or the ROI is empty (see getLastError)
+     */
+    static bool compute(const SUVCalculator::View& view, const Region& region, Result& result,
+                        double sphereVolumeMl = 1.0, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Get the last error message of the calling thread
+     */
+    static std::string getLastError();
+
+private:
+    static thread_local std::string s_lastError;
+};
@@ -0,0 +1,544 @@
+#include "SlabRenderer.h"
+#include "BrickRangeGrid.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+
+#if AMPR_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+namespace {
+    using Mode = SlabRenderer::Mode;
+    using Orientation = MPRReslicer::Orientation;
+
+    // Longest slab whose 16-bit sum cannot overflow int32
+    constexpr int kMaxSlabPlanes = 32767;
+
+    // Cached blocks are one brick layer thick, so the brick mask applies to them too
+    constexpr int kBlockShift = BrickRangeGrid::kBrickShift;
+    constexpr int kBlockPlanes = 1 << kBlockShift;
+
+    // Rows per task: enough pixels to amortize scheduling on small planes
+    size_t minRowsPerChunk(int width)
+    {
+        return std::max<size_t>(1, 16384 / static_cast<size_t>(std::max(1, width)));
+    }
+
+    /**
+     * @brief Accumulator type of a reduction over stored values of type T
+     */
+    template <Mode M, typename T>
+    using AccumulatorOf = std::conditional_t<M != Mode::Average, T,
+                                             std::conditional_t<std::is_same_v<T, float>, double, int32_t>>;
+
+    template <Mode M, typename A>
+    A identity()
+    {
+        if constexpr (M == Mode::Maximum) {
+            return std::numeric_limits<A>::lowest();
+        } else if constexpr (M == Mode::Minimum) {
+            return std::numeric_limits<A>::max();
+        } else {
+            return A(0);
+        }
+    }
+
+    template <Mode M, typename A>
+    A combine(A a, A b)
+    {
+        if constexpr (M == Mode::Maximum) {
+            return std::max(a, b);
+        } else if constexpr (M == Mode::Minimum) {
+            return std::min(a, b);
+        } else {
+            return a + b;
+        }
+    }
+
+    /**
+     * @brief acc[i] = combine(acc[i], source[i]) over a contiguous run
+     */
+    template <Mode M, typename A, typename S>
+    void reduceRunScalar(A* acc, const S* source, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            acc[i] = combine<M>(acc[i], static_cast<A>(source[i]));
+        }
+    }
+
+#if AMPR_HAS_X86_SIMD
+    template <Mode M>
+    AMPR_TARGET_AVX2 inline __m256i reduce16(__m256i a, __m256i b, int16_t)
+    {
+        return M == Mode::Maximum ? _mm256_max_epi16(a, b) : _mm256_min_epi16(a, b);
+    }
+    template <Mode M>
+    AMPR_TARGET_AVX2 inline __m256i reduce16(__m256i a, __m256i b, uint16_t)
+    {
+        return M == Mode::Maximum ? _mm256_max_epu16(a, b) : _mm256_min_epu16(a, b);
+    }
+    template <Mode M>
+    AMPR_TARGET_AVX2 inline __m256i reduce16(__m256i a, __m256i b, uint8_t)
+    {
+        return M == Mode::Maximum ? _mm256_max_epu8(a, b) : _mm256_min_epu8(a, b);
+    }
+
+    // Widen 8 stored values to int32
+    AMPR_TARGET_AVX2 inline __m256i widen8(const int16_t* p)
+    {
+        return _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    AMPR_TARGET_AVX2 inline __m256i widen8(const uint16_t* p)
+    {
+        return _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    }
+    AMPR_TARGET_AVX2 inline __m256i widen8(const uint8_t* p)
+    {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+    }
+
+    /**
+     * @brief AVX2 version of reduceRunScalar, 32 bytes of accumulator per step
+     */
+    template <Mode M, typename A, typename S>
+    AMPR_TARGET_AVX2 void reduceRunAVX2(A* acc, const S* source, size_t count)
+    {
+        size_t i = 0;
+        if constexpr (std::is_same_v<A, float>) {
+            for (; i + 8 <= count; i += 8) {
+                const __m256 a = _mm256_loadu_ps(acc + i);
+                const __m256 b = _mm256_loadu_ps(source + i);
+                _mm256_storeu_ps(acc + i, M == Mode::Maximum ? _mm256_max_ps(a, b) : _mm256_min_ps(a, b));
+            }
+        } else if constexpr (std::is_same_v<A, double>) {
+            for (; i + 4 <= count; i += 4) {
+                __m256d b;
+                if constexpr (std::is_same_v<S, float>) {
+                    b = _mm256_cvtps_pd(_mm_loadu_ps(source + i));
+                } else {
+                    b = _mm256_loadu_pd(source + i);
+                }
+                _mm256_storeu_pd(acc + i, _mm256_add_pd(_mm256_loadu_pd(acc + i), b));
+            }
+        } else if constexpr (std::is_same_v<A, int32_t>) {
+            for (; i + 8 <= count; i += 8) {
+                __m256i b;
+                if constexpr (std::is_same_v<S, int32_t>) {
+                    b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+                } else {
+                    b = widen8(source + i);
+                }
+                __m256i* a = reinterpret_cast<__m256i*>(acc + i);
+                _mm256_storeu_si256(a, _mm256_add_epi32(_mm256_loadu_si256(a), b));
+            }
+        } else {
+            // Max/min in the 8/16-bit stored type
+            constexpr size_t lanes = 32 / sizeof(A);
+            for (; i + lanes <= count; i += lanes) {
+                __m256i* a = reinterpret_cast<__m256i*>(acc + i);
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+                _mm256_storeu_si256(a, reduce16<M>(_mm256_loadu_si256(a), b, A()));
+            }
+        }
+        reduceRunScalar<M>(acc + i, source + i, count - i);
+    }
+#endif
+
+    template <Mode M, typename A, typename S>
+    void reduceRun(A* acc, const S* source, size_t count, bool avx2)
+    {
+#if AMPR_HAS_X86_SIMD
+        if (avx2) {
+            reduceRunAVX2<M>(acc, source, count);
+            return;
+        }
+#endif
+        (void)avx2;
+        reduceRunScalar<M>(acc, source, count);
+    }
+
+    /**
+     * @brief Volume strides and the orientation being projected
+     */
+    struct SlabLayout
+    {
+        Orientation orientation;
+        int width;                       // Output row length
+        int lastSlice;                   // depth - 1
+        size_t rowStride;                // Volume width
+        size_t sliceStride;              // Volume width * height
+        bool avx2;
+        const unsigned char* occupied;   // Brick mask ([bz][by][bx]), nullptr = no culling
+        int bricksX;
+        int bricksY;
+
+        const unsigned char* brickRow(int y, int z) const
+        {
+            constexpr int shift = BrickRangeGrid::kBrickShift;
+            return occupied + (static_cast<size_t>(z >> shift) * bricksY + (y >> shift)) * bricksX;
+        }
+    };
+
+    /**
+     * @brief Pixel span from the first to the last occupied brick of one brick row
+     *
+     * Gaps inside the span are reduced anyway: a row read as one stream is
+     * cheaper than scattered brick-wide pieces of it, which are bound by memory
+     * latency. Skipping happens at the row ends and on fully empty rows.
+     *
+     * @return false if no brick of the row is occupied
+     */
+    bool occupiedSpan(const unsigned char* bricks, int bricksX, int width, int& begin, int& end)
+    {
+        int first = 0;
+        while (first < bricksX && !bricks[first]) {
+            ++first;
+        }
+        if (first == bricksX) {
+            return false;
+        }
+        int last = bricksX - 1;
+        while (!bricks[last]) {
+            --last;
+        }
+        begin = first << BrickRangeGrid::kBrickShift;
+        end = std::min(width, (last + 1) << BrickRangeGrid::kBrickShift);
+        return true;
+    }
+
+    /**
+     * @brief Reduce planes [from, to] of output row y into acc
+     *
+     * Axial and coronal planes contribute one contiguous row each. Sagittal
+     * planes are columns, so each output pixel instead reduces the contiguous
+     * x run of its volume row.
+     */
+    template <Mode M, typename A, typename T>
+    void accumulatePlanes(const VoxelView<T>& view, const SlabLayout& layout, int y, int from, int to, A* acc)
+    {
+        if (from > to) {
+            return;
+        }
+        // Contiguous rows: reduce the span of bricks that survive culling
+        auto reduceRow = [&](const T* source, const unsigned char* bricks) {
+            int begin = 0, end = layout.width;
+            if (!bricks || occupiedSpan(bricks, layout.bricksX, layout.width, begin, end)) {
+                reduceRun<M>(acc + begin, source + begin, end - begin, layout.avx2);
+            }
+        };
+
+        switch (layout.orientation) {
+        case Orientation::Axial:
+            for (int s = from; s <= to; ++s) {
+                reduceRow(view.data + s * layout.sliceStride + y * layout.rowStride,
+                          layout.occupied ? layout.brickRow(y, s) : nullptr);
+            }
+            break;
+        case Orientation::Coronal: {
+            const int z = layout.lastSlice - y;
+            const T* slice = view.data + z * layout.sliceStride;
+            for (int s = from; s <= to; ++s) {
+                reduceRow(slice + s * layout.rowStride, layout.occupied ? layout.brickRow(s, z) : nullptr);
+            }
+            break;
+        }
+        case Orientation::Sagittal: {
+            constexpr int mask = BrickRangeGrid::kBrickSize - 1;
+            const int z = layout.lastSlice - y;
+            const T* slice = view.data + z * layout.sliceStride;
+            for (int x = 0; x < layout.width; ++x) {
+                const unsigned char* bricks = layout.occupied ? layout.brickRow(x, z) : nullptr;
+                const T* run = slice + x * layout.rowStride;
+                A value = acc[x];
+                for (int s = from; s <= to;) {
+                    const int segmentEnd = std::min(to, s | mask);
+                    if (!bricks || bricks[s >> BrickRangeGrid::kBrickShift]) {
+                        for (int i = s; i <= segmentEnd; ++i) {
+                            value = combine<M>(value, static_cast<A>(run[i]));
+                        }
+                    }
+                    s = segmentEnd + 1;
+                }
+                acc[x] = value;
+            }
+            break;
+        }
+        }
+    }
+
+    /**
+     * @brief Combine row y of a cached block into acc, skipping culled bricks
+     */
+    template <Mode M, typename A>
+    void combineBlock(const SlabLayout& layout, int y, int block, const A* blockRow, A* acc)
+    {
+        if (!layout.occupied) {
+            reduceRun<M>(acc, blockRow, layout.width, layout.avx2);
+            return;
+        }
+
+        auto reduceSpan = [&](const unsigned char* bricks) {
+            int begin = 0, end = 0;
+            if (occupiedSpan(bricks, layout.bricksX, layout.width, begin, end)) {
+                reduceRun<M>(acc + begin, blockRow + begin, end - begin, layout.avx2);
+            }
+        };
+        const int plane = block << kBlockShift;
+        const int z = layout.lastSlice - y;
+        switch (layout.orientation) {
+        case Orientation::Axial:
+            reduceSpan(layout.brickRow(y, plane));
+            break;
+        case Orientation::Coronal:
+            reduceSpan(layout.brickRow(plane, z));
+            break;
+        case Orientation::Sagittal: {
+            // Output columns run along volume y: one brick of column `block` per 16 pixels
+            const unsigned char* bricks = layout.occupied +
+                                          static_cast<size_t>(z >> kBlockShift) * layout.bricksY * layout.bricksX + block;
+            for (int by = 0; by < layout.bricksY; ++by) {
+                if (bricks[static_cast<size_t>(by) * layout.bricksX]) {
+                    const int begin = by << kBlockShift;
+                    const int end = std::min(layout.width, begin + kBlockPlanes);
+                    reduceRun<M>(acc + begin, blockRow + begin, end - begin, layout.avx2);
+                }
+            }
+            break;
+        }
+        }
+    }
+}
+
+bool SlabRenderer::CacheKey::operator==(const CacheKey& other) const
+{
+    return generation == other.generation && width == other.width && height == other.height && depth == other.depth &&
+           voxelType == other.voxelType && orientation == other.orientation && mode == other.mode &&
+           low == other.low && high == other.high;
+}
+
+int SlabRenderer::getSlabPlaneCount(const Volume3D& volume, MPRReslicer::Orientation orientation, double thickness)
+{
+    double spacing = volume.spacing[2];
+    if (orientation == Orientation::Coronal) {
+        spacing = volume.spacing[1];
+    } else if (orientation == Orientation::Sagittal) {
+        spacing = volume.spacing[0];
+    }
+    if (spacing <= 0.0 || !(thickness > spacing)) {
+        return 1;
+    }
+    const double planes = std::round(thickness / spacing);
+    return static_cast<int>(std::min<double>(planes, kMaxSlabPlanes));
+}
+
+void SlabRenderer::getSlabRange(const Volume3D& volume, MPRReslicer::Orientation orientation, int index,
+                                double thickness, int& first, int& last)
+{
+    const int count = getSlabPlaneCount(volume, orientation, thickness);
+    const int planes = MPRReslicer::getSliceCount(volume, orientation);
+    first = std::max(0, index - (count - 1) / 2);
+    last = std::min(planes - 1, index - (count - 1) / 2 + count - 1);
+}
+
+bool SlabRenderer::render(const Volume3D& volume, MPRReslicer::Orientation orientation, int index, double thickness,
+                          Mode mode, SliceImage& output, ThreadPool* pool)
+{
+    if (!volume.isValid() || index < 0 || index >= MPRReslicer::getSliceCount(volume, orientation)) {
+        return false;
+    }
+
+    int width = 0, height = 0;
+    MPRReslicer::getSliceGeometry(volume, orientation, width, height, output.pixelSpacing);
+    output.resize(width, height);
+
+    int first = 0, last = 0;
+    getSlabRange(volume, orientation, index, thickness, first, last);
+
+    // Stored values are reduced before the rescale; a negative slope swaps max and min
+    const bool nativeStorage = volume.voxelType != Volume3D::VoxelType::Float32;
+    Mode storedMode = mode;
+    if (nativeStorage && volume.storedSlope < 0.0 && mode != Mode::Average) {
+        storedMode = mode == Mode::Maximum ? Mode::Minimum : Mode::Maximum;
+    }
+
+    CacheKey key;
+    key.generation = volume.generation;
+    key.width = volume.width;
+    key.height = volume.height;
+    key.depth = volume.depth;
+    key.voxelType = volume.voxelType;
+    key.orientation = orientation;
+    key.mode = storedMode;
+
+    // Culling works on the displayed values, so it follows the requested mode
+    key.low = std::numeric_limits<float>::lowest();
+    key.high = std::numeric_limits<float>::max();
+    const BrickRangeGrid* grid = volume.brickRanges.get();
+    auto bricksAlong = [](int size) { return (size + BrickRangeGrid::kBrickSize - 1) >> BrickRangeGrid::kBrickShift; };
+    const bool gridMatches = grid && grid->getBrickCount(0) == bricksAlong(volume.width) &&
+                             grid->getBrickCount(1) == bricksAlong(volume.height) &&
+                             grid->getBrickCount(2) == bricksAlong(volume.depth);
+    const unsigned char* occupied = nullptr;
+    if (gridMatches && mode == Mode::Maximum && m_visibleLow > std::numeric_limits<float>::lowest()) {
+        key.low = m_visibleLow;
+        m_occupied.resize(grid->getRanges().size());
+        for (size_t i = 0; i < m_occupied.size(); ++i) {
+            m_occupied[i] = grid->getRanges()[i].max > key.low;
+        }
+        occupied = m_occupied.data();
+    } else if (gridMatches && mode == Mode::Minimum && m_visibleHigh < std::numeric_limits<float>::max()) {
+        key.high = m_visibleHigh;
+        m_occupied.resize(grid->getRanges().size());
+        for (size_t i = 0; i < m_occupied.size(); ++i) {
+            m_occupied[i] = grid->getRanges()[i].min < key.high;
+        }
+        occupied = m_occupied.data();
+    }
+
+    if (!(key == m_key)) {
+        m_blocks.clear();
+        m_key = key;
+    }
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    volume.visitVoxels([&](const auto& view) {
+        switch (storedMode) {
+        case Mode::Maximum:
+            renderTyped<Mode::Maximum>(view, volume, orientation, first, last, occupied, output, threads);
+            break;
+        case Mode::Minimum:
+            renderTyped<Mode::Minimum>(view, volume, orientation, first, last, occupied, output, threads);
+            break;
+        case Mode::Average:
+            renderTyped<Mode::Average>(view, volume, orientation, first, last, occupied, output, threads);
+            break;
+        }
+    });
+
+    return true;
+}
+
+template <SlabRenderer::Mode M, typename T>
+void SlabRenderer::renderTyped(const VoxelView<T>& view, const Volume3D& volume, MPRReslicer::Orientation orientation,
+                               int first, int last, const unsigned char* occupied, SliceImage& output,
+                               ThreadPool& threads)
+{
+    using A = AccumulatorOf<M, T>;
+
+    SlabLayout layout;
+    layout.orientation = orientation;
+    layout.width = output.width;
+    layout.lastSlice = volume.depth - 1;
+    layout.rowStride = static_cast<size_t>(volume.width);
+    layout.sliceStride = layout.rowStride * volume.height;
+    layout.avx2 = CpuFeatures::hasAVX2();
+    layout.occupied = occupied;
+    layout.bricksX = (volume.width + BrickRangeGrid::kBrickSize - 1) >> BrickRangeGrid::kBrickShift;
+    layout.bricksY = (volume.height + BrickRangeGrid::kBrickSize - 1) >> BrickRangeGrid::kBrickShift;
+
+    const int width = output.width;
+    const size_t planeBytes = static_cast<size_t>(width) * output.height * sizeof(A);
+
+    // Blocks [firstBlock, endBlock) lie entirely inside the slab
+    const int firstBlock = (first + kBlockPlanes - 1) >> kBlockShift;
+    const int endBlock = (last + 1) >> kBlockShift;
+
+    // Keep one block of margin on each side so the slab can slide back and forth
+    for (auto it = m_blocks.begin(); it != m_blocks.end();) {
+        if (it->first < firstBlock - 1 || it->first > endBlock) {
+            it = m_blocks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::vector<std::pair<int, const A*>> blocks;
+    std::vector<std::pair<int, A*>> missing;
+    for (int b = firstBlock; b < endBlock; ++b) {
+        std::vector<unsigned char>& block = m_blocks[b];
+        if (block.empty()) {
+            block.resize(planeBytes);
+            missing.emplace_back(b, reinterpret_cast<A*>(block.data()));
+        }
+        blocks.emplace_back(b, reinterpret_cast<const A*>(block.data()));
+    }
+
+    // Planes outside the full blocks
+    int headEnd = last;
+    int tailBegin = last + 1;
+    if (firstBlock < endBlock) {
+        headEnd = (firstBlock << kBlockShift) - 1;
+        tailBegin = endBlock << kBlockShift;
+    }
+
+    const int count = last - first + 1;
+    const float low = m_key.low;
+    const float high = m_key.high;
+    threads.parallelFor(static_cast<size_t>(output.height), [&](size_t, size_t begin, size_t end) {
+        std::vector<A> acc(width);
+        for (size_t y = begin; y < end; ++y) {
+            const int row = static_cast<int>(y);
+            const size_t rowOffset = y * width;
+
+            for (const auto& [b, data] : missing) {
+                A* blockRow = data + rowOffset;
+                std::fill(blockRow, blockRow + width, identity<M, A>());
+                accumulatePlanes<M>(view, layout, row, b << kBlockShift, (b << kBlockShift) + kBlockPlanes - 1, blockRow);
+            }
+
+            std::fill(acc.begin(), acc.end(), identity<M, A>());
+            accumulatePlanes<M>(view, layout, row, first, headEnd, acc.data());
+            accumulatePlanes<M>(view, layout, row, tailBegin, last, acc.data());
+            for (const auto& [b, data] : blocks) {
+                combineBlock<M>(layout, row, b, data + rowOffset, acc.data());
+            }
+
+            // Rescale exactly like VoxelView::valueAt
+            float* out = output.row(row);
+            if constexpr (M == Mode::Average) {
+                for (int x = 0; x < width; ++x) {
+                    out[x] = static_cast<float>(view.intercept + view.slope * (static_cast<double>(acc[x]) / count));
+                }
+            } else {
+                // Culled pixels (still at the identity) land on the visible bound
+                for (int x = 0; x < width; ++x) {
+                    const float value = static_cast<float>(view.intercept + view.slope * static_cast<float>(acc[x]));
+                    out[x] = std::min(std::max(value, low), high);
+                }
+            }
+        }
+    }, minRowsPerChunk(width));
+}
+
+void SlabRenderer::setVisibleRange(float low, float high)
+{
+    m_visibleLow = low;
+    m_visibleHigh = high;
+}
+
+void SlabRenderer::clearVisibleRange()
+{
+    m_visibleLow = std::numeric_limits<float>::lowest();
+    m_visibleHigh = std::numeric_limits<float>::max();
+}
+
+void SlabRenderer::clear()
+{
+    m_blocks.clear();
+    m_key = CacheKey();
+}
+
+size_t SlabRenderer::getCacheMemoryUsage() const
+{
+    size_t bytes = 0;
+    for (const auto& entry : m_blocks) {
+        bytes += entry.second.size();
+    }
+    return bytes;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "MPRReslicer.h"
+#include "Volume3D.h"
+#include <cstddef>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Thick-slab projection (MIP, MinIP, average) of orthogonal planes
+ *
+ * A slab is the run of planes around a center plane along the plane normal:
+ * axial slabs reduce over z, coronal over y, sagittal over x. Output pixels
+ * line up with MPRReslicer::extractSlice for the same orientation.
+ *
+ * Reductions run on stored values (max/min in the stored type, sums in int32
+ * or double) with AVX2 kernels when available, and are rescaled once at the
+ * end. Integer sums are exact, so an average does not depend on how it was
+ * accumulated.
+ *
+ * Sliding window: the normal axis is cut into fixed 16-plane blocks (one brick
+ * layer), and the reduced plane of every block that lies entirely inside the
+ * slab is cached. Moving the slab by one plane then only re-reduces the
+ * partial blocks at both ends and combines the cached ones: at most
+ * 30 + n / 16 plane operations instead of n (36 instead of 100 for a 50 mm
+ * slab of 0.5 mm slices, 55 instead of 400 for 200 mm). Output rows are split
+ * across the thread pool.
+ *
+ * Empty-space skipping: with a visible range set (usually the display
+ * window), MIP skips every brick of Volume3D::brickRanges whose maximum is at
+ * or below the low end, and MinIP every brick whose minimum is at or above the
+ * high end, both in the planes it reads and in the cached blocks it combines.
+ * Such bricks cannot change what is displayed.
+ *
+ * The cache belongs to the renderer instance, so keep one renderer per view.
+ * It is dropped automatically when the volume (Volume3D::generation, which
+ * setVoxel renews), orientation, mode or visible range changes; call clear()
+ * after writing the voxel buffers directly. Not thread-safe.
+ */
+class SlabRenderer
+{
+public:
+    enum class Mode
+    {
+        Maximum,   // MIP
+        Minimum,   // MinIP
+        Average
+    };
+
+    /**
+     * @brief Number of planes a slab of the given thickness covers (at least 1)
+     */
+    static int getSlabPlaneCount(const Volume3D& volume, MPRReslicer::Orientation orientation, double thickness);
+
+    /**
+     * @brief Planes covered by a slab, clipped to the volume
+     * @param index Center plane index
+     * @param thickness Slab thickness in mm
+     * @param first Output first plane
+     * @param last Output last plane (inclusive)
+     */
+    static void getSlabRange(const Volume3D& volume, MPRReslicer::Orientation orientation, int index,
+                             double thickness, int& first, int& last);
+
+    /**
+     * @brief Render one slab
+     * @param volume Source volume
+     * @param orientation Slab orientation (normal = the orientation's slice axis)
+     * @param index Center plane index [0, MPRReslicer::getSliceCount-1]
+     * @param thickness Slab thickness in mm (a single plane if below the spacing)
+     * @param mode Projection mode
+     * @param output Reused output image
+     * @param pool Pool to split rows over (nullptr = global pool)
+     * @return false if the volume is invalid or the index out of range
+     */
+    bool render(const Volume3D& volume, MPRReslicer::Orientation orientation, int index, double thickness,
+                Mode mode, SliceImage& output, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Values the caller will display; the rest may be culled
+     *
+     * MIP results below low come out as low, and MinIP results above high come
+     * out as high. Averages are not culled. Without a range nothing is culled.
+     *
+     * @param low Lowest visible value (window bottom)
+     * @param high Highest visible value (window top)
+     */
+    void setVisibleRange(float low, float high);
+
+    /**
+     * @brief Stop culling
+     */
+    void clearVisibleRange();
+
+    /**
+     * @brief Drop all cached block projections
+     */
+    void clear();
+
+    /**
+     * @brief Bytes held by cached block projections
+     */
+    size_t getCacheMemoryUsage() const;
+
+private:
+    /**
+     * @brief What the cached blocks were computed from
+     */
+    struct CacheKey
+    {
+        uint64_t generation{0};  // Volume3D::generation; 0 = nothing cached
+        int width{0};
+        int height{0};
+        int depth{0};
+        Volume3D::VoxelType voxelType{Volume3D::VoxelType::Float32};
+        MPRReslicer::Orientation orientation{MPRReslicer::Orientation::Axial};
+        Mode mode{Mode::Maximum};
+        float low{0.0f};   // Culling bounds, part of every cached block
+        float high{0.0f};
+
+        bool operator==(const CacheKey& other) const;
+    };
+
+    template <Mode M, typename T>
+    void renderTyped(const VoxelView<T>& view, const Volume3D& volume, MPRReslicer::Orientation orientation,
+                     int first, int last, const unsigned char* occupied, SliceImage& output, ThreadPool& threads);
+
+    float m_visibleLow{std::numeric_limits<float>::lowest()};
+    float m_visibleHigh{std::numeric_limits<float>::max()};
+    std::vector<unsigned char> m_occupied;  // Per brick: 1 = may contribute under the visible range
+
+    CacheKey m_key;
+    std::unordered_map<int, std::vector<unsigned char>> m_blocks;  // Reduced plane per block index
+};
@@ -0,0 +1,215 @@
+#include "ThreadPool.h"
+#include <iterator>
+
+namespace {
+    // Identifies the pool (and worker slot) the current thread belongs to
+    thread_local const ThreadPool* t_currentPool = nullptr;
+    thread_local int t_workerIndex = -1;
+}
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+    const unsigned total = resolveThreadCount(threadCount);
+
+    // The thread that waits on a group acts as the last worker
+    m_workers.reserve(total - 1);
+    for (unsigned i = 0; i + 1 < total; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        m_workers[i]->thread = std::thread([this, i]() { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& worker : m_workers) {
+        if (worker->thread.joinable()) {
+            worker->thread.join();
+        }
+    }
+}
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+unsigned ThreadPool::resolveThreadCount(unsigned requested)
+{
+    if (requested > 0) {
+        return requested;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+int ThreadPool::getCurrentWorkerIndex() const
+{
+    return t_currentPool == this ? t_workerIndex : -1;
+}
+
+size_t ThreadPool::getChunkCount(size_t count, size_t minChunkSize) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    const size_t threads = getThreadCount();
+    if (threads == 1) {
+        return 1;
+    }
+
+    // A few chunks per thread lets stealing even out uneven chunk costs
+    const size_t maxChunks = std::max<size_t>(1, count / std::max<size_t>(1, minChunkSize));
+    return std::min(maxChunks, threads * 4);
+}
+
+void ThreadPool::run(TaskGroup& group, std::function<void()> task)
+{
+    group.m_pending.fetch_add(1);
+    Task entry{std::move(task), &group};
+
+    if (m_workers.empty()) {
+        execute(entry);
+        return;
+    }
+
+    // Workers push to their own deque; other threads spread tasks round-robin
+    const int self = getCurrentWorkerIndex();
+    const size_t queue = self >= 0 ? static_cast<size_t>(self)
+                                   : m_nextQueue.fetch_add(1) % m_workers.size();
+    {
+        std::lock_guard<std::mutex> lock(m_workers[queue]->mutex);
+        m_workers[queue]->tasks.push_back(std::move(entry));
+    }
+    group.m_queued.fetch_add(1);
+    m_queued.fetch_add(1);
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_one();
+    m_groupWake.notify_all();
+}
+
+void ThreadPool::wait(TaskGroup& group)
+{
+    const int self = getCurrentWorkerIndex();
+    const size_t preferred = self >= 0 ? static_cast<size_t>(self) : 0;
+
+    // Only this group's tasks: another group's task could reuse the caller's
+    // per-thread slot (see getCurrentWorkerIndex) while the caller still owns it
+    while (group.m_pending.load() > 0) {
+        Task task;
+        if (tryPop(preferred, task, &group)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_groupWake.wait(lock, [&group]() {
+            return group.m_pending.load() == 0 || group.m_queued.load() > 0;
+        });
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(group.m_errorMutex);
+        std::swap(error, group.m_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::workerLoop(size_t index)
+{
+    t_currentPool = this;
+    t_workerIndex = static_cast<int>(index);
+
+    for (;;) {
+        Task task;
+        if (tryPop(index, task)) {
+            execute(task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this]() { return m_stop || m_queued.load() > 0; });
+        if (m_stop && m_queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::tryPop(size_t preferred, Task& task, const TaskGroup* group)
+{
+    if (m_workers.empty() || (group ? group->m_queued.load() : m_queued.load()) == 0) {
+        return false;
+    }
+
+    const size_t count = m_workers.size();
+    preferred %= count;
+
+    auto take = [this, &task](std::deque<Task>& tasks, std::deque<Task>::iterator it) {
+        task = std::move(*it);
+        tasks.erase(it);
+        task.group->m_queued.fetch_sub(1);
+        m_queued.fetch_sub(1);
+    };
+    auto matches = [group](const Task& candidate) { return !group || candidate.group == group; };
+
+    // Own deque: newest task first (LIFO keeps recently touched data hot)
+    {
+        Worker& own = *m_workers[preferred];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        auto it = std::find_if(own.tasks.rbegin(), own.tasks.rend(), matches);
+        if (it != own.tasks.rend()) {
+            take(own.tasks, std::next(it).base());
+            return true;
+        }
+    }
+
+    // Steal the oldest task from the other deques
+    for (size_t offset = 1; offset < count; ++offset) {
+        Worker& victim = *m_workers[(preferred + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        auto it = std::find_if(victim.tasks.begin(), victim.tasks.end(), matches);
+        if (it != victim.tasks.end()) {
+            take(victim.tasks, it);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::execute(Task& task)
+{
+    TaskGroup* group = task.group;
+
+    try {
+        task.fn();
+    }
+    catch (...) {
+        std::lock_guard<std::mutex> lock(group->m_errorMutex);
+        if (!group->m_error) {
+            group->m_error = std::current_exception();
+        }
+    }
+
+    // The group may be destroyed as soon as its counter reaches zero
+    if (group->m_pending.fetch_sub(1) == 1) {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+        }
+        m_groupWake.notify_all();
+    }
+}
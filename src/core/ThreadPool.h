@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Work-stealing thread pool for CPU-bound batch work
+ *
+ * Each worker owns a task deque. A worker pops its own newest task first and,
+ * when idle, steals the oldest task from another worker. Tasks are tracked by
+ * a TaskGroup; the thread waiting on a group executes that group's queued tasks
+ * itself while it waits, so a pool of N threads runs N-1 workers plus the
+ * waiting thread and nested parallel sections cannot deadlock. A waiter never
+ * runs another group's tasks, so callers outside the pool can all treat the
+ * last slot as their own.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Set of tasks that can be waited on together
+     */
+    class TaskGroup
+    {
+    public:
+        TaskGroup() = default;
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+    private:
+        friend class ThreadPool;
+        std::atomic<size_t> m_pending{0};
+        std::atomic<size_t> m_queued{0};  // Pending tasks not yet taken from a deque
+        std::mutex m_errorMutex;
+        std::exception_ptr m_error;
+    };
+
+    /**
+     * @brief Create a pool
+     * @param threadCount Total concurrency including the waiting thread (0 = hardware threads)
+     */
+    explicit ThreadPool(unsigned threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Total concurrency of the pool (workers plus the waiting thread)
+     */
+    unsigned getThreadCount() const { return static_cast<unsigned>(m_workers.size()) + 1; }
+
+    /**
+     * @brief Queue a task in a group
+     *
+     * With a single-thread pool the task runs inline before run() returns.
+     */
+    void run(TaskGroup& group, std::function<void()> task);
+
+    /**
+     * @brief Block until every task in the group has finished
+     *
+     * The calling thread executes the group's queued tasks while waiting. The first exception
+     * thrown by a task of the group is rethrown here.
+     */
+    void wait(TaskGroup& group);
+
+    /**
+     * @brief Index of the calling thread among this pool's workers
+     * @return [0, getThreadCount() - 1) for workers, -1 for any other thread
+     */
+    int getCurrentWorkerIndex() const;
+
+    /**
+     * @brief Number of contiguous chunks parallelFor splits a range into
+     *
+     * Depends only on the range size and the pool size, so callers can size
+     * per-chunk partial results before running and merge them deterministically.
+     */
+    size_t getChunkCount(size_t count, size_t minChunkSize = 1) const;
+
+    /**
+     * @brief Run fn(chunkIndex, begin, end) over contiguous chunks of [0, count)
+     */
+    template <typename Fn>
+    void parallelFor(size_t count, Fn&& fn, size_t minChunkSize = 1);
+
+    /**
+     * @brief Process-wide pool sized to the hardware thread count
+     */
+    static ThreadPool& global();
+
+    /**
+     * @brief Map a requested thread count to an effective one (0 = hardware threads)
+     */
+    static unsigned resolveThreadCount(unsigned requested);
+
+private:
+    struct Task
+    {
+        std::function<void()> fn;
+        TaskGroup* group{nullptr};
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void workerLoop(size_t index);
+    bool tryPop(size_t preferred, Task& task, const TaskGroup* group = nullptr);
+    void execute(Task& task);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;        // Idle workers
+    std::condition_variable m_groupWake;   // Threads waiting on a group
+    std::atomic<size_t> m_queued{0};
+    std::atomic<size_t> m_nextQueue{0};
+    bool m_stop{false};
+};
+
+template <typename Fn>
+void ThreadPool::parallelFor(size_t count, Fn&& fn, size_t minChunkSize)
+{
+    const size_t chunks = getChunkCount(count, minChunkSize);
+    if (chunks <= 1) {
+        if (count > 0) {
+            fn(size_t{0}, size_t{0}, count);
+        }
+        return;
+    }
+
+    TaskGroup group;
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        const size_t begin = count * chunk / chunks;
+        const size_t end = count * (chunk + 1) / chunks;
+        run(group, [&fn, chunk, begin, end]() { fn(chunk, begin, end); });
+    }
+    wait(group);
+}
@@ -4,7 +4,58 @@
 #include <string>
 #include <memory>
 #include <cmath>
+#include <cstdint>
+#include <cstdlib>
 #include <limits>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+class BrickRangeGrid;
+class VolumeHistogram;
+
+/**
+ * @brief Typed read access to a volume's voxel buffer with its rescale
+ * 
+ * For native (integer) storage valueAt applies the modality rescale exactly like
+ * the float loader does, so both storage modes yield bit-identical values.
+ */
+template <typename T>
+struct VoxelView
+{
+    const T* data{nullptr};
+    double slope{1.0};
+    double intercept{0.0};
+    
+    float valueAt(size_t index) const
+    {
+        if constexpr (std::is_same_v<T, float>) {
+            return data[index];
+        } else {
+            return static_cast<float>(intercept + slope * static_cast<float>(data[index]));
+        }
+    }
+};
+
+/**
+ * @brief PET quantitation fields of a series, needed for SUV
+ * 
+ * Times are seconds since midnight of the Series Date (0008,0021); when the
+ * DICOM dates are present, intervals across midnight come out right. NaN
+ * means the tag was absent.
+ */
+struct PetAcquisition
+{
+    std::string units;              // Units (0054,1001): BQML, GML, CNTS, ...
+    std::string decayCorrection;    // Decay Correction (0054,1102): START, ADMIN or NONE
+    double patientWeight{0.0};      // Patient's Weight (0010,1030), kg
+    double injectedDose{0.0};       // Radionuclide Total Dose (0018,1074), Bq
+    double halfLife{0.0};           // Radionuclide Half Life (0018,1075), s
+    double injectionTime{std::numeric_limits<double>::quiet_NaN()};  // Radiopharmaceutical Start (Date)Time
+    double seriesTime{std::numeric_limits<double>::quiet_NaN()};     // Series Time (0008,0031)
+    std::vector<double> sliceAcquisitionTimes;  // Acquisition Time (0008,0032) per slice, in volume order
+};
 
 /**
  * @brief Volume3D represents a 3D scalar volume with correct LPS geometry
@@ -35,15 +86,47 @@ struct Volume3D
     double colDir[3]{0.0, 1.0, 0.0};      // Y direction (row/height direction)  
     double sliceDir[3]{0.0, 0.0, 1.0};    // Z direction (slice/depth direction)
     
+    /**
+     * @brief Element type of the voxel buffer
+     */
+    enum class VoxelType : uint8_t
+    {
+        Float32,  // Rescaled values in `voxels`
+        Int16,    // Stored DICOM values in storedVoxels, rescaled on access
+        UInt16,
+        UInt8
+    };
+    
     // Volume buffer (float32 normalized values)
     // Size = width * height * depth
     // Storage order: [z][y][x] - slice-major ordering
     std::vector<float> voxels;
     
+    // Native storage (voxelType != Float32): stored values in the same order,
+    // with storedSlope/storedIntercept applied on access. Copies share the
+    // block until one of them is written: setVoxel clones it first (copy-on-write).
+    VoxelType voxelType{VoxelType::Float32};
+    std::shared_ptr<void> storedVoxels;
+    double storedSlope{1.0};
+    double storedIntercept{0.0};
+    
+    // Identity of the voxel contents for caches keyed on a volume: a fresh id
+    // for every new volume, reallocation and setVoxel, and kept by copies
+    // (which hold the same contents). Unlike buffer addresses, never reused.
+    uint64_t generation{nextGeneration()};
+    
     // Value range information
     float vmin{0.0f};  // Minimum value in volume
     float vmax{0.0f};  // Maximum value in volume
     
+    // Per-16^3-brick value ranges for empty-space skipping (nullptr if not
+    // computed). Shared between copies; setVoxel drops it.
+    std::shared_ptr<const BrickRangeGrid> brickRanges;
+    
+    // Value histogram for percentiles / auto window (nullptr if not computed).
+    // Shared between copies; setVoxel drops it.
+    std::shared_ptr<const VolumeHistogram> histogram;
+    
     // DICOM metadata
     std::string modality;       // CT, MR, PT, etc.
     std::string patientID;
@@ -52,6 +135,9 @@ struct Volume3D
     std::string studyDate;
     std::string seriesDescription;
     
+    // PET quantitation (nullptr unless the series is PT). Shared between copies.
+    std::shared_ptr<const PetAcquisition> pet;
+    
     // Rescale parameters (for reference - already applied to voxel data)
     double rescaleIntercept{0.0};
     double rescaleSlope{1.0};
@@ -71,6 +157,98 @@ struct Volume3D
         voxels.resize(static_cast<size_t>(width) * height * depth, 0.0f);
     }
     
+    /**
+     * @brief New unique value for Volume3D::generation (thread-safe)
+     */
+    static uint64_t nextGeneration()
+    {
+        static std::atomic<uint64_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed) + 1;
+    }
+    
+    /**
+     * @brief Size of one voxel element in bytes for a storage type
+     */
+    static size_t getVoxelTypeSize(VoxelType type)
+    {
+        switch (type) {
+        case VoxelType::Int16:
+        case VoxelType::UInt16:
+            return 2;
+        case VoxelType::UInt8:
+            return 1;
+        default:
+            return sizeof(float);
+        }
+    }
+    
+    /**
+     * @brief Allocate native storage for the current dimensions
+     * 
+     * Releases the float buffer. The block is 64-byte aligned for SIMD access.
+     * 
+     * @param zeroed Return zeroed storage; large blocks come straight from the OS
+     *               as zero pages, so untouched pages are never committed
+     */
+    void allocateStoredVoxels(VoxelType type, double slope, double intercept, bool zeroed = false)
+    {
+        voxels.clear();
+        voxels.shrink_to_fit();
+        voxelType = type;
+        storedSlope = slope;
+        storedIntercept = intercept;
+        
+        const size_t bytes = getTotalVoxels() * getVoxelTypeSize(type);
+        storedVoxels = zeroed ? allocateZeroedStoredBlock(bytes) : allocateStoredBlock(bytes);
+        generation = nextGeneration();
+    }
+    
+    /**
+     * @brief Give this volume its own copy of a native block shared with other volumes
+     * 
+     * Called before any write through storedVoxels on a volume that may have
+     * been copied; a no-op when the block is not shared.
+     */
+    void detachStoredVoxels()
+    {
+        if (voxelType == VoxelType::Float32 || !storedVoxels || storedVoxels.use_count() <= 1) {
+            return;
+        }
+        const size_t bytes = getTotalVoxels() * getVoxelTypeSize(voxelType);
+        std::shared_ptr<void> block = allocateStoredBlock(bytes);
+        std::copy_n(static_cast<const char*>(storedVoxels.get()), bytes, static_cast<char*>(block.get()));
+        storedVoxels = std::move(block);
+    }
+    
+    /**
+     * @brief Bytes held by the voxel buffer
+     */
+    size_t getVoxelMemoryUsage() const
+    {
+        return voxelType == VoxelType::Float32 ? voxels.size() * sizeof(float)
+                                               : getTotalVoxels() * getVoxelTypeSize(voxelType);
+    }
+    
+    /**
+     * @brief Call fn(const VoxelView<T>&) with the typed voxel buffer
+     * 
+     * Lets kernels be written once as a template over the storage type.
+     */
+    template <typename Fn>
+    decltype(auto) visitVoxels(Fn&& fn) const
+    {
+        switch (voxelType) {
+        case VoxelType::Int16:
+            return fn(VoxelView<int16_t>{static_cast<const int16_t*>(storedVoxels.get()), storedSlope, storedIntercept});
+        case VoxelType::UInt16:
+            return fn(VoxelView<uint16_t>{static_cast<const uint16_t*>(storedVoxels.get()), storedSlope, storedIntercept});
+        case VoxelType::UInt8:
+            return fn(VoxelView<uint8_t>{static_cast<const uint8_t*>(storedVoxels.get()), storedSlope, storedIntercept});
+        default:
+            return fn(VoxelView<float>{voxels.data(), 1.0, 0.0});
+        }
+    }
+    
     /**
      * @brief Get total number of voxels
      */
@@ -84,7 +262,8 @@ struct Volume3D
      */
     bool isValid() const 
     {
-        return width > 0 && height > 0 && depth > 0 && !voxels.empty();
+        const bool hasData = voxelType == VoxelType::Float32 ? !voxels.empty() : storedVoxels != nullptr;
+        return width > 0 && height > 0 && depth > 0 && hasData;
     }
     
     /**
@@ -102,11 +281,18 @@ struct Volume3D
         size_t index = static_cast<size_t>(z) * width * height + 
                        static_cast<size_t>(y) * width + 
                        static_cast<size_t>(x);
-        return voxels[index];
+        if (voxelType == VoxelType::Float32) {
+            return voxels[index];
+        }
+        return visitVoxels([index](const auto& view) { return view.valueAt(index); });
     }
     
     /**
      * @brief Set voxel value at position (x, y, z)
+     * 
+     * For native storage the value is converted back to the nearest stored value
+     * (clamped to the stored type). A block shared with other copies is cloned
+     * first, so copies never see each other's edits.
      */
     void setVoxel(int x, int y, int z, float value) 
     {
@@ -116,7 +302,33 @@ struct Volume3D
         size_t index = static_cast<size_t>(z) * width * height + 
                        static_cast<size_t>(y) * width + 
                        static_cast<size_t>(x);
-        voxels[index] = value;
+        brickRanges.reset();
+        histogram.reset();
+        generation = nextGeneration();
+        if (voxelType == VoxelType::Float32) {
+            voxels[index] = value;
+            return;
+        }
+        
+        detachStoredVoxels();
+        const double stored = std::round((value - storedIntercept) / (storedSlope != 0.0 ? storedSlope : 1.0));
+        auto store = [&](auto* data) {
+            using T = std::remove_pointer_t<decltype(data)>;
+            const double clamped = std::min<double>(std::max<double>(stored, std::numeric_limits<T>::lowest()),
+                                                    std::numeric_limits<T>::max());
+            data[index] = static_cast<T>(clamped);
+        };
+        switch (voxelType) {
+        case VoxelType::Int16:
+            store(static_cast<int16_t*>(storedVoxels.get()));
+            break;
+        case VoxelType::UInt16:
+            store(static_cast<uint16_t*>(storedVoxels.get()));
+            break;
+        default:
+            store(static_cast<uint8_t*>(storedVoxels.get()));
+            break;
+        }
     }
     
     /**
@@ -201,4 +413,24 @@ struct Volume3D
         
         return true;
     }
+    
+private:
+    // 64-byte aligned for SIMD access
+    static std::shared_ptr<void> allocateStoredBlock(size_t bytes)
+    {
+        return std::shared_ptr<void>(::operator new(bytes, std::align_val_t(64)),
+                                     [](void* block) { ::operator delete(block, std::align_val_t(64)); });
+    }
+    
+    // calloc instead of new + memset: the allocator maps large blocks from fresh
+    // zero pages and skips clearing them, so pages are committed on first write
+    static std::shared_ptr<void> allocateZeroedStoredBlock(size_t bytes)
+    {
+        void* raw = std::calloc(1, bytes + 64);
+        if (!raw) {
+            throw std::bad_alloc();
+        }
+        const uintptr_t aligned = (reinterpret_cast<uintptr_t>(raw) + 63) & ~uintptr_t(63);
+        return std::shared_ptr<void>(reinterpret_cast<void*>(aligned), [raw](void*) { std::free(raw); });
+    }
 };
\ No newline at end of file
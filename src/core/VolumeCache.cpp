@@ -0,0 +1,514 @@
+#include "VolumeCache.h"
+#include "BinaryStream.h"
+#include "BrickRangeGrid.h"
+#include "VolumeHistogram.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr char kMagic[8] = {'A', 'M', 'P', 'R', 'V', 'O', 'L', '1'};
+    constexpr uint32_t kByteOrderMark = 0x01020304u;
+
+    /**
+     * @brief Read-only file mapping with private (copy-on-write) pages
+     */
+    class MappedFile
+    {
+    public:
+        ~MappedFile()
+        {
+#ifdef _WIN32
+            if (m_data) {
+                UnmapViewOfFile(m_data);
+            }
+#else
+            if (m_data) {
+                munmap(m_data, m_size);
+            }
+#endif
+        }
+
+        static std::shared_ptr<MappedFile> open(const std::string& path)
+        {
+            auto mapping = std::shared_ptr<MappedFile>(new MappedFile());
+#ifdef _WIN32
+            HANDLE file = CreateFileW(std::filesystem::path(path).wstring().c_str(), GENERIC_READ,
+                                      FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return nullptr;
+            }
+            LARGE_INTEGER size;
+            if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+                CloseHandle(file);
+                return nullptr;
+            }
+            HANDLE section = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (!section) {
+                return nullptr;
+            }
+            mapping->m_data = MapViewOfFile(section, FILE_MAP_COPY, 0, 0, 0);
+            CloseHandle(section);
+            if (!mapping->m_data) {
+                return nullptr;
+            }
+            mapping->m_size = static_cast<size_t>(size.QuadPart);
+#else
+            const int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                return nullptr;
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0 || info.st_size == 0) {
+                ::close(fd);
+                return nullptr;
+            }
+            const size_t size = static_cast<size_t>(info.st_size);
+            void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (data == MAP_FAILED) {
+                return nullptr;
+            }
+            mapping->m_data = data;
+            mapping->m_size = size;
+#endif
+            return mapping;
+        }
+
+        char* data() const { return static_cast<char*>(m_data); }
+        size_t size() const { return m_size; }
+
+    private:
+        MappedFile() = default;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        void* m_data{nullptr};
+        size_t m_size{0};
+    };
+
+    bool sameSources(const std::vector<VolumeCache::SourceFile>& a, const std::vector<VolumeCache::SourceFile>& b)
+    {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].fileSize != b[i].fileSize || a[i].modifiedTime != b[i].modifiedTime || a[i].path != b[i].path) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+thread_local std::string VolumeCache::s_lastError;
+
+std::string VolumeCache::getLastError()
+{
+    return s_lastError;
+}
+
+bool VolumeCache::getSourceFiles(const std::vector<std::string>& filePaths, std::vector<SourceFile>& sources)
+{
+    sources.clear();
+    sources.reserve(filePaths.size());
+
+    for (const auto& path : filePaths) {
+        std::error_code sizeError, timeError;
+        SourceFile source;
+        source.path = path;
+        source.fileSize = static_cast<uint64_t>(std::filesystem::file_size(path, sizeError));
+        source.modifiedTime = static_cast<int64_t>(
+            std::filesystem::last_write_time(path, timeError).time_since_epoch().count());
+        if (sizeError || timeError) {
+            s_lastError = "Cannot stat source file: " + path;
+            return false;
+        }
+        sources.push_back(std::move(source));
+    }
+    return true;
+}
+
+std::string VolumeCache::cachePathFor(const std::string& cacheDirectory,
+                                      const DicomSeriesLoader::SeriesInfo& seriesInfo,
+                                      bool nativeStorage)
+{
+    // FNV-1a over the series UID and its files: the same UID under another
+    // root (or a different slice selection) gets its own cache file
+    uint64_t hash = 14695981039346656037ull;
+    auto mix = [&hash](const std::string& text) {
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xff;
+        hash *= 1099511628211ull;
+    };
+    mix(seriesInfo.seriesUID);
+    for (const auto& path : seriesInfo.filePaths) {
+        mix(path);
+    }
+
+    std::ostringstream name;
+    name << "volume-" << std::hex << std::setw(16) << std::setfill('0') << hash
+         << (nativeStorage ? "-native" : "-float") << ".vol";
+    return (std::filesystem::path(cacheDirectory) / name.str()).string();
+}
+
+bool VolumeCache::load(const std::string& cachePath, const std::vector<SourceFile>& sources, Volume3D& volume)
+{
+    s_lastError.clear();
+
+    try {
+        std::error_code ec;
+        if (!std::filesystem::exists(cachePath, ec)) {
+            return false;
+        }
+
+        std::shared_ptr<MappedFile> mapping = MappedFile::open(cachePath);
+        if (!mapping) {
+            s_lastError = "Cannot map volume cache: " + cachePath;
+            return false;
+        }
+
+        // A file that fails validation will never hit again: delete it (unmapped
+        // first, as Windows refuses to delete mapped files)
+        auto reject = [&](const std::string& message) {
+            s_lastError = message;
+            mapping.reset();
+            std::error_code removeError;
+            std::filesystem::remove(cachePath, removeError);
+            return false;
+        };
+
+        BinaryReader in(mapping->data(), mapping->size());
+        char magic[sizeof(kMagic)];
+        uint32_t version = 0, byteOrder = 0;
+        uint8_t voxelType = 0;
+        if (!in.getRaw(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+            !in.get(version) || version != kFormatVersion ||
+            !in.get(byteOrder) || byteOrder != kByteOrderMark ||
+            !in.get(voxelType) || voxelType > static_cast<uint8_t>(Volume3D::VoxelType::UInt8)) {
+            return reject("Unrecognized volume cache format: " + cachePath);
+        }
+
+        Volume3D result;
+        int32_t dims[3] = {0, 0, 0};
+        uint8_t hasRescale = 0;
+        bool ok = in.getRaw(dims, sizeof(dims)) &&
+                  in.getRaw(result.spacing, sizeof(result.spacing)) &&
+                  in.getRaw(result.origin, sizeof(result.origin)) &&
+                  in.getRaw(result.rowDir, sizeof(result.rowDir)) &&
+                  in.getRaw(result.colDir, sizeof(result.colDir)) &&
+                  in.getRaw(result.sliceDir, sizeof(result.sliceDir)) &&
+                  in.get(result.storedSlope) && in.get(result.storedIntercept) &&
+                  in.get(result.vmin) && in.get(result.vmax) &&
+                  in.get(result.rescaleIntercept) && in.get(result.rescaleSlope) && in.get(hasRescale) &&
+                  in.getString(result.modality) && in.getString(result.patientID) &&
+                  in.getString(result.studyUID) && in.getString(result.seriesUID) &&
+                  in.getString(result.studyDate) && in.getString(result.seriesDescription);
+
+        uint8_t hasPet = 0;
+        ok = ok && in.get(hasPet);
+        if (ok && hasPet) {
+            auto pet = std::make_shared<PetAcquisition>();
+            uint32_t timeCount = 0;
+            ok = in.getString(pet->units) && in.getString(pet->decayCorrection) &&
+                 in.get(pet->patientWeight) && in.get(pet->injectedDose) && in.get(pet->halfLife) &&
+                 in.get(pet->injectionTime) && in.get(pet->seriesTime) && in.get(timeCount) &&
+                 timeCount <= static_cast<uint32_t>(std::max(dims[2], 0));
+            if (ok) {
+                pet->sliceAcquisitionTimes.resize(timeCount);
+                ok = in.getRaw(pet->sliceAcquisitionTimes.data(), timeCount * sizeof(double));
+            }
+            result.pet = std::move(pet);
+        }
+
+        uint32_t sourceCount = 0;
+        std::vector<SourceFile> recorded;
+        ok = ok && in.get(sourceCount);
+        for (uint32_t i = 0; ok && i < sourceCount; ++i) {
+            SourceFile source;
+            ok = in.getString(source.path) && in.get(source.fileSize) && in.get(source.modifiedTime);
+            recorded.push_back(std::move(source));
+        }
+
+        uint8_t hasBrickRanges = 0;
+        int32_t bricks[3] = {0, 0, 0};
+        std::vector<BrickRangeGrid::Range> brickRanges;
+        ok = ok && in.get(hasBrickRanges);
+        if (ok && hasBrickRanges) {
+            ok = in.getRaw(bricks, sizeof(bricks)) && bricks[0] > 0 && bricks[1] > 0 && bricks[2] > 0;
+            if (ok) {
+                brickRanges.resize(static_cast<size_t>(bricks[0]) * bricks[1] * bricks[2]);
+                ok = in.getRaw(brickRanges.data(), brickRanges.size() * sizeof(BrickRangeGrid::Range));
+            }
+        }
+
+        uint8_t hasHistogram = 0;
+        VolumeHistogram::Bins histogramBins;
+        ok = ok && in.get(hasHistogram);
+        if (ok && hasHistogram) {
+            uint8_t encoding = 0;
+            uint64_t binCount = 0;
+            ok = in.get(encoding) && in.get(histogramBins.firstKey) && in.get(histogramBins.slope) &&
+                 in.get(histogramBins.intercept) && in.get(binCount) && binCount > 0 && binCount <= (1 << 16);
+            if (ok) {
+                histogramBins.encoding = static_cast<VolumeHistogram::Encoding>(encoding);
+                histogramBins.counts.resize(binCount);
+                ok = in.getRaw(histogramBins.counts.data(), binCount * sizeof(uint64_t));
+            }
+        }
+
+        uint64_t dataOffset = 0, dataBytes = 0;
+        ok = ok && in.get(dataOffset) && in.get(dataBytes);
+        if (!ok || dims[0] <= 0 || dims[1] <= 0 || dims[2] <= 0) {
+            return reject("Corrupt volume cache header: " + cachePath);
+        }
+
+        if (!sameSources(recorded, sources)) {
+            return reject("Volume cache is stale: " + cachePath);
+        }
+
+        result.width = dims[0];
+        result.height = dims[1];
+        result.depth = dims[2];
+        result.hasRescaleParams = hasRescale != 0;
+        result.voxelType = static_cast<Volume3D::VoxelType>(voxelType);
+        if (hasBrickRanges) {
+            result.brickRanges = BrickRangeGrid::fromRanges(bricks, std::move(brickRanges));
+        }
+        if (hasHistogram) {
+            result.histogram = VolumeHistogram::fromBins(std::move(histogramBins));
+        }
+
+        const size_t expectedBytes = result.getTotalVoxels() * Volume3D::getVoxelTypeSize(result.voxelType);
+        if (dataBytes != expectedBytes || dataOffset % kDataAlignment != 0 ||
+            dataOffset > mapping->size() || mapping->size() - dataOffset < dataBytes) {
+            return reject("Corrupt volume cache data block: " + cachePath);
+        }
+
+        char* voxelData = mapping->data() + dataOffset;
+        if (result.voxelType == Volume3D::VoxelType::Float32) {
+            result.voxels.resize(result.getTotalVoxels());
+            std::memcpy(result.voxels.data(), voxelData, dataBytes);
+        } else {
+            // The voxel block keeps the whole mapping alive
+            result.storedVoxels = std::shared_ptr<void>(mapping, voxelData);
+        }
+
+        // Last use for pruning (mtime, as atime is often not maintained)
+        std::filesystem::last_write_time(cachePath, std::filesystem::file_time_type::clock::now(), ec);
+
+        volume = std::move(result);
+        return true;
+    }
+    catch (const std::exception& e) {
+        s_lastError = std::string("Exception loading volume cache: ") + e.what();
+        return false;
+    }
+}
+
+bool VolumeCache::save(const std::string& cachePath, const std::vector<SourceFile>& sources, const Volume3D& volume)
+{
+    s_lastError.clear();
+
+    if (!volume.isValid()) {
+        s_lastError = "Cannot cache an invalid volume";
+        return false;
+    }
+
+    try {
+        const int32_t dims[3] = {volume.width, volume.height, volume.depth};
+
+        BinaryWriter out;
+        out.putRaw(kMagic, sizeof(kMagic));
+        out.put(kFormatVersion);
+        out.put(kByteOrderMark);
+        out.put(static_cast<uint8_t>(volume.voxelType));
+        out.putRaw(dims, sizeof(dims));
+        out.putRaw(volume.spacing, sizeof(volume.spacing));
+        out.putRaw(volume.origin, sizeof(volume.origin));
+        out.putRaw(volume.rowDir, sizeof(volume.rowDir));
+        out.putRaw(volume.colDir, sizeof(volume.colDir));
+        out.putRaw(volume.sliceDir, sizeof(volume.sliceDir));
+        out.put(volume.storedSlope);
+        out.put(volume.storedIntercept);
+        out.put(volume.vmin);
+        out.put(volume.vmax);
+        out.put(volume.rescaleIntercept);
+        out.put(volume.rescaleSlope);
+        out.put(static_cast<uint8_t>(volume.hasRescaleParams ? 1 : 0));
+        out.putString(volume.modality);
+        out.putString(volume.patientID);
+        out.putString(volume.studyUID);
+        out.putString(volume.seriesUID);
+        out.putString(volume.studyDate);
+        out.putString(volume.seriesDescription);
+
+        out.put(static_cast<uint8_t>(volume.pet ? 1 : 0));
+        if (volume.pet) {
+            const PetAcquisition& pet = *volume.pet;
+            out.putString(pet.units);
+            out.putString(pet.decayCorrection);
+            out.put(pet.patientWeight);
+            out.put(pet.injectedDose);
+            out.put(pet.halfLife);
+            out.put(pet.injectionTime);
+            out.put(pet.seriesTime);
+            out.put(static_cast<uint32_t>(pet.sliceAcquisitionTimes.size()));
+            out.putRaw(pet.sliceAcquisitionTimes.data(), pet.sliceAcquisitionTimes.size() * sizeof(double));
+        }
+
+        out.put(static_cast<uint32_t>(sources.size()));
+        for (const auto& source : sources) {
+            out.putString(source.path);
+            out.put(source.fileSize);
+            out.put(source.modifiedTime);
+        }
+
+        out.put(static_cast<uint8_t>(volume.brickRanges ? 1 : 0));
+        if (volume.brickRanges) {
+            const BrickRangeGrid& grid = *volume.brickRanges;
+            const int32_t bricks[3] = {grid.getBrickCount(0), grid.getBrickCount(1), grid.getBrickCount(2)};
+            out.putRaw(bricks, sizeof(bricks));
+            out.putRaw(grid.getRanges().data(), grid.getRanges().size() * sizeof(BrickRangeGrid::Range));
+        }
+
+        out.put(static_cast<uint8_t>(volume.histogram ? 1 : 0));
+        if (volume.histogram) {
+            const VolumeHistogram::Bins& bins = volume.histogram->getBins();
+            out.put(static_cast<uint8_t>(bins.encoding));
+            out.put(bins.firstKey);
+            out.put(bins.slope);
+            out.put(bins.intercept);
+            out.put(static_cast<uint64_t>(bins.counts.size()));
+            out.putRaw(bins.counts.data(), bins.counts.size() * sizeof(uint64_t));
+        }
+
+        // The offset field itself is part of the header, so size it in before aligning
+        const uint64_t dataBytes = volume.getVoxelMemoryUsage();
+        const size_t headerSize = out.data().size() + 2 * sizeof(uint64_t);
+        const uint64_t dataOffset = (headerSize + kDataAlignment - 1) / kDataAlignment * kDataAlignment;
+        out.put(dataOffset);
+        out.put(dataBytes);
+        out.alignTo(kDataAlignment);
+
+        const void* voxelData = volume.voxelType == Volume3D::VoxelType::Float32
+            ? static_cast<const void*>(volume.voxels.data())
+            : volume.storedVoxels.get();
+
+        const std::filesystem::path target(cachePath);
+        if (target.has_parent_path()) {
+            std::filesystem::create_directories(target.parent_path());
+        }
+
+        const std::filesystem::path temporary = makeTemporaryPath(target);
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file) {
+                s_lastError = "Cannot write volume cache: " + temporary.string();
+                return false;
+            }
+            file.write(out.data().data(), static_cast<std::streamsize>(out.data().size()));
+            file.write(static_cast<const char*>(voxelData), static_cast<std::streamsize>(dataBytes));
+            if (!file) {
+                s_lastError = "Cannot write volume cache: " + temporary.string();
+                file.close();
+                std::filesystem::remove(temporary);
+                return false;
+            }
+        }
+        std::error_code renameError;
+        std::filesystem::rename(temporary, target, renameError);
+        if (renameError) {
+            // e.g. the target is still mapped on Windows
+            s_lastError = "Cannot replace volume cache " + target.string() + ": " + renameError.message();
+            std::filesystem::remove(temporary, renameError);
+            return false;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        s_lastError = std::string("Exception saving volume cache: ") + e.what();
+        return false;
+    }
+}
+
+uint64_t VolumeCache::prune(const std::string& cacheDirectory, uint64_t maxBytes, const std::string& keepPath)
+{
+    struct Entry
+    {
+        std::filesystem::path path;
+        uint64_t bytes{0};
+        std::filesystem::file_time_type lastUse;
+    };
+
+    std::error_code ec;
+    std::vector<Entry> entries;
+    uint64_t totalBytes = 0;
+    const auto orphanTime = std::filesystem::file_time_type::clock::now() - std::chrono::hours(24);
+    for (std::filesystem::directory_iterator it(cacheDirectory, ec), end; !ec && it != end; it.increment(ec)) {
+        std::error_code statError;
+        if (!it->is_regular_file(statError)) {
+            continue;
+        }
+        if (it->path().extension() == ".tmp") {
+            // Left behind by a writer that died; live writes finish long before this
+            if (it->last_write_time(statError) < orphanTime && !statError) {
+                std::filesystem::remove(it->path(), statError);
+            }
+            continue;
+        }
+        if (it->path().extension() != ".vol") {
+            continue;
+        }
+        Entry entry;
+        entry.path = it->path();
+        entry.bytes = static_cast<uint64_t>(it->file_size(statError));
+        entry.lastUse = it->last_write_time(statError);
+        if (statError) {
+            continue;
+        }
+        totalBytes += entry.bytes;
+        entries.push_back(std::move(entry));
+    }
+
+    // Least recently used first
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+
+    const std::filesystem::path keep(keepPath);
+    uint64_t removedBytes = 0;
+    for (const Entry& entry : entries) {
+        if (totalBytes - removedBytes <= maxBytes) {
+            break;
+        }
+        if (!keepPath.empty() && entry.path == keep) {
+            continue;
+        }
+        // Fails for files still mapped on Windows; they go on a later prune
+        std::error_code removeError;
+        if (std::filesystem::remove(entry.path, removeError)) {
+            removedBytes += entry.bytes;
+            std::cout << "Pruned volume cache: " << entry.path.string() << std::endl;
+        }
+    }
+    return removedBytes;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "DicomSeriesLoader.h"
+#include "Volume3D.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * @brief On-disk cache of loaded volumes, memory-mapped on reopen
+ *
+ * After a series has been decoded once, its Volume3D is written as a single
+ * file: header (geometry, value range, rescale, metadata, source file list)
+ * followed by the raw voxel block at a page-aligned offset. Reopening maps the
+ * file instead of decoding DICOM again. Native-storage volumes use the mapped
+ * pages directly (copy-on-write, so setVoxel stays legal), which also lets
+ * several viewer instances share them through the OS page cache; float32
+ * volumes are copied out of the mapping into Volume3D::voxels.
+ *
+ * The source files' paths, sizes and mtimes are recorded, and a cache whose
+ * sources no longer match is treated as a miss, deleted, and rebuilt by the
+ * caller. A hit refreshes the file's mtime, which prune() uses to evict the
+ * least recently used files once the directory exceeds a byte budget.
+ *
+ * File layout (native byte order, version checked on load):
+ *   magic "AMPRVOL1", u32 version, u32 byte-order mark, u8 voxel type,
+ *   dimensions, spacing, origin, direction vectors, stored slope/intercept,
+ *   value range, rescale, metadata strings,
+ *   u8 has PET [, units, decay correction, f64 weight/dose/half-life/injection
+ *   time/series time, u32 count, f64 acquisition time per slice], source list,
+ *   u8 has brick ranges [, i32 brick counts[3], float min/max per brick],
+ *   u8 has histogram [, u8 encoding, i32 first key, f64 slope, f64 intercept,
+ *   u64 bin count, u64 count per bin],
+ *   u64 voxel offset, u64 voxel bytes, padding, voxel block
+ */
+class VolumeCache
+{
+public:
+    /**
+     * @brief Identity of one source file at the time the volume was built
+     */
+    struct SourceFile
+    {
+        std::string path;
+        uint64_t fileSize{0};
+        int64_t modifiedTime{0};  // std::filesystem::file_time_type ticks
+    };
+
+    /**
+     * @brief Current size/mtime of a series' files
+     * @param filePaths Files of the series, in series order
+     * @param sources Output source list
+     * @return false if any file cannot be stat'ed
+     */
+    static bool getSourceFiles(const std::vector<std::string>& filePaths, std::vector<SourceFile>& sources);
+
+    /**
+     * @brief Map a cached volume if it is still valid for the given sources
+     * @param cachePath Cache file path
+     * @param sources Current source files (must match the recorded list exactly)
+     * @param volume Output volume
+     * @return true on a cache hit; a file that fails validation is deleted
+     */
+    static bool load(const std::string& cachePath, const std::vector<SourceFile>& sources, Volume3D& volume);
+
+    /**
+     * @brief Write a volume atomically (uniquely named temporary file + rename)
+     * @return true on success
+     */
+    static bool save(const std::string& cachePath, const std::vector<SourceFile>& sources, const Volume3D& volume);
+
+    /**
+     * @brief Delete least recently used cache files until the directory fits a budget
+     *
+     * Also removes temporary files more than a day old left by interrupted saves.
+     *
+     * @param cacheDirectory Cache directory
+     * @param maxBytes Byte budget for all .vol files in the directory
+     * @param keepPath File never deleted (e.g. the one just written), or empty
+     * @return Bytes deleted
+     */
+    static uint64_t prune(const std::string& cacheDirectory, uint64_t maxBytes,
+                          const std::string& keepPath = std::string());
+
+    /**
+     * @brief Cache file location for a series and storage mode inside a cache directory
+     */
+    static std::string cachePathFor(const std::string& cacheDirectory,
+                                    const DicomSeriesLoader::SeriesInfo& seriesInfo,
+                                    bool nativeStorage);
+
+    /**
+     * @brief Get the last error message of the calling thread
+     *
+     * Per thread, as spills and loads write caches concurrently.
+     */
+    static std::string getLastError();
+
+    static constexpr uint32_t kFormatVersion = 4;
+
+    // Voxel block alignment; a multiple of the page size on all supported platforms
+    static constexpr size_t kDataAlignment = 4096;
+
+private:
+    static thread_local std::string s_lastError;
+};
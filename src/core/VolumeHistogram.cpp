@@ -0,0 +1,290 @@
+#include "VolumeHistogram.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+namespace {
+    using Encoding = VolumeHistogram::Encoding;
+
+    /**
+     * @brief Float bit pattern as an unsigned key with the same order as the values
+     */
+    inline uint32_t orderedKey(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    }
+
+    inline float fromOrderedKey(uint32_t key)
+    {
+        const uint32_t bits = (key & 0x80000000u) ? key & 0x7FFFFFFFu : ~key;
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    constexpr size_t kSplit = 4;
+
+    /**
+     * @brief Count values into 4 interleaved tables of keyCount bins each
+     */
+    template <typename T>
+    void countValues(const T* data, size_t count, int32_t keyOffset, size_t keyCount, uint32_t* counts)
+    {
+        auto key = [keyOffset](T value) -> uint32_t {
+            if constexpr (std::is_same_v<T, float>) {
+                return orderedKey(value) >> 16;
+            } else {
+                return static_cast<uint32_t>(static_cast<int32_t>(value) - keyOffset);
+            }
+        };
+
+        uint32_t* counts0 = counts;
+        uint32_t* counts1 = counts + keyCount;
+        uint32_t* counts2 = counts + 2 * keyCount;
+        uint32_t* counts3 = counts + 3 * keyCount;
+        size_t i = 0;
+        for (; i + kSplit <= count; i += kSplit) {
+            ++counts0[key(data[i])];
+            ++counts1[key(data[i + 1])];
+            ++counts2[key(data[i + 2])];
+            ++counts3[key(data[i + 3])];
+        }
+        for (; i < count; ++i) {
+            ++counts0[key(data[i])];
+        }
+    }
+}
+
+VolumeHistogram::Builder::Builder(const Volume3D& volume, size_t partialCount)
+    : m_slope(volume.storedSlope)
+    , m_intercept(volume.storedIntercept)
+    , m_partials(std::max<size_t>(1, partialCount))
+{
+    switch (volume.voxelType) {
+    case Volume3D::VoxelType::Int16:
+        m_keyOffset = std::numeric_limits<int16_t>::min();
+        m_keyCount = 1 << 16;
+        break;
+    case Volume3D::VoxelType::UInt16:
+        m_keyCount = 1 << 16;
+        break;
+    case Volume3D::VoxelType::UInt8:
+        m_keyCount = 1 << 8;
+        break;
+    default:
+        m_encoding = Encoding::FloatBits;
+        m_keyCount = 1 << 16;
+        m_slope = 1.0;
+        m_intercept = 0.0;
+        break;
+    }
+}
+
+size_t VolumeHistogram::Builder::getPoolPartial(const ThreadPool& pool)
+{
+    // Workers first, then the thread waiting in parallelFor
+    const int worker = pool.getCurrentWorkerIndex();
+    return worker >= 0 ? static_cast<size_t>(worker) : pool.getThreadCount() - 1;
+}
+
+void VolumeHistogram::Builder::addSlice(const Volume3D& volume, int z, size_t partial)
+{
+    if (z < 0 || z >= volume.depth || partial >= m_partials.size()) {
+        return;
+    }
+    Partial& counts = m_partials[partial];
+    const size_t sliceSize = static_cast<size_t>(volume.width) * volume.height;
+    if (counts.split.empty()) {
+        counts.split.assign(kSplit * m_keyCount, 0);
+    }
+    if (counts.pending + sliceSize > std::numeric_limits<uint32_t>::max()) {
+        if (counts.total.empty()) {
+            counts.total.assign(m_keyCount, 0);
+        }
+        fold(counts, counts.total);
+        std::fill(counts.split.begin(), counts.split.end(), 0);
+        counts.pending = 0;
+    }
+    volume.visitVoxels([&](const auto& view) {
+        countValues(view.data + static_cast<size_t>(z) * sliceSize, sliceSize, m_keyOffset, m_keyCount,
+                    counts.split.data());
+    });
+    counts.pending += sliceSize;
+}
+
+void VolumeHistogram::Builder::fold(const Partial& partial, std::vector<uint64_t>& total) const
+{
+    for (size_t table = 0; table < kSplit; ++table) {
+        const uint32_t* counts = partial.split.data() + table * m_keyCount;
+        for (size_t key = 0; key < m_keyCount; ++key) {
+            total[key] += counts[key];
+        }
+    }
+}
+
+std::shared_ptr<const VolumeHistogram> VolumeHistogram::Builder::build() const
+{
+    std::vector<uint64_t> merged(m_keyCount, 0);
+    bool counted = false;
+    for (const auto& partial : m_partials) {
+        if (partial.split.empty()) {
+            continue;
+        }
+        counted = true;
+        fold(partial, merged);
+        for (size_t key = 0; key < partial.total.size(); ++key) {
+            merged[key] += partial.total[key];
+        }
+    }
+    if (!counted) {
+        return nullptr;
+    }
+    if (m_encoding == Encoding::FloatBits) {
+        // NaN bit patterns sort beyond +/-infinity
+        std::fill(merged.begin(), merged.begin() + 0x007F, 0);
+        std::fill(merged.begin() + 0xFF81, merged.end(), 0);
+    }
+
+    // Trim to the occupied keys
+    size_t first = 0;
+    size_t last = m_keyCount;
+    while (first < last && merged[first] == 0) {
+        ++first;
+    }
+    while (last > first && merged[last - 1] == 0) {
+        --last;
+    }
+
+    Bins bins;
+    bins.encoding = m_encoding;
+    bins.firstKey = m_keyOffset + static_cast<int32_t>(first);
+    bins.slope = m_slope;
+    bins.intercept = m_intercept;
+    bins.counts.assign(merged.begin() + first, merged.begin() + last);
+    return fromBins(std::move(bins));
+}
+
+std::shared_ptr<const VolumeHistogram> VolumeHistogram::fromVolume(const Volume3D& volume, ThreadPool* pool)
+{
+    if (!volume.isValid()) {
+        return nullptr;
+    }
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    Builder builder(volume, threads.getThreadCount());
+    threads.parallelFor(static_cast<size_t>(volume.depth), [&](size_t, size_t begin, size_t end) {
+        const size_t partial = Builder::getPoolPartial(threads);
+        for (size_t z = begin; z < end; ++z) {
+            builder.addSlice(volume, static_cast<int>(z), partial);
+        }
+    });
+    return builder.build();
+}
+
+std::shared_ptr<const VolumeHistogram> VolumeHistogram::fromBins(Bins bins)
+{
+    const int32_t minKey = bins.encoding == Encoding::FloatBits ? 0 : std::numeric_limits<int16_t>::min();
+    if (bins.counts.empty() || bins.firstKey < minKey ||
+        bins.firstKey + static_cast<int64_t>(bins.counts.size()) > (1 << 16)) {
+        return nullptr;
+    }
+
+    auto histogram = std::make_shared<VolumeHistogram>();
+    histogram->m_descending = bins.encoding == Encoding::Stored && bins.slope < 0.0;
+    histogram->m_bins = std::move(bins);
+
+    const size_t binCount = histogram->m_bins.counts.size();
+    histogram->m_cumulative.resize(binCount + 1);
+    histogram->m_cumulative[0] = 0;
+    for (size_t bin = 0; bin < binCount; ++bin) {
+        histogram->m_cumulative[bin + 1] =
+            histogram->m_cumulative[bin] + histogram->m_bins.counts[histogram->keyIndex(bin)];
+    }
+    return histogram;
+}
+
+float VolumeHistogram::getBinLow(size_t bin) const
+{
+    const int32_t key = m_bins.firstKey + static_cast<int32_t>(keyIndex(bin));
+    if (m_bins.encoding == Encoding::FloatBits) {
+        return fromOrderedKey(static_cast<uint32_t>(key) << 16);
+    }
+    return static_cast<float>(m_bins.intercept + m_bins.slope * static_cast<float>(key));
+}
+
+float VolumeHistogram::getBinHigh(size_t bin) const
+{
+    if (m_bins.encoding == Encoding::FloatBits) {
+        const int32_t key = m_bins.firstKey + static_cast<int32_t>(keyIndex(bin));
+        const float high = fromOrderedKey((static_cast<uint32_t>(key) << 16) | 0xFFFFu);
+        return std::isnan(high) ? std::numeric_limits<float>::infinity() : high;
+    }
+    return getBinLow(bin);
+}
+
+void VolumeHistogram::getBinRange(float low, float high, size_t& begin, size_t& end) const
+{
+    // Bin bounds grow with the bin index, so both ends are binary searches
+    size_t lo = 0, hi = getBinCount();
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (getBinHigh(mid) < low) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    begin = lo;
+
+    hi = getBinCount();
+    while (lo < hi) {
+        const size_t mid = (lo + hi) / 2;
+        if (getBinLow(mid) <= high) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    end = lo;
+}
+
+uint64_t VolumeHistogram::getCount(float low, float high) const
+{
+    size_t begin = 0, end = 0;
+    getBinRange(low, high, begin, end);
+    return m_cumulative[end] - m_cumulative[begin];
+}
+
+bool VolumeHistogram::getPercentile(double percent, float& value, float low, float high) const
+{
+    size_t begin = 0, end = 0;
+    getBinRange(low, high, begin, end);
+    const uint64_t count = m_cumulative[end] - m_cumulative[begin];
+    if (count == 0) {
+        return false;
+    }
+
+    // Nearest rank, 1-based, within the range
+    const double fraction = std::clamp(percent, 0.0, 100.0) / 100.0;
+    const uint64_t rank = std::clamp<uint64_t>(static_cast<uint64_t>(std::ceil(fraction * count)), 1, count);
+    const uint64_t target = m_cumulative[begin] + rank;
+    const size_t bin = static_cast<size_t>(
+        std::lower_bound(m_cumulative.begin() + begin + 1, m_cumulative.begin() + end + 1, target) -
+        m_cumulative.begin()) - 1;
+
+    if (m_bins.encoding == Encoding::FloatBits) {
+        // Spread the bin's voxels evenly over its width
+        const double inBin = (static_cast<double>(target - m_cumulative[bin]) - 0.5) / getBinFrequency(bin);
+        const float binLow = getBinLow(bin);
+        const float binHigh = std::min(getBinHigh(bin), std::numeric_limits<float>::max());
+        value = static_cast<float>(binLow + (static_cast<double>(binHigh) - binLow) * inBin);
+    } else {
+        value = getBinLow(bin);
+    }
+    value = std::clamp(value, low, high);
+    return true;
+}
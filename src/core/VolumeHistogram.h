@@ -0,0 +1,184 @@
+#pragma once
+
+#include "Volume3D.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief Value histogram of a whole volume with percentile queries
+ *
+ * Native-storage volumes are counted exactly, one bin per stored value (at
+ * most 65536 bins, trimmed to the occupied range). Float volumes use 65536
+ * bins over the float bit pattern: sign, exponent and the top 7 mantissa
+ * bits, i.e. bins of 1/128 relative width at any magnitude, without knowing
+ * the value range in advance.
+ *
+ * The loader counts while decoding: every decode thread fills its own partial
+ * histogram, and build() merges the partials. Queries run on cumulative counts
+ * in value order, so a percentile is a binary search.
+ */
+class VolumeHistogram
+{
+public:
+    /**
+     * @brief How bins map to values
+     */
+    enum class Encoding : uint8_t
+    {
+        Stored,     // One bin per stored value, rescaled with slope/intercept
+        FloatBits   // Top 16 bits of the order-preserving float bit pattern
+    };
+
+    /**
+     * @brief Raw bin counts in key order, as computed and as stored in the volume cache
+     */
+    struct Bins
+    {
+        Encoding encoding{Encoding::Stored};
+        int32_t firstKey{0};   // Stored value (or float bin) of counts[0]
+        double slope{1.0};
+        double intercept{0.0};
+        std::vector<uint64_t> counts;
+    };
+
+    /**
+     * @brief Collects partial histograms during decoding
+     */
+    class Builder
+    {
+    public:
+        Builder() = default;
+
+        /**
+         * @brief Size the builder for a volume's storage type
+         * @param partialCount Number of partial histograms (one per decoding thread)
+         */
+        Builder(const Volume3D& volume, size_t partialCount);
+
+        /**
+         * @brief Partial of the calling thread for a builder sized to a pool's thread count
+         */
+        static size_t getPoolPartial(const ThreadPool& pool);
+
+        /**
+         * @brief Count one decoded slice into a partial histogram
+         *
+         * Safe to call concurrently as long as each thread uses its own partial.
+         */
+        void addSlice(const Volume3D& volume, int z, size_t partial);
+
+        /**
+         * @brief Merge the partials
+         * @return Histogram, or nullptr if nothing was counted
+         */
+        std::shared_ptr<const VolumeHistogram> build() const;
+
+    private:
+        /**
+         * @brief One thread's counts
+         *
+         * Counting goes to 4 interleaved 32-bit tables, so neighbouring voxels with
+         * the same value do not wait on each other's increment; they are folded
+         * into the 64-bit totals before they could overflow, and in build().
+         */
+        struct Partial
+        {
+            std::vector<uint32_t> split;  // [4][key]
+            std::vector<uint64_t> total;  // [key], allocated on the first fold
+            uint64_t pending{0};          // Voxels in split since the last fold
+        };
+
+        void fold(const Partial& partial, std::vector<uint64_t>& total) const;
+
+        Encoding m_encoding{Encoding::Stored};
+        int32_t m_keyOffset{0};
+        size_t m_keyCount{0};
+        double m_slope{1.0};
+        double m_intercept{0.0};
+        std::vector<Partial> m_partials;  // Allocated by their owner on first use
+    };
+
+    /**
+     * @brief Histogram of an already loaded volume, computed in parallel
+     * @param pool Pool to split slices over (nullptr = global pool)
+     */
+    static std::shared_ptr<const VolumeHistogram> fromVolume(const Volume3D& volume, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Rebuild a histogram from stored bins (e.g. the volume cache)
+     * @return Histogram, or nullptr if the bins are empty or out of range
+     */
+    static std::shared_ptr<const VolumeHistogram> fromBins(Bins bins);
+
+    /**
+     * @brief Number of voxels counted
+     */
+    uint64_t getTotalCount() const { return m_cumulative.back(); }
+
+    /**
+     * @brief Number of voxels in [low, high], to bin resolution
+     */
+    uint64_t getCount(float low, float high) const;
+
+    /**
+     * @brief Value below which a given share of the voxels in [low, high] lies
+     *
+     * Exact for native storage; float bins are interpolated linearly. The
+     * range excludes padding and outliers, e.g. [-1000, 3000] for CT.
+     *
+     * @param percent Percentile in [0, 100]
+     * @param value Output value
+     * @param low Lowest value counted
+     * @param high Highest value counted
+     * @return false if no voxel lies in [low, high]
+     */
+    bool getPercentile(double percent, float& value,
+                       float low = std::numeric_limits<float>::lowest(),
+                       float high = std::numeric_limits<float>::max()) const;
+
+    /**
+     * @brief Number of bins (value order)
+     */
+    size_t getBinCount() const { return m_bins.counts.size(); }
+
+    /**
+     * @brief Lowest and highest value of a bin in value order (equal for native storage)
+     */
+    float getBinLow(size_t bin) const;
+    float getBinHigh(size_t bin) const;
+
+    /**
+     * @brief Voxel count of a bin in value order
+     */
+    uint64_t getBinFrequency(size_t bin) const { return m_cumulative[bin + 1] - m_cumulative[bin]; }
+
+    /**
+     * @brief Raw bins (key order)
+     */
+    const Bins& getBins() const { return m_bins; }
+
+    /**
+     * @brief Bytes held by the histogram
+     */
+    size_t getMemoryUsage() const
+    {
+        return (m_bins.counts.size() + m_cumulative.size()) * sizeof(uint64_t);
+    }
+
+private:
+    size_t keyIndex(size_t bin) const { return m_descending ? m_bins.counts.size() - 1 - bin : bin; }
+
+    /**
+     * @brief Bins in value order that may hold values in [low, high]
+     */
+    void getBinRange(float low, float high, size_t& begin, size_t& end) const;
+
+    Bins m_bins;
+    bool m_descending{false};            // Negative slope: key order is reverse value order
+    std::vector<uint64_t> m_cumulative;  // [bin] = voxels in value-order bins before it
+};
@@ -0,0 +1,191 @@
+#include "VolumePyramid.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <type_traits>
+
+namespace {
+    /**
+     * @brief Copy geometry and metadata, leaving the voxel buffers empty
+     */
+    void copyHeader(const Volume3D& source, Volume3D& target)
+    {
+        target.width = source.width;
+        target.height = source.height;
+        target.depth = source.depth;
+        for (int i = 0; i < 3; ++i) {
+            target.spacing[i] = source.spacing[i];
+            target.origin[i] = source.origin[i];
+            target.rowDir[i] = source.rowDir[i];
+            target.colDir[i] = source.colDir[i];
+            target.sliceDir[i] = source.sliceDir[i];
+        }
+        target.vmin = source.vmin;
+        target.vmax = source.vmax;
+        target.modality = source.modality;
+        target.patientID = source.patientID;
+        target.studyUID = source.studyUID;
+        target.seriesUID = source.seriesUID;
+        target.studyDate = source.studyDate;
+        target.seriesDescription = source.seriesDescription;
+        if (source.pet) {
+            // Acquisition times belong to the source slices, not to the new grid
+            auto pet = std::make_shared<PetAcquisition>(*source.pet);
+            pet->sliceAcquisitionTimes.clear();
+            target.pet = std::move(pet);
+        }
+        target.rescaleIntercept = source.rescaleIntercept;
+        target.rescaleSlope = source.rescaleSlope;
+        target.hasRescaleParams = source.hasRescaleParams;
+    }
+
+    /**
+     * @brief 2x2x2 box filter; the far edge of odd dimensions repeats the last voxel
+     *
+     * Integer types are averaged in int32 and rounded half up, so a level keeps
+     * the stored type and rescale of its source.
+     */
+    template <typename T>
+    void downsample(const T* source, int width, int height, int depth, T* target,
+                    int targetWidth, int targetHeight, int targetDepth, ThreadPool& threads)
+    {
+        const size_t sourceSlice = static_cast<size_t>(width) * height;
+        const size_t targetSlice = static_cast<size_t>(targetWidth) * targetHeight;
+
+        threads.parallelFor(static_cast<size_t>(targetDepth), [&](size_t, size_t begin, size_t end) {
+            for (size_t z = begin; z < end; ++z) {
+                const size_t z0 = 2 * z;
+                const size_t z1 = std::min<size_t>(z0 + 1, depth - 1);
+                for (int y = 0; y < targetHeight; ++y) {
+                    const size_t y0 = 2 * static_cast<size_t>(y);
+                    const size_t y1 = std::min<size_t>(y0 + 1, height - 1);
+                    const T* r00 = source + z0 * sourceSlice + y0 * width;
+                    const T* r01 = source + z0 * sourceSlice + y1 * width;
+                    const T* r10 = source + z1 * sourceSlice + y0 * width;
+                    const T* r11 = source + z1 * sourceSlice + y1 * width;
+                    T* out = target + z * targetSlice + static_cast<size_t>(y) * targetWidth;
+
+                    for (int x = 0; x < targetWidth; ++x) {
+                        const int x0 = 2 * x;
+                        const int x1 = std::min(x0 + 1, width - 1);
+                        if constexpr (std::is_same_v<T, float>) {
+                            const float sum = r00[x0] + r00[x1] + r01[x0] + r01[x1] +
+                                              r10[x0] + r10[x1] + r11[x0] + r11[x1];
+                            out[x] = sum * 0.125f;
+                        } else {
+                            const int32_t sum = int32_t(r00[x0]) + r00[x1] + r01[x0] + r01[x1] +
+                                                r10[x0] + r10[x1] + r11[x0] + r11[x1];
+                            out[x] = static_cast<T>((sum + 4) >> 3);
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
+
+VolumePyramid VolumePyramid::build(const Volume3D& volume, int maxLevels, ThreadPool* pool)
+{
+    VolumePyramid pyramid;
+    while (pyramid.getLevelCount() < maxLevels && pyramid.buildNextLevel(volume, pool)) {
+    }
+
+    if (pyramid.getLevelCount() > 1) {
+        std::cout << "Volume pyramid: " << pyramid.getLevelCount() << " levels, "
+                  << pyramid.getMemoryUsage() / (1024 * 1024) << " MB ("
+                  << pyramid.getMemoryOverhead() * 100.0 << "% of full resolution)" << std::endl;
+    }
+    return pyramid;
+}
+
+bool VolumePyramid::buildNextLevel(const Volume3D& volume, ThreadPool* pool)
+{
+    if (m_levels.empty()) {
+        if (!volume.isValid()) {
+            return false;
+        }
+        m_sourceMemory = volume.getVoxelMemoryUsage();
+        m_sourceSpacing = std::min({volume.spacing[0], volume.spacing[1], volume.spacing[2]});
+    }
+
+    const Volume3D& source = m_levels.empty() ? volume : m_levels.back();
+    const int width = (source.width + 1) / 2;
+    const int height = (source.height + 1) / 2;
+    const int depth = (source.depth + 1) / 2;
+    if (std::max({width, height, depth}) < kMinLevelSize) {
+        return false;
+    }
+
+    Volume3D level;
+    copyHeader(source, level);
+    level.width = width;
+    level.height = height;
+    level.depth = depth;
+    for (int i = 0; i < 3; ++i) {
+        level.spacing[i] = source.spacing[i] * 2.0;
+    }
+    // Voxel (0,0,0) of the level is the center of the source's first 2x2x2 block
+    source.voxelToWorld(0.5, 0.5, 0.5, level.origin[0], level.origin[1], level.origin[2]);
+
+    if (source.voxelType == Volume3D::VoxelType::Float32) {
+        level.voxels.resize(level.getTotalVoxels());
+    } else {
+        level.allocateStoredVoxels(source.voxelType, source.storedSlope, source.storedIntercept);
+    }
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    source.visitVoxels([&](const auto& view) {
+        using T = std::remove_const_t<std::remove_pointer_t<decltype(view.data)>>;
+        T* target = level.voxelType == Volume3D::VoxelType::Float32
+                        ? reinterpret_cast<T*>(level.voxels.data())
+                        : static_cast<T*>(level.storedVoxels.get());
+        downsample(view.data, source.width, source.height, source.depth, target, width, height, depth, threads);
+    });
+
+    m_levels.push_back(std::move(level));
+    return true;
+}
+
+const Volume3D& VolumePyramid::getLevel(const Volume3D& volume, int level) const
+{
+    level = std::min(level, static_cast<int>(m_levels.size()));
+    return level <= 0 ? volume : m_levels[level - 1];
+}
+
+int VolumePyramid::selectLevel(double pixelSpacing, bool interacting) const
+{
+    if (!interacting || m_levels.empty() || m_sourceSpacing <= 0.0) {
+        return 0;
+    }
+
+    const double coarsest = pixelSpacing * kInteractionCoarsening;
+    int level = 0;
+    double spacing = m_sourceSpacing * 2.0;
+    while (level < static_cast<int>(m_levels.size()) && spacing <= coarsest) {
+        ++level;
+        spacing *= 2.0;
+    }
+    return level;
+}
+
+size_t VolumePyramid::getMemoryUsage() const
+{
+    size_t bytes = 0;
+    for (const Volume3D& level : m_levels) {
+        bytes += level.getVoxelMemoryUsage();
+    }
+    return bytes;
+}
+
+double VolumePyramid::getMemoryOverhead() const
+{
+    return m_sourceMemory > 0 ? static_cast<double>(getMemoryUsage()) / m_sourceMemory : 0.0;
+}
+
+void VolumePyramid::clear()
+{
+    m_levels.clear();
+    m_sourceMemory = 0;
+    m_sourceSpacing = 0.0;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "Volume3D.h"
+#include <cstddef>
+#include <vector>
+
+class ThreadPool;
+
+/**
+ * @brief 2x-downsampled copies of a volume for level-of-detail rendering
+ *
+ * Level 0 is the source volume itself; level n halves every dimension of
+ * level n-1 (rounding up) with a 2x2x2 box filter. Each level is a complete
+ * Volume3D in the source's storage type and rescale, with spacing doubled and
+ * the origin moved to the center of the first 2x2x2 block. The reslicers, slab
+ * renderer and any other Volume3D consumer can therefore use a level as is.
+ * Orthogonal plane indices map with toLevelIndex; world positions need no
+ * mapping.
+ *
+ * The extra levels add about 1/7 (14.3%) of the source voxel memory.
+ */
+class VolumePyramid
+{
+public:
+    // Coarsest level: largest dimension at least this many voxels
+    static constexpr int kMinLevelSize = 32;
+
+    // While interacting, a level may be this much coarser than a screen pixel
+    static constexpr double kInteractionCoarsening = 2.0;
+
+    VolumePyramid() = default;
+
+    /**
+     * @brief Build all levels of a volume
+     * @param volume Source volume (level 0)
+     * @param maxLevels Upper bound on the level count including level 0
+     * @param pool Pool to split each level over (nullptr = global pool)
+     * @return Pyramid, or one with only level 0 if the volume is invalid or small
+     */
+    static VolumePyramid build(const Volume3D& volume, int maxLevels = 8, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Add the next coarser level
+     *
+     * Lets the pyramid be built incrementally, e.g. one level per idle tick.
+     * Must always be called with the same source volume.
+     *
+     * @return false if the coarsest level already exists
+     */
+    bool buildNextLevel(const Volume3D& volume, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Number of levels including the source volume
+     */
+    int getLevelCount() const { return static_cast<int>(m_levels.size()) + 1; }
+
+    /**
+     * @brief Volume of a level
+     * @param volume Source volume, returned for level 0
+     * @param level Level [0, getLevelCount-1]; clamped
+     */
+    const Volume3D& getLevel(const Volume3D& volume, int level) const;
+
+    /**
+     * @brief Pick the level to render
+     *
+     * Idle views always get full resolution. While interacting, the coarsest
+     * level whose finest voxel spacing is at most kInteractionCoarsening screen
+     * pixels is used, so zoomed-out views drop more detail than zoomed-in ones.
+     *
+     * @param pixelSpacing Screen footprint in mm per output pixel
+     * @param interacting true during drag, rotate or scroll
+     */
+    int selectLevel(double pixelSpacing, bool interacting) const;
+
+    /**
+     * @brief Map an orthogonal plane index of level 0 to a level
+     */
+    static int toLevelIndex(int index, int level) { return index >> level; }
+
+    /**
+     * @brief Bytes held by the extra levels (excluding level 0)
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * @brief Extra levels' memory as a fraction of the source voxel memory
+     */
+    double getMemoryOverhead() const;
+
+    /**
+     * @brief Drop all extra levels
+     */
+    void clear();
+
+private:
+    std::vector<Volume3D> m_levels;  // Levels 1..n
+    size_t m_sourceMemory{0};
+    double m_sourceSpacing{0.0};     // Finest spacing of level 0
+};
@@ -0,0 +1,371 @@
+#include "VolumeRegistry.h"
+#include "BrickRangeGrid.h"
+#include "DicomSeriesManager.h"
+#include "VolumeCache.h"
+#include "VolumeHistogram.h"
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <unordered_set>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    size_t estimateSeriesBytes(const DicomSeriesLoader::SeriesInfo& seriesInfo, const SeriesLoadOptions& options)
+    {
+        // 16-bit stored values for native storage; 8-bit series are overestimated
+        const size_t voxelSize = options.nativeStorage ? 2 : sizeof(float);
+        const size_t slices = static_cast<size_t>(std::max(seriesInfo.numSlices,
+                                                           static_cast<int>(seriesInfo.filePaths.size())));
+        return static_cast<size_t>(std::max(0, seriesInfo.imageRows)) *
+               static_cast<size_t>(std::max(0, seriesInfo.imageCols)) * slices * voxelSize;
+    }
+}
+
+VolumeRegistry::VolumeRegistry(size_t budgetBytes, const std::string& spillDirectory)
+    : m_budget(budgetBytes)
+    , m_spillDirectory(spillDirectory)
+{
+    std::random_device random;
+    std::ostringstream prefix;
+    prefix << "spill-" << std::hex << std::setw(8) << std::setfill('0') << random() << '-';
+    m_spillPrefix = prefix.str();
+}
+
+VolumeRegistry::~VolumeRegistry()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& [id, entry] : m_entries) {
+        if (!entry.spillPath.empty()) {
+            std::error_code ec;
+            std::filesystem::remove(entry.spillPath, ec);
+        }
+    }
+}
+
+VolumeRegistry::Id VolumeRegistry::addSeries(const DicomSeriesLoader::SeriesInfo& seriesInfo,
+                                             const SeriesLoadOptions& options)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Id id = m_nextId++;
+    Entry& entry = m_entries[id];
+    entry.fromSeries = true;
+    entry.seriesInfo = seriesInfo;
+    entry.options = options;
+    entry.options.progress = nullptr;  // Reloads happen long after the caller's progress is gone
+    entry.bytes = estimateSeriesBytes(seriesInfo, options);
+    return id;
+}
+
+VolumeRegistry::Id VolumeRegistry::addVolume(Volume3D volume, std::string* error)
+{
+    if (!volume.isValid()) {
+        if (error) {
+            *error = "Cannot register an invalid volume";
+        }
+        return 0;
+    }
+
+    auto resident = std::make_shared<const Volume3D>(std::move(volume));
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    // The new volume is held by the registry only, so it could itself be picked; make room first
+    evictLocked(lock, getVolumeMemoryUsage(*resident));
+
+    const Id id = m_nextId++;
+    Entry& entry = m_entries[id];
+    if (!m_spillDirectory.empty()) {
+        entry.spillPath = (std::filesystem::path(m_spillDirectory) /
+                           (m_spillPrefix + std::to_string(id) + ".vol")).string();
+    }
+    addResidentLocked(entry, std::move(resident));
+    entry.loadedBefore = true;
+    return id;
+}
+
+std::shared_ptr<const Volume3D> VolumeRegistry::acquire(Id id, LoadProgress* progress, std::string* error)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    size_t expected = 0;
+    auto it = m_entries.end();
+    for (bool roomMade = false;;) {
+        it = m_entries.find(id);
+        while (it != m_entries.end() && it->second.loading) {
+            m_loadFinished.wait(lock);
+            it = m_entries.find(id);
+        }
+        if (it == m_entries.end()) {
+            if (error) {
+                *error = "Unknown volume id " + std::to_string(id);
+            }
+            return nullptr;
+        }
+
+        Entry& entry = it->second;
+        entry.lastUse = ++m_useClock;
+        if (entry.volume) {
+            return entry.volume;
+        }
+        if (roomMade) {
+            break;
+        }
+
+        // Make room for the estimate before loading, so peak usage stays near the budget.
+        // Spilling releases the lock, so look the entry up again afterwards.
+        expected = entry.bytes;
+        evictLocked(lock, expected);
+        roomMade = true;
+    }
+
+    Entry& entry = it->second;
+    m_reserved += expected;
+    entry.loading = true;
+
+    const bool fromSeries = entry.fromSeries;
+    const DicomSeriesLoader::SeriesInfo seriesInfo = entry.seriesInfo;  // remove() may drop the entry meanwhile
+    SeriesLoadOptions options = entry.options;
+    options.progress = progress;
+    const std::string spillPath = entry.spillPath;
+    const bool reload = entry.loadedBefore;
+    lock.unlock();
+
+    // Both report errors per thread, so a concurrent load cannot overwrite this one's
+    Volume3D volume;
+    std::string loadError;
+    if (fromSeries) {
+        volume = DicomSeriesManager::loadSeries(seriesInfo, options);
+        if (!volume.isValid()) {
+            loadError = DicomSeriesLoader::getLastError();
+        }
+    } else if (!VolumeCache::load(spillPath, {}, volume)) {
+        loadError = "Spilled volume not readable: " + VolumeCache::getLastError();
+    }
+
+    auto resident = loadError.empty() ? std::make_shared<const Volume3D>(std::move(volume)) : nullptr;
+
+    lock.lock();
+    m_reserved -= expected;
+    it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        // Removed while loading: hand the volume out untracked
+        if (!resident && error) {
+            *error = loadError;
+        }
+        m_loadFinished.notify_all();
+        return resident;
+    }
+
+    Entry& loaded = it->second;
+    loaded.loading = false;
+    if (resident) {
+        addResidentLocked(loaded, resident);
+        loaded.loadedBefore = true;
+        if (reload) {
+            ++m_reloads;
+        }
+        // The estimate may have been low
+        evictLocked(lock, 0);
+    } else {
+        std::cout << "Volume " << id << " not loaded: " << loadError << std::endl;
+    }
+    if (!resident && error) {
+        *error = loadError;
+    }
+    m_loadFinished.notify_all();
+    return resident;
+}
+
+bool VolumeRegistry::isResident(Id id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = m_entries.find(id);
+    return it != m_entries.end() && it->second.volume != nullptr;
+}
+
+void VolumeRegistry::remove(Id id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto it = m_entries.find(id);
+    if (it == m_entries.end()) {
+        return;
+    }
+    if (it->second.volume) {
+        m_current -= it->second.bytes;
+    }
+    if (!it->second.spillPath.empty()) {
+        std::error_code ec;
+        std::filesystem::remove(it->second.spillPath, ec);
+    }
+    m_entries.erase(it);
+    m_loadFinished.notify_all();
+}
+
+void VolumeRegistry::setBudget(size_t budgetBytes)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_budget = budgetBytes;
+    evictLocked(lock, 0);
+}
+
+size_t VolumeRegistry::getBudget() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_budget;
+}
+
+void VolumeRegistry::trim()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    evictLocked(lock, 0);
+}
+
+size_t VolumeRegistry::getCurrentUsage() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_current;
+}
+
+size_t VolumeRegistry::getPeakUsage() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_peak;
+}
+
+void VolumeRegistry::resetPeakUsage()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_peak = m_current;
+}
+
+VolumeRegistry::Usage VolumeRegistry::getUsage() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Usage usage;
+    usage.currentBytes = m_current;
+    usage.peakBytes = m_peak;
+    usage.budgetBytes = m_budget;
+    usage.volumeCount = m_entries.size();
+    for (const auto& [id, entry] : m_entries) {
+        if (entry.volume) {
+            ++usage.residentCount;
+        }
+    }
+    usage.evictions = m_evictions;
+    usage.reloads = m_reloads;
+    return usage;
+}
+
+size_t VolumeRegistry::getVolumeMemoryUsage(const Volume3D& volume)
+{
+    size_t bytes = volume.getVoxelMemoryUsage();
+    if (volume.brickRanges) {
+        bytes += volume.brickRanges->getMemoryUsage();
+    }
+    if (volume.histogram) {
+        bytes += volume.histogram->getMemoryUsage();
+    }
+    return bytes;
+}
+
+size_t VolumeRegistry::getDefaultBudget()
+{
+    constexpr size_t kFallback = size_t(4) << 30;
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (GlobalMemoryStatusEx(&status) && status.ullTotalPhys > 0) {
+        return static_cast<size_t>(status.ullTotalPhys / 2);
+    }
+#else
+    const long pages = sysconf(_SC_PHYS_PAGES);
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    if (pages > 0 && pageSize > 0) {
+        return static_cast<size_t>(pages) * static_cast<size_t>(pageSize) / 2;
+    }
+#endif
+    return kFallback;
+}
+
+void VolumeRegistry::addResidentLocked(Entry& entry, std::shared_ptr<const Volume3D> volume)
+{
+    entry.bytes = getVolumeMemoryUsage(*volume);
+    entry.volume = std::move(volume);
+    m_current += entry.bytes;
+    m_peak = std::max(m_peak, m_current);
+}
+
+void VolumeRegistry::evictLocked(std::unique_lock<std::mutex>& lock, size_t incomingBytes)
+{
+    std::unordered_set<Id> kept;  // Failed to spill or acquired while spilling, during this call
+    while (m_current + m_reserved + incomingBytes > m_budget) {
+        // Least recently acquired volume that only the registry holds
+        Id victim = 0;
+        const Entry* oldest = nullptr;
+        for (const auto& [id, entry] : m_entries) {
+            const bool evictable = entry.volume && entry.volume.use_count() == 1 && !entry.spilling &&
+                                   (entry.fromSeries || (!entry.spillPath.empty() && !entry.spillFailed));
+            if (evictable && !kept.count(id) && (!oldest || entry.lastUse < oldest->lastUse)) {
+                victim = id;
+                oldest = &entry;
+            }
+        }
+        if (!oldest) {
+            return;  // Everything resident is displayed (or being spilled by another caller)
+        }
+        if (!evictEntryLocked(lock, victim)) {
+            kept.insert(victim);
+        }
+    }
+}
+
+bool VolumeRegistry::evictEntryLocked(std::unique_lock<std::mutex>& lock, Id id)
+{
+    auto it = m_entries.find(id);
+    if (!it->second.fromSeries && !it->second.spilled) {
+        // Written once, outside the lock: a spill file of a full volume takes a while, and
+        // volumes are immutable through their handles. The local handle keeps the volume
+        // alive, and `spilling` keeps other callers from picking it meanwhile.
+        it->second.spilling = true;
+        std::shared_ptr<const Volume3D> volume = it->second.volume;
+        const std::string spillPath = it->second.spillPath;
+        lock.unlock();
+        const bool saved = VolumeCache::save(spillPath, {}, *volume);
+        const std::string error = saved ? std::string() : VolumeCache::getLastError();
+        lock.lock();
+        volume.reset();
+
+        it = m_entries.find(id);
+        if (it == m_entries.end()) {
+            // Removed meanwhile; remove() could not delete a file that did not exist yet
+            std::error_code ec;
+            std::filesystem::remove(spillPath, ec);
+            return false;
+        }
+        it->second.spilling = false;
+        if (!saved) {
+            std::cout << "Volume " << id << " not spilled: " << error << std::endl;
+            it->second.spillFailed = true;
+            return false;
+        }
+        it->second.spilled = true;
+
+        // Acquired while the lock was released: it is displayed now. The spill file
+        // stays valid for a later eviction.
+        if (!it->second.volume || it->second.volume.use_count() != 1) {
+            return false;
+        }
+    }
+
+    Entry& entry = it->second;
+    m_current -= entry.bytes;
+    entry.volume.reset();
+    ++m_evictions;
+    return true;
+}
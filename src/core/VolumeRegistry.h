@@ -0,0 +1,185 @@
+#pragma once
+
+#include "DicomSeriesLoader.h"
+#include "Volume3D.h"
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @brief Keeps loaded volumes within a memory budget
+ *
+ * Volumes are registered once and then acquired as shared handles whenever
+ * they are needed. A volume with at least one handle alive counts as
+ * displayed and is never evicted. When a load or a new volume would exceed
+ * the budget, the least recently acquired volumes without handles are dropped
+ * first:
+ * - series volumes are simply released and reloaded through
+ *   DicomSeriesManager::loadSeries on the next acquire, which maps the volume
+ *   cache instead of decoding again when it is enabled;
+ * - in-memory volumes (addVolume) are written to a spill file with
+ *   VolumeCache first and mapped back on the next acquire.
+ *
+ * The budget is soft: when everything resident is displayed, a load goes
+ * ahead anyway and the usage exceeds the budget until handles are released
+ * and trim() (or the next acquire) evicts again. Usage counts voxels, brick
+ * ranges and histograms of resident volumes; mapped volumes count in full.
+ *
+ * All methods are thread-safe. Loads and spill-file writes run outside the
+ * lock; concurrent acquires of the same volume wait for the first one's load,
+ * and a volume acquired while it is being spilled simply stays resident.
+ */
+class VolumeRegistry
+{
+public:
+    using Id = uint64_t;
+
+    /**
+     * @brief Memory accounting snapshot
+     */
+    struct Usage
+    {
+        size_t currentBytes{0};   // Resident volumes
+        size_t peakBytes{0};      // Highest currentBytes since construction or resetPeakUsage
+        size_t budgetBytes{0};
+        size_t volumeCount{0};    // Registered volumes
+        size_t residentCount{0};  // Of which in memory
+        uint64_t evictions{0};
+        uint64_t reloads{0};      // Loads of volumes that had been evicted
+    };
+
+    /**
+     * @brief Create a registry
+     * @param budgetBytes Memory budget for resident volumes
+     * @param spillDirectory Where evicted in-memory volumes are written (empty = never evict them)
+     */
+    explicit VolumeRegistry(size_t budgetBytes, const std::string& spillDirectory = std::string());
+
+    /**
+     * @brief Delete the spill files
+     *
+     * Handles outlive the registry safely; their volumes are just no longer tracked.
+     */
+    ~VolumeRegistry();
+
+    VolumeRegistry(const VolumeRegistry&) = delete;
+    VolumeRegistry& operator=(const VolumeRegistry&) = delete;
+
+    /**
+     * @brief Register a series; it is loaded on the first acquire
+     * @param seriesInfo Series from DicomSeriesManager::scanDirectory
+     * @param options Load options for every (re)load; the progress pointer is not kept
+     * @return Id of the volume
+     */
+    Id addSeries(const DicomSeriesLoader::SeriesInfo& seriesInfo, const SeriesLoadOptions& options = SeriesLoadOptions());
+
+    /**
+     * @brief Register an already loaded volume (e.g. a resampled or derived one)
+     * @param volume Volume to register
+     * @param error Set to the reason if the volume is rejected (optional)
+     * @return Id of the volume, or 0 if the volume is invalid
+     */
+    Id addVolume(Volume3D volume, std::string* error = nullptr);
+
+    /**
+     * @brief Get a volume, loading it if it is not resident
+     * @param id Volume to get
+     * @param progress Counters and cancellation flag for the load, if one is needed
+     * @param error Set to the reason on failure (optional); per call, as acquires run concurrently
+     * @return Handle keeping the volume resident, or nullptr on error
+     */
+    std::shared_ptr<const Volume3D> acquire(Id id, LoadProgress* progress = nullptr, std::string* error = nullptr);
+
+    /**
+     * @brief Whether a volume is in memory
+     */
+    bool isResident(Id id) const;
+
+    /**
+     * @brief Forget a volume
+     *
+     * Outstanding handles keep their volume alive, but it no longer counts
+     * toward the usage.
+     */
+    void remove(Id id);
+
+    /**
+     * @brief Change the budget and evict down to it
+     */
+    void setBudget(size_t budgetBytes);
+    size_t getBudget() const;
+
+    /**
+     * @brief Evict volumes without handles until the usage fits the budget
+     */
+    void trim();
+
+    size_t getCurrentUsage() const;
+    size_t getPeakUsage() const;
+    void resetPeakUsage();
+    Usage getUsage() const;
+
+    /**
+     * @brief Bytes a volume counts toward the budget
+     */
+    static size_t getVolumeMemoryUsage(const Volume3D& volume);
+
+    /**
+     * @brief A budget derived from the physical memory (half of it), or 4 GiB if unknown
+     */
+    static size_t getDefaultBudget();
+
+private:
+    struct Entry
+    {
+        // Source to reload from: a series, or a spill file of an in-memory volume
+        bool fromSeries{false};
+        DicomSeriesLoader::SeriesInfo seriesInfo;
+        SeriesLoadOptions options;
+        std::string spillPath;
+        bool spilled{false};      // spillPath holds the volume
+        bool spilling{false};     // Being written outside the lock; not a victim meanwhile
+        bool spillFailed{false};  // Writing the spill file failed; stays resident
+
+        std::shared_ptr<const Volume3D> volume;  // nullptr while evicted
+        size_t bytes{0};          // Usage when resident (estimate before the first load)
+        uint64_t lastUse{0};
+        bool loading{false};
+        bool loadedBefore{false};
+    };
+
+    /**
+     * @brief Evict until current usage, in-flight loads and incoming bytes fit the budget
+     *
+     * Spill files are written with the lock released, so entries may change
+     * or disappear across the call; callers look them up again afterwards.
+     */
+    void evictLocked(std::unique_lock<std::mutex>& lock, size_t incomingBytes);
+
+    /**
+     * @brief Spill (if needed) and release one volume
+     * @return false if the volume stays resident
+     */
+    bool evictEntryLocked(std::unique_lock<std::mutex>& lock, Id id);
+    void addResidentLocked(Entry& entry, std::shared_ptr<const Volume3D> volume);
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_loadFinished;
+    std::unordered_map<Id, Entry> m_entries;
+    Id m_nextId{1};
+    uint64_t m_useClock{0};
+
+    size_t m_budget{0};
+    size_t m_current{0};
+    size_t m_peak{0};
+    size_t m_reserved{0};  // Estimated bytes of loads in flight
+    uint64_t m_evictions{0};
+    uint64_t m_reloads{0};
+
+    std::string m_spillDirectory;
+    std::string m_spillPrefix;  // Unique per registry, so several instances can share a directory
+};
@@ -0,0 +1,504 @@
+#include "VolumeResampler.h"
+#include "CpuFeatures.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#if AMPR_HAS_X86_SIMD
+#include <immintrin.h>
+#endif
+
+thread_local std::string VolumeResampler::s_lastError;
+
+namespace {
+    using Interpolation = VolumeResampler::Interpolation;
+
+    // Target pixels per tile, as for oblique rows
+    constexpr size_t kTilePixels = 16384;
+
+    // Positions within rounding distance of the edge count as inside and are clamped
+    constexpr double kEdgeTolerance = 1e-3;
+
+    /**
+     * @brief Round an interpolated stored value back to the stored type (half away from zero)
+     */
+    template <typename T>
+    inline T toStored(float value)
+    {
+        if constexpr (std::is_same_v<T, float>) {
+            return value;
+        } else {
+            const float clamped = std::min(std::max(value, static_cast<float>(std::numeric_limits<T>::lowest())),
+                                           static_cast<float>(std::numeric_limits<T>::max()));
+            return static_cast<T>(static_cast<int32_t>(clamped + std::copysign(0.5f, clamped)));
+        }
+    }
+
+    /**
+     * @brief Lower interpolation corner and weight of each target index along one axis
+     */
+    struct AxisTable
+    {
+        std::vector<int32_t> corner;  // Source index of the lower corner, -1 outside the source
+        std::vector<float> weight;    // Weight of the upper corner
+        int begin{0};                 // Contiguous range of inside indices
+        int end{0};
+        int step{0};                  // Element offset to the upper corner (0 on single-voxel axes)
+    };
+
+    AxisTable makeAxisTable(double scale, double offset, int targetSize, int sourceSize, size_t stride)
+    {
+        AxisTable table;
+        table.corner.assign(static_cast<size_t>(targetSize), -1);
+        table.weight.assign(static_cast<size_t>(targetSize), 0.0f);
+        table.step = sourceSize > 1 ? static_cast<int>(stride) : 0;
+        const int lastCorner = sourceSize - 1 - (sourceSize > 1 ? 1 : 0);
+
+        table.begin = targetSize;
+        for (int i = 0; i < targetSize; ++i) {
+            const double position = scale * i + offset;
+            if (position < -kEdgeTolerance || position > sourceSize - 1 + kEdgeTolerance) {
+                continue;
+            }
+            const double clamped = std::clamp(position, 0.0, static_cast<double>(sourceSize - 1));
+            const int corner = std::min(static_cast<int>(clamped), lastCorner);
+            table.corner[i] = corner;
+            table.weight[i] = static_cast<float>(clamped - corner);
+            table.begin = std::min(table.begin, i);
+            table.end = i + 1;
+        }
+        if (table.begin >= table.end) {
+            table.begin = table.end = 0;
+        }
+        return table;
+    }
+
+    /**
+     * @brief out[i] = a[i] + t * (b[i] - a[i]) over [begin, end)
+     */
+    template <typename T>
+    void blendLinesScalar(const T* a, const T* b, float t, int begin, int end, float* out)
+    {
+        for (int i = begin; i < end; ++i) {
+            const float low = static_cast<float>(a[i]);
+            out[i] = low + t * (static_cast<float>(b[i]) - low);
+        }
+    }
+
+    /**
+     * @brief 2-tap blend of a source line at each target column's corner
+     */
+    template <typename T>
+    void blendColumnsScalar(const float* line, const AxisTable& xs, int begin, int end, T* out)
+    {
+        const int step = xs.step;
+        for (int x = begin; x < end; ++x) {
+            const float* q = line + xs.corner[x];
+            out[x] = toStored<T>(q[0] + xs.weight[x] * (q[step] - q[0]));
+        }
+    }
+
+#if AMPR_HAS_X86_SIMD
+    AMPR_TARGET_AVX2 inline __m256 loadAsFloat(const float* p) { return _mm256_loadu_ps(p); }
+    AMPR_TARGET_AVX2 inline __m256 loadAsFloat(const int16_t* p)
+    {
+        return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+    }
+    AMPR_TARGET_AVX2 inline __m256 loadAsFloat(const uint16_t* p)
+    {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))));
+    }
+    AMPR_TARGET_AVX2 inline __m256 loadAsFloat(const uint8_t* p)
+    {
+        return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))));
+    }
+
+    template <typename T>
+    AMPR_TARGET_AVX2 int blendLinesAVX2(const T* a, const T* b, float t, int begin, int end, float* out)
+    {
+        const __m256 weight = _mm256_set1_ps(t);
+        int i = begin;
+        for (; i + 8 <= end; i += 8) {
+            const __m256 low = loadAsFloat(a + i);
+            const __m256 value = _mm256_add_ps(low, _mm256_mul_ps(weight, _mm256_sub_ps(loadAsFloat(b + i), low)));
+            _mm256_storeu_ps(out + i, value);
+        }
+        return i;
+    }
+
+    /**
+     * @brief Same as blendColumnsScalar, 8 columns per step with gathers; not for 8-bit output
+     */
+    template <typename T>
+    AMPR_TARGET_AVX2 int blendColumnsAVX2(const float* line, const AxisTable& xs, int begin, int end, T* out)
+    {
+        const __m256 signMask = _mm256_set1_ps(-0.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 lowest = _mm256_set1_ps(static_cast<float>(std::numeric_limits<T>::lowest()));
+        const __m256 highest = _mm256_set1_ps(static_cast<float>(std::numeric_limits<T>::max()));
+        const float* upper = line + xs.step;
+
+        int x = begin;
+        for (; x + 8 <= end; x += 8) {
+            const __m256i corner = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(xs.corner.data() + x));
+            const __m256 q0 = _mm256_i32gather_ps(line, corner, 4);
+            const __m256 q1 = _mm256_i32gather_ps(upper, corner, 4);
+            const __m256 value = _mm256_add_ps(q0, _mm256_mul_ps(_mm256_loadu_ps(xs.weight.data() + x),
+                                                                 _mm256_sub_ps(q1, q0)));
+            if constexpr (std::is_same_v<T, float>) {
+                _mm256_storeu_ps(out + x, value);
+            } else {
+                // Clamp, then add +/-0.5 and truncate, as toStored does
+                const __m256 clamped = _mm256_min_ps(_mm256_max_ps(value, lowest), highest);
+                const __m256 rounding = _mm256_or_ps(_mm256_and_ps(clamped, signMask), half);
+                const __m256i stored = _mm256_cvttps_epi32(_mm256_add_ps(clamped, rounding));
+                const __m256i packed = std::is_signed_v<T> ? _mm256_packs_epi32(stored, stored)
+                                                           : _mm256_packus_epi32(stored, stored);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x),
+                                 _mm256_castsi256_si128(_mm256_permute4x64_epi64(packed, 0x08)));
+            }
+        }
+        return x;
+    }
+#endif
+
+    /**
+     * @brief Scratch lines of one thread for separable resampling
+     */
+    struct SeparableScratch
+    {
+        std::vector<float> low;   // Source row yCorner, blended in z
+        std::vector<float> high;  // Source row yCorner + 1, blended in z
+        std::vector<float> line;  // Blended in y
+        int z{-1};
+        int lowRow{-1};
+        int highRow{-1};
+    };
+
+    template <typename T>
+    void blendLines(const T* a, const T* b, float t, int begin, int end, float* out, bool useAVX2)
+    {
+        int i = begin;
+#if AMPR_HAS_X86_SIMD
+        if (useAVX2) {
+            i = blendLinesAVX2(a, b, t, begin, end, out);
+        }
+#endif
+        blendLinesScalar(a, b, t, i, end, out);
+        (void)useAVX2;
+    }
+
+    /**
+     * @brief Separable trilinear resampling of one tile of target rows
+     *
+     * Source rows are blended in z once per target slice and reused by every
+     * target row between them; each target row then blends two such rows in y
+     * over the source columns in use and does a 2-tap x blend per voxel.
+     */
+    template <typename T>
+    void resampleTileSeparable(const T* source, int sourceWidth, int sourceHeight, const AxisTable& xs,
+                               const AxisTable& ys, const AxisTable& zs, int z, int rowBegin, int rowEnd,
+                               int targetWidth, T background, bool useAVX2, SeparableScratch& scratch, T* output)
+    {
+        const size_t sliceSize = static_cast<size_t>(sourceWidth) * sourceHeight;
+        const int zCorner = zs.corner[z];
+
+        // Source columns touched by the inside target columns (monotonic mapping)
+        int columnBegin = 0, columnEnd = 0;
+        if (xs.begin < xs.end) {
+            columnBegin = std::min(xs.corner[xs.begin], xs.corner[xs.end - 1]);
+            columnEnd = std::max(xs.corner[xs.begin], xs.corner[xs.end - 1]) + 1 + (xs.step != 0 ? 1 : 0);
+        }
+        if (scratch.line.size() < static_cast<size_t>(sourceWidth)) {
+            scratch.low.resize(sourceWidth);
+            scratch.high.resize(sourceWidth);
+            scratch.line.resize(sourceWidth);
+        }
+        if (scratch.z != z) {
+            scratch.z = z;
+            scratch.lowRow = scratch.highRow = -1;
+        }
+
+        auto blendInZ = [&](int row, std::vector<float>& into) {
+            const T* a = source + static_cast<size_t>(zCorner) * sliceSize + static_cast<size_t>(row) * sourceWidth;
+            blendLines(a, a + zs.step, zs.weight[z], columnBegin, columnEnd, into.data(), useAVX2);
+        };
+
+        for (int y = rowBegin; y < rowEnd; ++y) {
+            T* out = output + static_cast<size_t>(y) * targetWidth;
+            const int yCorner = ys.corner[y];
+            if (zCorner < 0 || yCorner < 0 || columnEnd <= columnBegin) {
+                std::fill(out, out + targetWidth, background);
+                continue;
+            }
+
+            // Target rows advance through the source rows, so the upper row often becomes the lower one
+            const int highRow = yCorner + (ys.step != 0 ? 1 : 0);
+            if (yCorner != scratch.lowRow) {
+                if (yCorner == scratch.highRow) {
+                    std::swap(scratch.low, scratch.high);
+                    scratch.highRow = -1;
+                } else {
+                    blendInZ(yCorner, scratch.low);
+                }
+                scratch.lowRow = yCorner;
+            }
+            if (highRow != scratch.highRow) {
+                blendInZ(highRow, scratch.high);
+                scratch.highRow = highRow;
+            }
+            blendLines(scratch.low.data(), scratch.high.data(), ys.weight[y], columnBegin, columnEnd,
+                       scratch.line.data(), useAVX2);
+
+            std::fill(out, out + xs.begin, background);
+            int x = xs.begin;
+#if AMPR_HAS_X86_SIMD
+            if constexpr (!std::is_same_v<T, uint8_t>) {
+                if (useAVX2) {
+                    x = blendColumnsAVX2(scratch.line.data(), xs, xs.begin, xs.end, out);
+                }
+            }
+#endif
+            blendColumnsScalar(scratch.line.data(), xs, x, xs.end, out);
+            std::fill(out + xs.end, out + targetWidth, background);
+        }
+    }
+
+    /**
+     * @brief General resampling of one tile of target rows with the oblique row kernels
+     */
+    template <typename T>
+    void resampleTileGeneral(const Volume3D& source, const VolumeResampler::Affine& affine,
+                             Interpolation interpolation, int z, int rowBegin, int rowEnd, int targetWidth,
+                             float background, std::vector<float>& scratch, T* output)
+    {
+        ObliqueReslicer::Affine rows;
+        for (int a = 0; a < 3; ++a) {
+            const double* m = affine.matrix[a];
+            rows.origin[a] = m[1] * rowBegin + m[2] * z + m[3];
+            rows.stepU[a] = m[0];
+            rows.stepV[a] = m[1];
+        }
+
+        const int rowCount = rowEnd - rowBegin;
+        T* out = output + static_cast<size_t>(rowBegin) * targetWidth;
+        if constexpr (std::is_same_v<T, float>) {
+            ObliqueReslicer::sampleRows(source, rows, interpolation, targetWidth, rowCount, false, background,
+                                        out, static_cast<size_t>(targetWidth));
+        } else {
+            const size_t count = static_cast<size_t>(rowCount) * targetWidth;
+            scratch.resize(count);
+            ObliqueReslicer::sampleRows(source, rows, interpolation, targetWidth, rowCount, false, background,
+                                        scratch.data(), static_cast<size_t>(targetWidth));
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = toStored<T>(scratch[i]);
+            }
+        }
+    }
+}
+
+bool VolumeResampler::Affine::isAxisAligned() const
+{
+    for (int a = 0; a < 3; ++a) {
+        // An off-axis term must move the sample by well under a voxel across the grid
+        const double diagonal = std::abs(matrix[a][a]);
+        if (diagonal < 1e-12) {
+            return false;
+        }
+        for (int b = 0; b < 3; ++b) {
+            if (b != a && std::abs(matrix[a][b]) > 1e-6 * diagonal) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+VolumeResampler::Affine VolumeResampler::computeAffine(const Volume3D& source, const Volume3D& target)
+{
+    const double* targetAxes[3] = {target.rowDir, target.colDir, target.sliceDir};
+    const double* sourceAxes[3] = {source.rowDir, source.colDir, source.sliceDir};
+    const double offset[3] = {target.origin[0] - source.origin[0], target.origin[1] - source.origin[1],
+                              target.origin[2] - source.origin[2]};
+
+    // source voxel a = ((target world - source origin) . source axis a) / source spacing a
+    Affine affine;
+    for (int a = 0; a < 3; ++a) {
+        const double* axis = sourceAxes[a];
+        for (int b = 0; b < 3; ++b) {
+            const double* step = targetAxes[b];
+            affine.matrix[a][b] = target.spacing[b] * (step[0] * axis[0] + step[1] * axis[1] + step[2] * axis[2]) /
+                                  source.spacing[a];
+        }
+        affine.matrix[a][3] = (offset[0] * axis[0] + offset[1] * axis[1] + offset[2] * axis[2]) / source.spacing[a];
+    }
+    return affine;
+}
+
+bool VolumeResampler::resample(const Volume3D& source, const Volume3D& target, Volume3D& output,
+                               Interpolation interpolation, ThreadPool* pool)
+{
+    s_lastError.clear();
+    if (!source.isValid() || target.width <= 0 || target.height <= 0 || target.depth <= 0) {
+        s_lastError = "Cannot resample: invalid source or target volume";
+        return false;
+    }
+
+    Volume3D result;
+    result.width = target.width;
+    result.height = target.height;
+    result.depth = target.depth;
+    for (int a = 0; a < 3; ++a) {
+        result.spacing[a] = target.spacing[a];
+        result.origin[a] = target.origin[a];
+        result.rowDir[a] = target.rowDir[a];
+        result.colDir[a] = target.colDir[a];
+        result.sliceDir[a] = target.sliceDir[a];
+    }
+    result.modality = source.modality;
+    result.patientID = source.patientID;
+    result.studyUID = source.studyUID;
+    result.seriesUID = source.seriesUID;
+    result.studyDate = source.studyDate;
+    result.seriesDescription = source.seriesDescription;
+    if (source.pet) {
+        // Acquisition times belong to the source slices, not to the new grid
+        auto pet = std::make_shared<PetAcquisition>(*source.pet);
+        pet->sliceAcquisitionTimes.clear();
+        result.pet = std::move(pet);
+    }
+    result.rescaleIntercept = source.rescaleIntercept;
+    result.rescaleSlope = source.rescaleSlope;
+    result.hasRescaleParams = source.hasRescaleParams;
+    result.vmin = source.vmin;
+    result.vmax = source.vmax;
+
+    const bool native = source.voxelType != Volume3D::VoxelType::Float32;
+    if (native) {
+        result.allocateStoredVoxels(source.voxelType, source.storedSlope, source.storedIntercept);
+    } else {
+        result.voxels.resize(result.getTotalVoxels());
+    }
+
+    // Background in the units the kernels work in (stored values for native storage)
+    const float background = native && source.storedSlope != 0.0
+                                 ? static_cast<float>((source.vmin - source.storedIntercept) / source.storedSlope)
+                                 : source.vmin;
+
+    const Affine affine = computeAffine(source, target);
+    const bool separable = interpolation == Interpolation::Linear && affine.isAxisAligned();
+    AxisTable xs, ys, zs;
+    if (separable) {
+        xs = makeAxisTable(affine.matrix[0][0], affine.matrix[0][3], target.width, source.width, 1);
+        ys = makeAxisTable(affine.matrix[1][1], affine.matrix[1][3], target.height, source.height,
+                           static_cast<size_t>(source.width));
+        zs = makeAxisTable(affine.matrix[2][2], affine.matrix[2][3], target.depth, source.depth,
+                           static_cast<size_t>(source.width) * source.height);
+    }
+
+    const bool useAVX2 = CpuFeatures::hasAVX2();
+    const int rowsPerTile = static_cast<int>(std::max<size_t>(1, kTilePixels / static_cast<size_t>(target.width)));
+    const int tilesPerSlice = (target.height + rowsPerTile - 1) / rowsPerTile;
+    const size_t tileCount = static_cast<size_t>(tilesPerSlice) * target.depth;
+
+    ThreadPool& threads = pool ? *pool : ThreadPool::global();
+    source.visitVoxels([&](const auto& view) {
+        using T = std::remove_const_t<std::remove_pointer_t<decltype(view.data)>>;
+        T* destination = native ? static_cast<T*>(result.storedVoxels.get())
+                                : reinterpret_cast<T*>(result.voxels.data());
+        const T storedBackground = toStored<T>(background);
+
+        threads.parallelFor(tileCount, [&](size_t, size_t begin, size_t end) {
+            std::vector<float> scratch;
+            SeparableScratch lines;
+            for (size_t tile = begin; tile < end; ++tile) {
+                const int z = static_cast<int>(tile / tilesPerSlice);
+                const int rowBegin = static_cast<int>(tile % tilesPerSlice) * rowsPerTile;
+                const int rowEnd = std::min(target.height, rowBegin + rowsPerTile);
+                T* slice = destination + static_cast<size_t>(z) * target.width * target.height;
+                if (separable) {
+                    resampleTileSeparable(view.data, source.width, source.height, xs, ys, zs, z, rowBegin, rowEnd,
+                                          target.width, storedBackground, useAVX2, lines, slice);
+                } else {
+                    resampleTileGeneral(source, affine, interpolation, z, rowBegin, rowEnd, target.width,
+                                        background, scratch, slice);
+                }
+            }
+        });
+    });
+
+    output = std::move(result);
+    return true;
+}
+
+VolumeResampler::Signature VolumeResampler::Signature::of(const Volume3D& volume)
+{
+    Signature signature;
+    signature.generation = volume.generation;
+    signature.dimensions[0] = volume.width;
+    signature.dimensions[1] = volume.height;
+    signature.dimensions[2] = volume.depth;
+    for (int a = 0; a < 3; ++a) {
+        signature.geometry[a] = volume.spacing[a];
+        signature.geometry[3 + a] = volume.origin[a];
+        signature.geometry[6 + a] = volume.rowDir[a];
+        signature.geometry[9 + a] = volume.colDir[a];
+        signature.geometry[12 + a] = volume.sliceDir[a];
+    }
+    signature.voxelType = volume.voxelType;
+    signature.storedSlope = volume.storedSlope;
+    signature.storedIntercept = volume.storedIntercept;
+    signature.vmin = volume.vmin;
+    signature.vmax = volume.vmax;
+    return signature;
+}
+
+bool VolumeResampler::Signature::operator==(const Signature& other) const
+{
+    return generation == other.generation && std::memcmp(dimensions, other.dimensions, sizeof(dimensions)) == 0 &&
+           std::memcmp(geometry, other.geometry, sizeof(geometry)) == 0 && voxelType == other.voxelType &&
+           storedSlope == other.storedSlope && storedIntercept == other.storedIntercept &&
+           vmin == other.vmin && vmax == other.vmax;
+}
+
+std::shared_ptr<const Volume3D> VolumeResampler::getResampled(const std::shared_ptr<const Volume3D>& source,
+                                                              const std::shared_ptr<const Volume3D>& target,
+                                                              Interpolation interpolation, ThreadPool* pool)
+{
+    if (!source || !target) {
+        s_lastError = "Cannot resample: missing volume";
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const Signature sourceSignature = Signature::of(*source);
+    const Signature targetSignature = Signature::of(*target);
+    if (m_result && m_interpolation == interpolation && m_source == sourceSignature && m_target == targetSignature) {
+        return m_result;
+    }
+
+    auto result = std::make_shared<Volume3D>();
+    if (!resample(*source, *target, *result, interpolation, pool)) {
+        return nullptr;
+    }
+    m_source = sourceSignature;
+    m_target = targetSignature;
+    m_interpolation = interpolation;
+    m_result = std::move(result);
+    return m_result;
+}
+
+void VolumeResampler::invalidate()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_result.reset();
+}
+
+std::string VolumeResampler::getLastError()
+{
+    return s_lastError;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "ObliqueReslicer.h"
+#include "Volume3D.h"
+#include <memory>
+#include <mutex>
+#include <string>
+
+class ThreadPool;
+
+/**
+ * @brief Resamples one volume onto another volume's voxel grid
+ *
+ * Used for fusion: the secondary (e.g. PET) volume is sampled at every voxel
+ * center of the primary (e.g. CT) grid. Target voxel -> world -> source voxel
+ * is one composite affine, computed once from both volumes' origin, spacing
+ * and direction vectors, so no per-voxel worldToVoxel calls are needed.
+ *
+ * Every target row is then a straight line through the source, sampled with
+ * the ObliqueReslicer row kernels (analytic clipping, AVX2 trilinear gathers).
+ * When the two grids share their axes up to flips and scale, which is the
+ * usual PET/CT case, trilinear sampling is done separably instead: one z
+ * blend per source plane, one y blend per source row and a 2-tap x blend per
+ * target voxel, from tables computed once per call. Work is split into tiles
+ * of target rows across the thread pool.
+ *
+ * The result has the target geometry and the source's storage type, rescale
+ * and metadata. Native storage interpolates stored values and rounds back to
+ * the stored type, which keeps the result at half the size of float32;
+ * outside the source the result is the source minimum.
+ *
+ * An instance caches its last result until either input changes.
+ */
+class VolumeResampler
+{
+public:
+    using Interpolation = ObliqueReslicer::Interpolation;
+
+    /**
+     * @brief Target voxel to source voxel mapping
+     *
+     * source[a] = matrix[a][0] * x + matrix[a][1] * y + matrix[a][2] * z + matrix[a][3]
+     */
+    struct Affine
+    {
+        double matrix[3][4];
+
+        /**
+         * @brief Whether each source axis depends on one target axis only (same axis index)
+         */
+        bool isAxisAligned() const;
+    };
+
+    /**
+     * @brief Composite target-voxel -> source-voxel affine
+     */
+    static Affine computeAffine(const Volume3D& source, const Volume3D& target);
+
+    /**
+     * @brief Resample source onto the grid of target
+     * @param source Volume to resample
+     * @param target Volume whose grid (dimensions, spacing, origin, directions) to use
+     * @param output Output volume
+     * @param interpolation Interpolation mode
+     * @param pool Pool to split tiles over (nullptr = global pool)
+     * @return false if a volume is invalid
+     */
+    static bool resample(const Volume3D& source, const Volume3D& target, Volume3D& output,
+                         Interpolation interpolation = Interpolation::Linear, ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Resampled volume, reusing the previous result while the inputs are unchanged
+     *
+     * A volume counts as changed when its Volume3D::generation, geometry,
+     * storage or value range differs from the cached call. Call invalidate()
+     * after writing the voxel buffers directly (setVoxel renews the generation).
+     *
+     * @return Result, or nullptr on error (see getLastError)
+     */
+    std::shared_ptr<const Volume3D> getResampled(const std::shared_ptr<const Volume3D>& source,
+                                                 const std::shared_ptr<const Volume3D>& target,
+                                                 Interpolation interpolation = Interpolation::Linear,
+                                                 ThreadPool* pool = nullptr);
+
+    /**
+     * @brief Drop the cached result
+     */
+    void invalidate();
+
+    /**
+     * @brief Get the last error message of the calling thread
+     */
+    static std::string getLastError();
+
+private:
+    /**
+     * @brief What a cached result was computed from
+     */
+    struct Signature
+    {
+        uint64_t generation{0};
+        int dimensions[3]{0, 0, 0};
+        double geometry[15]{};  // spacing, origin, rowDir, colDir, sliceDir
+        Volume3D::VoxelType voxelType{Volume3D::VoxelType::Float32};
+        double storedSlope{1.0};
+        double storedIntercept{0.0};
+        float vmin{0.0f};
+        float vmax{0.0f};
+
+        static Signature of(const Volume3D& volume);
+        bool operator==(const Signature& other) const;
+    };
+
+    std::mutex m_mutex;
+    Signature m_source;
+    Signature m_target;
+    Interpolation m_interpolation{Interpolation::Linear};
+    std::shared_ptr<const Volume3D> m_result;
+
+    static thread_local std::string s_lastError;
+};
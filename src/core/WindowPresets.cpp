@@ -0,0 +1,57 @@
+#include "WindowPresets.h"
+#include "VolumeHistogram.h"
+#include <cmath>
+#include <limits>
+
+std::vector<WindowPresets::Preset> WindowPresets::getPresets(const std::string& modality)
+{
+    if (modality == "CT") {
+        return {
+            {"Soft tissue", {400.0f, 40.0f}},
+            {"Lung", {1500.0f, -600.0f}},
+            {"Bone", {1800.0f, 400.0f}},
+            {"Brain", {80.0f, 40.0f}},
+            {"Mediastinum", {350.0f, 50.0f}},
+        };
+    }
+    return {};
+}
+
+WindowLevel WindowPresets::getAutoWindow(const Volume3D& volume)
+{
+    const WindowLevel fullRange = WindowLevel::fromRange(volume.vmin, volume.vmax);
+    if (!volume.histogram) {
+        return fullRange;
+    }
+    const VolumeHistogram& histogram = *volume.histogram;
+
+    float low = 0.0f, high = 0.0f;
+    if (volume.modality == "CT") {
+        // Drop padding / air outside the body and metal
+        if (histogram.getPercentile(1.0, low, -1000.0f, 3000.0f) &&
+            histogram.getPercentile(99.0, high, -1000.0f, 3000.0f)) {
+            return WindowLevel::fromRange(low, high);
+        }
+    } else if (volume.modality == "PT" || volume.modality == "NM") {
+        const float positive = std::nextafter(0.0f, 1.0f);
+        if (histogram.getPercentile(99.5, high, positive)) {
+            return WindowLevel::fromRange(0.0f, high);
+        }
+    } else {
+        // Skip the background, which sits at the minimum
+        const float aboveMinimum = std::nextafter(volume.vmin, std::numeric_limits<float>::max());
+        if (histogram.getPercentile(1.0, low, aboveMinimum) &&
+            histogram.getPercentile(99.5, high, aboveMinimum)) {
+            return WindowLevel::fromRange(low, high);
+        }
+    }
+    return fullRange;
+}
+
+WindowLevel WindowPresets::getDefaultWindow(const Volume3D& volume)
+{
+    if (volume.modality == "CT") {
+        return getPresets(volume.modality).front().window;
+    }
+    return getAutoWindow(volume);
+}
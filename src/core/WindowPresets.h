@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Volume3D.h"
+#include <string>
+#include <vector>
+
+/**
+ * @brief Display window in rescaled units (HU for CT)
+ */
+struct WindowLevel
+{
+    float width{1.0f};
+    float center{0.0f};
+
+    float getLow() const { return center - width * 0.5f; }
+    float getHigh() const { return center + width * 0.5f; }
+
+    static WindowLevel fromRange(float low, float high)
+    {
+        return WindowLevel{std::max(high - low, 1e-6f), (low + high) * 0.5f};
+    }
+};
+
+/**
+ * @brief Modality-aware window/level presets and histogram-based auto window
+ *
+ * Global min/max make a poor window: CT carries -3024 HU padding outside the
+ * reconstruction circle and metal up to the top of the stored range, MR a zero
+ * background, PET a few hot voxels. The auto window therefore takes
+ * percentiles of Volume3D::histogram over the values that matter for the
+ * modality.
+ */
+class WindowPresets
+{
+public:
+    struct Preset
+    {
+        std::string name;
+        WindowLevel window;
+    };
+
+    /**
+     * @brief Fixed presets for a modality (empty if it has no calibrated units)
+     */
+    static std::vector<Preset> getPresets(const std::string& modality);
+
+    /**
+     * @brief Window from histogram percentiles
+     *
+     * CT: 1st-99th percentile of [-1000, 3000] HU. PT/NM: 0 to the 99.5th
+     * percentile of positive values. Others: 1st-99.5th percentile above the
+     * volume minimum. Falls back to vmin/vmax without a histogram.
+     */
+    static WindowLevel getAutoWindow(const Volume3D& volume);
+
+    /**
+     * @brief Initial window for a freshly loaded volume
+     *
+     * The soft tissue preset for CT, the auto window otherwise.
+     */
+    static WindowLevel getDefaultWindow(const Volume3D& volume);
+};
@@ -5,9 +5,12 @@
 #include <QStyleFactory>
 #include <QMessageBox>
 #include <QDebug>
+#include <QDir>
+#include <QStandardPaths>
 
 #include "version.h"
 #include "ui/MainWindow.h"
+#include "core/DicomSeriesManager.h"
 
 void setupOpenGLFormat()
 {
@@ -95,6 +98,13 @@ int main(int argc, char *argv[])
     app.setOrganizationName("Advanced MPR Viewer Project");
     app.setOrganizationDomain("advanced-mpr-viewer.org");
     
+    // Keep directory scan indexes and cached volumes in the per-user cache location
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cacheDir.isEmpty()) {
+        DicomSeriesManager::setScanIndexDirectory(QDir(cacheDir).filePath("scan-index").toStdString());
+        DicomSeriesManager::setVolumeCacheDirectory(QDir(cacheDir).filePath("volumes").toStdString());
+    }
+    
     // Setup OpenGL format before creating any OpenGL widgets
     setupOpenGLFormat();
     
@@ -6,15 +6,54 @@
 #include <QStatusBar>
 #include <QMessageBox>
 #include <QFileDialog>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QTimer>
 #include <QDebug>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
 #include "version.h"
 #include "core/DicomSeriesManager.h"
+#include "core/LoadProgress.h"
+#include "core/WindowPresets.h"
+
+/**
+ * @brief State shared between the UI and a background scan + load
+ * 
+ * The worker fills in the result fields and then sets `finished`; the UI
+ * only reads them after seeing `finished`, so no further locking is needed.
+ */
+struct MainWindow::LoadJob
+{
+    LoadProgress progress;
+    std::atomic<bool> finished{false};
+    
+    QString directory;
+    
+    // Result (written by the worker before `finished`)
+    bool scanFailed{false};
+    std::string error;
+    VolumeRegistry::Id volumeId{0};
+    std::shared_ptr<const Volume3D> volume;
+    VolumePyramid pyramid;
+    
+    // UI-side bookkeeping for the decode rate
+    bool decodeStarted{false};
+    std::chrono::steady_clock::time_point decodeStart;
+};
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
 {
     setWindowTitle(QString("%1 v%2").arg(AdvancedMPRViewer::PROJECT_NAME_STR, AdvancedMPRViewer::PROJECT_VERSION_STR));
     setMinimumSize(800, 600);
+    
+    // Volumes not on screen are dropped beyond half the RAM and reopened from the volume cache
+    const std::string cacheDirectory = DicomSeriesManager::getVolumeCacheDirectory();
+    m_volumes = std::make_unique<VolumeRegistry>(
+        VolumeRegistry::getDefaultBudget(),
+        cacheDirectory.empty() ? std::string() : (std::filesystem::path(cacheDirectory) / "spill").string());
 
     // Create central widget with placeholder content
     auto* centralWidget = new QWidget(this);
@@ -73,6 +112,33 @@ MainWindow::MainWindow(QWidget* parent)
     // Help menu
     auto* helpMenu = menuBar()->addMenu("&Help");
     helpMenu->addAction("&About", [this]() { about(); });
+    
+    // Load progress in the status bar, shown only while a load is running
+    m_progressLabel = new QLabel(this);
+    m_progressBar = new QProgressBar(this);
+    m_progressBar->setMaximumWidth(200);
+    m_cancelButton = new QPushButton("Cancel", this);
+    connect(m_cancelButton, &QPushButton::clicked, this, [this]() { cancelLoad(); });
+    statusBar()->addPermanentWidget(m_progressLabel);
+    statusBar()->addPermanentWidget(m_progressBar);
+    statusBar()->addPermanentWidget(m_cancelButton);
+    m_progressLabel->hide();
+    m_progressBar->hide();
+    m_cancelButton->hide();
+    
+    m_progressTimer = new QTimer(this);
+    m_progressTimer->setInterval(16);
+    connect(m_progressTimer, &QTimer::timeout, this, [this]() { updateLoadProgress(); });
+}
+
+MainWindow::~MainWindow()
+{
+    if (m_loadJob) {
+        m_loadJob->progress.cancel();
+    }
+    if (m_loadThread.joinable()) {
+        m_loadThread.join();
+    }
 }
 
 void MainWindow::about()
@@ -88,6 +154,11 @@ void MainWindow::about()
 
 void MainWindow::openDicomDirectory()
 {
+    if (m_loadJob) {
+        statusBar()->showMessage("A series is still loading - cancel it first", 3000);
+        return;
+    }
+    
     QString directory = QFileDialog::getExistingDirectory(
         this,
         "Select DICOM Directory",
@@ -99,33 +170,147 @@ void MainWindow::openDicomDirectory()
         return;
     }
     
-    statusBar()->showMessage("Scanning DICOM directory...", 5000);
+    statusBar()->showMessage("Scanning DICOM directory...");
+    
+    // Scan and load on a worker thread; the UI polls the job until it finishes
+    auto job = std::make_shared<LoadJob>();
+    job->directory = directory;
+    m_loadJob = job;
+    m_loadThread = std::thread([job, registry = m_volumes.get(), path = directory.toStdString()]() {
+        // Scan directory for DICOM series
+        auto seriesList = DicomSeriesManager::scanDirectory(path, 0, &job->progress);
+        
+        if (seriesList.empty()) {
+            job->scanFailed = true;
+            job->error = DicomSeriesManager::getLastError();
+        } else {
+            // For now, load the first series found.
+            // Keep CT/MR in their stored integer type; the viewer only reads rescaled values
+            SeriesLoadOptions loadOptions;
+            loadOptions.nativeStorage = true;
+            job->volumeId = registry->addSeries(seriesList[0], loadOptions);
+            job->volume = registry->acquire(job->volumeId, &job->progress, &job->error);
+            if (job->volume && !job->progress.isCancelled()) {
+                // Coarse levels for interactive rendering, built while the UI still shows progress
+                job->pyramid = VolumePyramid::build(*job->volume);
+            }
+        }
+        
+        job->finished.store(true, std::memory_order_release);
+    });
+    
+    m_progressLabel->setText("Scanning...");
+    m_progressBar->setRange(0, 0);
+    m_progressLabel->show();
+    m_progressBar->show();
+    m_cancelButton->setEnabled(true);
+    m_cancelButton->show();
+    m_progressTimer->start();
+}
+
+void MainWindow::updateLoadProgress()
+{
+    if (!m_loadJob) {
+        m_progressTimer->stop();
+        return;
+    }
+    
+    LoadJob& job = *m_loadJob;
+    if (job.finished.load(std::memory_order_acquire)) {
+        finishLoad();
+        return;
+    }
+    
+    const size_t slicesTotal = job.progress.slicesTotal.load(std::memory_order_relaxed);
+    if (slicesTotal == 0) {
+        // Still scanning: the total is unknown, so show a busy bar
+        m_progressLabel->setText(QString("Scanning: %1 / %2 files")
+                                 .arg(job.progress.filesScanned.load(std::memory_order_relaxed))
+                                 .arg(job.progress.filesFound.load(std::memory_order_relaxed)));
+        return;
+    }
     
-    // Scan directory for DICOM series
-    auto seriesList = DicomSeriesManager::scanDirectory(directory.toStdString());
+    const auto now = std::chrono::steady_clock::now();
+    if (!job.decodeStarted) {
+        job.decodeStarted = true;
+        job.decodeStart = now;
+        m_progressBar->setRange(0, static_cast<int>(slicesTotal));
+    }
+    
+    const size_t decoded = job.progress.slicesDecoded.load(std::memory_order_relaxed);
+    const double seconds = std::chrono::duration<double>(now - job.decodeStart).count();
+    const double megabytes = job.progress.bytesDecoded.load(std::memory_order_relaxed) / (1024.0 * 1024.0);
+    m_progressBar->setValue(static_cast<int>(decoded));
+    m_progressLabel->setText(QString("Loading: %1 / %2 slices, %3 MB/s")
+                             .arg(decoded).arg(slicesTotal)
+                             .arg(seconds > 0.0 ? megabytes / seconds : 0.0, 0, 'f', 1));
+}
+
+void MainWindow::cancelLoad()
+{
+    if (!m_loadJob) {
+        return;
+    }
+    m_loadJob->progress.cancel();
+    m_cancelButton->setEnabled(false);
+    m_progressLabel->setText("Cancelling...");
+}
+
+void MainWindow::finishLoad()
+{
+    m_progressTimer->stop();
+    if (m_loadThread.joinable()) {
+        m_loadThread.join();
+    }
+    m_progressLabel->hide();
+    m_progressBar->hide();
+    m_cancelButton->hide();
     
-    if (seriesList.empty()) {
+    std::shared_ptr<LoadJob> job = std::move(m_loadJob);
+    
+    const bool loaded = job->volume && !job->progress.isCancelled();
+    if (!loaded && job->volumeId != 0) {
+        job->volume.reset();
+        m_volumes->remove(job->volumeId);
+    }
+    
+    if (job->progress.isCancelled()) {
+        statusBar()->showMessage("Loading cancelled", 2000);
+        return;
+    }
+    
+    if (job->scanFailed) {
         QMessageBox::warning(this, "No DICOM Series Found", 
                            QString("No valid DICOM series found in directory:\n%1\n\nError: %2")
-                           .arg(directory, QString::fromStdString(DicomSeriesManager::getLastError())));
+                           .arg(job->directory, QString::fromStdString(job->error)));
         statusBar()->showMessage("No DICOM series found", 2000);
         return;
     }
     
-    // For now, load the first series found
-    const auto& firstSeries = seriesList[0];
-    statusBar()->showMessage(QString("Loading series: %1...").arg(QString::fromStdString(firstSeries.seriesDescription)), 5000);
-    
-    Volume3D volume = DicomSeriesManager::loadSeries(firstSeries);
-    
-    if (!volume.isValid()) {
+    if (!job->volume) {
         QMessageBox::critical(this, "DICOM Loading Error",
                             QString("Failed to load DICOM series.\n\nError: %1")
-                            .arg(QString::fromStdString(DicomSeriesLoader::getLastError())));
+                            .arg(QString::fromStdString(job->error)));
         statusBar()->showMessage("DICOM loading failed", 2000);
         return;
     }
     
+    // One series on screen at a time: the previous one is no longer needed
+    if (m_volumeId != 0) {
+        m_volume.reset();
+        m_volumes->remove(m_volumeId);
+    }
+    m_volumeId = job->volumeId;
+    m_volume = std::move(job->volume);
+    m_pyramid = std::move(job->pyramid);
+    showLoadedVolume();
+}
+
+void MainWindow::showLoadedVolume()
+{
+    const Volume3D& volume = *m_volume;
+    const WindowLevel window = WindowPresets::getDefaultWindow(volume);
+    
     // Display success message with volume information
     QString message = QString("DICOM Series Loaded Successfully!\n\n"
                              "Series: %1\n"
@@ -134,13 +319,15 @@ void MainWindow::openDicomDirectory()
                              "Spacing: %6, %7, %8 mm\n"
                              "Origin: %9, %10, %11 mm\n"
                              "Value Range: %12 to %13\n"
-                             "Total Voxels: %14")
+                             "Window: W %14 / L %15\n"
+                             "Total Voxels: %16")
                      .arg(QString::fromStdString(volume.seriesDescription))
                      .arg(QString::fromStdString(volume.modality))
                      .arg(volume.width).arg(volume.height).arg(volume.depth)
                      .arg(volume.spacing[0], 0, 'f', 3).arg(volume.spacing[1], 0, 'f', 3).arg(volume.spacing[2], 0, 'f', 3)
                      .arg(volume.origin[0], 0, 'f', 1).arg(volume.origin[1], 0, 'f', 1).arg(volume.origin[2], 0, 'f', 1)
                      .arg(volume.vmin, 0, 'f', 1).arg(volume.vmax, 0, 'f', 1)
+                     .arg(window.width, 0, 'f', 1).arg(window.center, 0, 'f', 1)
                      .arg(volume.getTotalVoxels());
     
     QMessageBox::information(this, "DICOM Loaded", message);
@@ -155,4 +342,10 @@ void MainWindow::openDicomDirectory()
     qDebug() << "  Row direction:" << volume.rowDir[0] << volume.rowDir[1] << volume.rowDir[2];
     qDebug() << "  Col direction:" << volume.colDir[0] << volume.colDir[1] << volume.colDir[2];
     qDebug() << "  Slice direction:" << volume.sliceDir[0] << volume.sliceDir[1] << volume.sliceDir[2];
+    qDebug() << "Volume pyramid:" << m_pyramid.getLevelCount() << "levels,"
+             << m_pyramid.getMemoryOverhead() * 100.0 << "% extra memory";
+    const VolumeRegistry::Usage usage = m_volumes->getUsage();
+    qDebug() << "Volume memory:" << usage.currentBytes / (1024 * 1024) << "MB of"
+             << usage.budgetBytes / (1024 * 1024) << "MB budget, peak"
+             << usage.peakBytes / (1024 * 1024) << "MB";
 }
\ No newline at end of file
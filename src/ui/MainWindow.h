@@ -1,17 +1,55 @@
 #pragma once
 
 #include <QMainWindow>
+#include <memory>
+#include <thread>
+#include "core/Volume3D.h"
+#include "core/VolumePyramid.h"
+#include "core/VolumeRegistry.h"
 
 QT_BEGIN_NAMESPACE
 class QLabel;
+class QProgressBar;
+class QPushButton;
+class QTimer;
 QT_END_NAMESPACE
 
 class MainWindow : public QMainWindow
 {
 public:
     explicit MainWindow(QWidget* parent = nullptr);
+    ~MainWindow() override;
 
 private:
+    struct LoadJob;
+
     void about();
     void openDicomDirectory();
-};
\ No newline at end of file
+    
+    /**
+     * @brief Poll the running load (60 Hz) and update the status bar
+     */
+    void updateLoadProgress();
+    
+    /**
+     * @brief Join the finished worker and take over its volume
+     */
+    void finishLoad();
+    
+    void cancelLoad();
+    void showLoadedVolume();
+
+    // Background scan + load; the worker only touches the job, never the widgets
+    std::shared_ptr<LoadJob> m_loadJob;
+    std::thread m_loadThread;
+    QTimer* m_progressTimer{nullptr};
+    QLabel* m_progressLabel{nullptr};
+    QProgressBar* m_progressBar{nullptr};
+    QPushButton* m_cancelButton{nullptr};
+
+    // Loaded series within a memory budget; the displayed volume keeps its handle
+    std::unique_ptr<VolumeRegistry> m_volumes;
+    VolumeRegistry::Id m_volumeId{0};
+    std::shared_ptr<const Volume3D> m_volume;
+    VolumePyramid m_pyramid;  // Level-of-detail copies of m_volume
+};